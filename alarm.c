@@ -1,97 +1,302 @@
-#include <avr/io.h>
 #include <stdint.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include "alarm.h"
 #include "lcd.h"
 #include "rtc.h"
+#include "buzzer.h"
+#include "time_utils.h"
+#include "tz.h"
+#include "telemetry.h"
+#include "trace.h"
+#include "eventlog.h"
+#include "mode.h"
 
-// Alarm variables
-static alarm_t alarm_time = {6, 30, false};
-static bool alarm_triggered = false;
+// Alarm table
+static alarm_t alarms[ALARM_COUNT];
+
+// Next alarm due, kept up to date by alarm_reschedule() so the per-minute
+// trigger check is a single comparison regardless of ALARM_COUNT
+static uint8_t next_index = ALARM_NONE;
+static epoch_t next_due = 0;
+
+// Session variables
+static alarm_state_t alarm_state = ALARM_IDLE;
+static uint16_t ring_timeout = ALARM_RING_TIMEOUT_S;
+static uint16_t ring_seconds = 0;      // Seconds spent in the current ringing phase
+static epoch_t snooze_until = 0;       // End of the current snooze
+static epoch_t fired_at = 0;           // Alarm instant that started the session
+
+// Recompute next_index/next_due for the first occurrence strictly after 'now'
+static void alarm_schedule_from(epoch_t now)
+{
+    // Alarm times and weekdays are local; the search runs on local time
+    // and only the result goes back to UTC
+    epoch_t local = tz_to_local(now);
+    uint32_t since_midnight;
+    epoch_t midnight;
+    uint8_t weekday = epoch_weekday(local);
+    
+    epoch_days(local, &since_midnight);
+    midnight = local - since_midnight;
+    next_index = ALARM_NONE;
+    
+    for (uint8_t i = 0; i < ALARM_COUNT; i++) {
+        if (!(alarms[i].flags & ALARM_FLAG_ENABLED)) {
+            continue;
+        }
+        
+        epoch_t due = midnight + time_to_seconds(alarms[i].hour, alarms[i].minute, 0);
+        uint8_t day = weekday;
+        
+        // Today through the same weekday next week
+        for (uint8_t offset = 0; offset <= 7; offset++) {
+            if ((alarms[i].days & (1 << day)) && due > local) {
+                if (next_index == ALARM_NONE || due < next_due) {
+                    next_index = i;
+                    next_due = due;
+                }
+                break;
+            }
+            due += EPOCH_SECONDS_PER_DAY;
+            day = (day == 6) ? 0 : day + 1;
+        }
+    }
+    
+    if (next_index != ALARM_NONE) {
+        next_due = tz_to_utc(next_due);
+    }
+}
+
+// Start (or resume after snooze) the ringing phase
+static void alarm_start_ringing(void)
+{
+    alarm_state = ALARM_RINGING;
+    ring_seconds = 0;
+    buzzer_on();
+}
+
+// Silence the buzzer and move to the given state
+static void alarm_silence(alarm_state_t next_state)
+{
+    buzzer_off();
+    alarm_state = next_state;
+}
 
 // Initialize alarm
 void alarm_init(void)
 {
-    alarm_time.hour = 6;
-    alarm_time.minute = 30;
-    alarm_time.enabled = false;
-    alarm_triggered = false;
+    for (uint8_t i = 0; i < ALARM_COUNT; i++) {
+        alarms[i].hour = 6;
+        alarms[i].minute = 30;
+        alarms[i].days = ALARM_DAYS_ALL;
+        alarms[i].flags = ALARM_FLAG_REPEAT;
+    }
+    
+    alarm_state = ALARM_IDLE;
+    ring_timeout = ALARM_RING_TIMEOUT_S;
+    next_index = ALARM_NONE;
 }
 
 // Set alarm time
-void alarm_set(uint8_t hour, uint8_t minute)
+void alarm_set(uint8_t index, uint8_t hour, uint8_t minute)
+{
+    if (index >= ALARM_COUNT) return;
+    
+    alarms[index].hour = hour;
+    alarms[index].minute = minute;
+    alarm_reschedule();
+    mode_dirty(MODE_DIRTY_ALARM);
+}
+
+// Replace a whole table entry
+void alarm_store(uint8_t index, const alarm_t* alarm)
 {
-    alarm_time.hour = hour;
-    alarm_time.minute = minute;
+    if (index >= ALARM_COUNT) return;
+    
+    alarms[index] = *alarm;
+    if (alarms[index].days == 0) {
+        alarms[index].days = ALARM_DAYS_ALL;
+    }
+    alarm_reschedule();
+    mode_dirty(MODE_DIRTY_ALARM);
 }
 
 // Enable alarm
-void alarm_enable(void)
+void alarm_enable(uint8_t index)
 {
-    alarm_time.enabled = true;
-    alarm_triggered = false;
+    if (index >= ALARM_COUNT) return;
+    
+    alarms[index].flags |= ALARM_FLAG_ENABLED;
+    alarm_reschedule();
+    mode_dirty(MODE_DIRTY_ALARM);
 }
 
-// Disable alarm
-void alarm_disable(void)
+// Disable alarm (also cancels its ringing or snoozed session)
+void alarm_disable(uint8_t index)
 {
-    alarm_time.enabled = false;
-    alarm_triggered = false;
+    if (index >= ALARM_COUNT) return;
+    
+    alarms[index].flags &= ~ALARM_FLAG_ENABLED;
+    if (alarm_state == ALARM_RINGING || alarm_state == ALARM_SNOOZED) {
+        alarm_silence(ALARM_IDLE);
+    }
+    alarm_reschedule();
+    mode_dirty(MODE_DIRTY_ALARM);
 }
 
 // Stop alarm
 void alarm_stop(void)
 {
-    alarm_triggered = false;
+    alarm_dismiss();
+}
+
+// Recompute the next alarm due; call after the table or the clock changes
+void alarm_reschedule(void)
+{
+    alarm_schedule_from(rtc_now());
 }
 
-// Check if alarm should trigger
-bool alarm_check_trigger(void)
+// Check the time-based session transitions; returns true when ringing starts.
+// Called once per second with the shadow clock. Each transition is a single
+// epoch comparison: the next alarm due starts ringing (superseding a snooze),
+// the end of a snooze resumes it, and a dismissed session re-arms once the
+// fired minute is over.
+bool alarm_check_trigger(epoch_t now)
 {
-    if (!alarm_time.enabled || alarm_triggered) {
+    if (alarm_state == ALARM_RINGING) {
         return false;
     }
     
-    time_t current_time;
-    rtc_get_time(&current_time);
+    if (next_index != ALARM_NONE && now >= next_due) {
+        // One-shot alarms disable themselves once they fire
+        if (!(alarms[next_index].flags & ALARM_FLAG_REPEAT)) {
+            alarms[next_index].flags &= ~ALARM_FLAG_ENABLED;
+            mode_dirty(MODE_DIRTY_ALARM);
+        }
+        TRACE_EVENT(TRACE_ALARM, next_index);
+        telemetry_event(PSTR("alarm"), next_index + 1);
+        eventlog_record(EVENTLOG_ALARM, next_index + 1);
+        fired_at = next_due;
+        alarm_schedule_from(now);
+        alarm_start_ringing();
+        return true;
+    }
     
-    if (alarm_time_matches(current_time.hour, current_time.minute)) {
-        alarm_triggered = true;
+    if (alarm_state == ALARM_SNOOZED && now >= snooze_until) {
+        alarm_start_ringing();
         return true;
     }
     
+    if (alarm_state == ALARM_DISMISSED && now >= fired_at + EPOCH_SECONDS_PER_MINUTE) {
+        alarm_state = ALARM_IDLE;
+    }
+    
     return false;
 }
 
+// Advance the ringing pattern (called on every 1 Hz timer tick)
+void alarm_tick(void)
+{
+    if (alarm_state != ALARM_RINGING) {
+        return;
+    }
+    
+    ring_seconds++;
+    if (ring_timeout != 0 && ring_seconds >= ring_timeout) {
+        alarm_silence(ALARM_DISMISSED);
+        return;
+    }
+    
+    // One second on, one second off
+    if (ring_seconds & 1) {
+        buzzer_off();
+    } else {
+        buzzer_on();
+    }
+}
+
+// Silence the alarm and ring again after ALARM_SNOOZE_MINUTES
+void alarm_snooze(void)
+{
+    if (alarm_state != ALARM_RINGING) {
+        return;
+    }
+    
+    epoch_t now = rtc_now();
+    
+    snooze_until = now - now % EPOCH_SECONDS_PER_MINUTE +
+                   (epoch_t)ALARM_SNOOZE_MINUTES * EPOCH_SECONDS_PER_MINUTE;
+    alarm_silence(ALARM_SNOOZED);
+}
+
+// Silence the alarm until its next occurrence
+void alarm_dismiss(void)
+{
+    if (alarm_state == ALARM_RINGING || alarm_state == ALARM_SNOOZED) {
+        alarm_silence(ALARM_DISMISSED);
+    }
+}
+
+// Check if the buzzer pattern is active
+bool alarm_is_ringing(void)
+{
+    return (alarm_state == ALARM_RINGING);
+}
+
+// Get current session state
+alarm_state_t alarm_get_state(void)
+{
+    return alarm_state;
+}
+
+// Set the auto-stop timeout in seconds (0 disables the timeout)
+void alarm_set_ring_timeout(uint16_t seconds)
+{
+    ring_timeout = seconds;
+}
+
 // Check if alarm is enabled
-bool alarm_is_enabled(void)
+bool alarm_is_enabled(uint8_t index)
 {
-    return alarm_time.enabled;
+    if (index >= ALARM_COUNT) return false;
+    
+    return (alarms[index].flags & ALARM_FLAG_ENABLED) != 0;
 }
 
-// Get alarm time
-alarm_t alarm_get_time(void)
+// Get alarm table entry
+alarm_t alarm_get(uint8_t index)
 {
-    return alarm_time;
+    if (index >= ALARM_COUNT) index = 0;
+    
+    return alarms[index];
 }
 
-// Display alarm time on LCD
-void alarm_display(void)
+// Index of the next alarm due, or ALARM_NONE
+uint8_t alarm_get_next(void)
 {
-    char time_str[16];
-    alarm_format_time(time_str);
-    lcd_print(time_str);
+    return next_index;
 }
 
-// Check if current time matches alarm time
-bool alarm_time_matches(uint8_t current_hour, uint8_t current_minute)
+// Display alarm entry on LCD
+void alarm_display(uint8_t index)
 {
-    return (current_hour == alarm_time.hour && current_minute == alarm_time.minute);
+    char alarm_str[17];
+    alarm_format(index, alarm_str);
+    lcd_print(alarm_str);
 }
 
-// Format alarm time to string
-void alarm_format_time(char* buffer)
+// Format alarm entry as "HH:MM MTWTFSS R" ('-' for unset days, R/1 = repeat/once)
+void alarm_format(uint8_t index, char* buffer)
 {
-    sprintf(buffer, "%02d:%02d", alarm_time.hour, alarm_time.minute);
-} 
\ No newline at end of file
+    static const char day_letters[] = "MTWTFSS";
+    alarm_t alarm = alarm_get(index);
+    
+    sprintf(buffer, "%02d:%02d ", alarm.hour, alarm.minute);
+    for (uint8_t day = 0; day < 7; day++) {
+        buffer[6 + day] = (alarm.days & (1 << day)) ? day_letters[day] : '-';
+    }
+    buffer[13] = ' ';
+    buffer[14] = (alarm.flags & ALARM_FLAG_REPEAT) ? 'R' : '1';
+    buffer[15] = '\0';
+} 
@@ -3,27 +3,74 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include "rtc.h"
+
+// Number of alarm slots in the table
+#define ALARM_COUNT             4
+
+// Ringing stops by itself after this many seconds (0 = ring until a button)
+#define ALARM_RING_TIMEOUT_S    60
+// Snooze length in minutes
+#define ALARM_SNOOZE_MINUTES    5
+
+// Weekday bits (bit 0 = Monday, matching epoch_weekday())
+#define ALARM_DAY_MON           (1 << 0)
+#define ALARM_DAY_TUE           (1 << 1)
+#define ALARM_DAY_WED           (1 << 2)
+#define ALARM_DAY_THU           (1 << 3)
+#define ALARM_DAY_FRI           (1 << 4)
+#define ALARM_DAY_SAT           (1 << 5)
+#define ALARM_DAY_SUN           (1 << 6)
+#define ALARM_DAYS_WEEKDAYS     0x1F
+#define ALARM_DAYS_WEEKEND      0x60
+#define ALARM_DAYS_ALL          0x7F
+
+// Alarm flags
+#define ALARM_FLAG_ENABLED      0x01
+#define ALARM_FLAG_REPEAT       0x02  // Clear = one-shot, disabled after firing
+
+// Value of alarm_get_next() when no alarm is enabled
+#define ALARM_NONE              0xFF
 
 // Alarm structure
 typedef struct {
     uint8_t hour;
     uint8_t minute;
-    bool enabled;
+    uint8_t days;   // ALARM_DAY_* bitmask
+    uint8_t flags;  // ALARM_FLAG_* bits
 } alarm_t;
 
+// Alarm session states
+typedef enum {
+    ALARM_IDLE = 0,     // Waiting for the next alarm
+    ALARM_RINGING,      // Buzzer pattern running
+    ALARM_SNOOZED,      // Silenced, rings again after the snooze period
+    ALARM_DISMISSED     // Silenced until the fired minute has passed
+} alarm_state_t;
+
 // Function prototypes
 void alarm_init(void);
-void alarm_set(uint8_t hour, uint8_t minute);
-void alarm_enable(void);
-void alarm_disable(void);
+void alarm_set(uint8_t index, uint8_t hour, uint8_t minute);
+void alarm_store(uint8_t index, const alarm_t* alarm);
+void alarm_enable(uint8_t index);
+void alarm_disable(uint8_t index);
 void alarm_stop(void);
-bool alarm_check_trigger(void);
-bool alarm_is_enabled(void);
-alarm_t alarm_get_time(void);
-void alarm_display(void);
+bool alarm_check_trigger(epoch_t now);
+bool alarm_is_enabled(uint8_t index);
+alarm_t alarm_get(uint8_t index);
+uint8_t alarm_get_next(void);
+void alarm_reschedule(void);
+void alarm_display(uint8_t index);
+
+// Session control (called from the main loop)
+void alarm_tick(void);
+void alarm_snooze(void);
+void alarm_dismiss(void);
+bool alarm_is_ringing(void);
+alarm_state_t alarm_get_state(void);
+void alarm_set_ring_timeout(uint16_t seconds);
 
 // Internal functions
-bool alarm_time_matches(uint8_t current_hour, uint8_t current_minute);
-void alarm_format_time(char* buffer);
+void alarm_format(uint8_t index, char* buffer);
 
-#endif // ALARM_H 
\ No newline at end of file
+#endif // ALARM_H 
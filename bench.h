@@ -0,0 +1,29 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+// Cycle markers for make bench. The firmware is built with -DBENCH and run
+// under simavr by tools/bench.c, which time-stamps every marker with the
+// simulator's cycle counter. In normal builds the markers compile to nothing.
+//
+// A marker is one byte written through hal_bench_mark(): the span id, with
+// BENCH_END_FLAG set on the closing marker. Spans of different ids may
+// nest; a span must not nest inside itself.
+
+// Span ids (tools/bench.c names them in the same order)
+#define BENCH_LOOP          0   // One main-loop pass, without the poll pause
+#define BENCH_DISPLAY       1   // mode_render() redraws
+#define BENCH_RTC_SYNC      2   // rtc_sync(), the per-tick burst read
+#define BENCH_TICK_ISR      3   // Timer1 compare ISR body
+#define BENCH_SPAN_COUNT    4
+
+#define BENCH_END_FLAG      0x80
+
+#ifdef BENCH
+#define BENCH_BEGIN(id)     hal_bench_mark(id)
+#define BENCH_END(id)       hal_bench_mark((id) | BENCH_END_FLAG)
+#else
+#define BENCH_BEGIN(id)     ((void)0)
+#define BENCH_END(id)       ((void)0)
+#endif
+
+#endif // BENCH_H 
@@ -1,65 +1,109 @@
-#include <avr/io.h>
-#include <util/delay.h>
 #include <stdint.h>
 #include <stdbool.h>
+#include "hal.h"
 #include "buttons.h"
+#include "timebase.h"
+#include "telemetry.h"
+#include "trace.h"
 
-// Button matrix state
+// Keypad state kept by the scan interrupt
+static volatile uint8_t keys_down = 0;          // Debounced, a bit per button
+static volatile uint8_t keys_pressed = 0;       // Presses not yet taken by the main loop
+static volatile uint32_t press_times[4];        // Time stamp of each button's last press
+static uint8_t scan_row = 0;                    // Row driven since the last interrupt
+static uint8_t key_scans[4];                    // Scans a key has read unlike keys_down
+static uint32_t key_changed[4];                 // Time stamp of the first of those
+
+// Main-loop view, refreshed by buttons_read_input()
 static uint8_t button_states[4] = {0};
-static uint8_t last_button_states[4] = {0};
+static uint8_t pass_pressed = 0;                // Presses seen by this pass
 static uint8_t button_press_flags[4] = {0};
 
+// Names on the telemetry console, in button index order
+static const char button_names[4][6] PROGMEM = {"MODE", "SET", "START", "STOP"};
+
 void buttons_init(void)
 {
     // Configure row pins as outputs
-    DDRB |= (1 << ROW1_PIN) | (1 << ROW2_PIN);
+    hal_gpio_output(B, (1 << ROW1_PIN) | (1 << ROW2_PIN));
     
     // Configure column pins as inputs with pull-up
-    DDRB &= ~((1 << COL1_PIN) | (1 << COL2_PIN));
+    hal_gpio_input(B, (1 << COL1_PIN) | (1 << COL2_PIN));
     
     // Enable pull-up resistors for columns
-    PORTB |= (1 << COL1_PIN) | (1 << COL2_PIN);
+    hal_gpio_set(B, (1 << COL1_PIN) | (1 << COL2_PIN));
     
     // Initialize button states
     for (uint8_t i = 0; i < 4; i++) {
         button_states[i] = 0;
-        last_button_states[i] = 0;
         button_press_flags[i] = 0;
+        key_scans[i] = 0;
     }
+    keys_down = 0;
+    keys_pressed = 0;
+    pass_pressed = 0;
+    
+    // Drive the first row low and start scanning
+    scan_row = 0;
+    hal_gpio_set(B, 1 << ROW2_PIN);
+    hal_gpio_clear(B, 1 << ROW1_PIN);
+    hal_scan_start();
 }
 
-void buttons_read_input(void)
+// One row per interrupt: the row driven low by the previous interrupt has
+// had a whole period to settle, so no delay is needed before reading it
+HAL_SCAN_ISR()
 {
-    uint8_t row, col;
-    uint8_t button_index = 0;
-    
-    // Save last button states
-    for (uint8_t i = 0; i < 4; i++) {
-        last_button_states[i] = button_states[i];
-        button_states[i] = 0;
-    }
+    uint8_t pins = hal_gpio_read(B);
     
-    // Scan 2 rows (R1 and R2)
-    for (row = 0; row < 2; row++) {
-        // Set all rows high first
-        PORTB |= (1 << ROW1_PIN) | (1 << ROW2_PIN);
-        
-        // Set current row low
-        PORTB &= ~(1 << (ROW1_PIN + row));
+    for (uint8_t col = 0; col < 2; col++) {
+        uint8_t button = scan_row * 2 + col;
+        uint8_t mask = 1 << button;
+        bool pressed = !(pins & (1 << (COL1_PIN + col)));
         
-        _delay_us(10); // Small delay for settling
+        if (pressed == ((keys_down & mask) != 0)) {
+            key_scans[button] = 0;
+            continue;
+        }
+        if (key_scans[button] == 0) {
+            key_changed[button] = timebase_now();
+        }
+        if (++key_scans[button] < BTN_DEBOUNCE_SCANS) {
+            continue;
+        }
         
-        // Read 2 columns (C1 and C2)
-        for (col = 0; col < 2; col++) {
-            bool pressed = !(PINB & (1 << (COL1_PIN + col)));
-            
-            if (pressed && button_index < 4) {
-                button_states[button_index] = 1;
-                if (last_button_states[button_index] == 0) {
-                    button_press_flags[button_index] = 1;
-                }
-            }
-            button_index++;
+        // Stable for the debounce time: take the new state
+        key_scans[button] = 0;
+        keys_down ^= mask;
+        if (pressed) {
+            keys_pressed |= mask;
+            press_times[button] = key_changed[button];
+            TRACE_EVENT(TRACE_KEY, button);
+        }
+    }
+    
+    // Drive the other row for the next interrupt
+    scan_row ^= 1;
+    hal_gpio_set(B, (1 << ROW1_PIN) | (1 << ROW2_PIN));
+    hal_gpio_clear(B, 1 << (ROW1_PIN + scan_row));
+}
+
+// Take the presses the scan interrupt has seen since the previous pass.
+// A tap shorter than a pass still counts as one press.
+void buttons_read_input(void)
+{
+    uint8_t sreg = hal_irq_save();
+    uint8_t down = keys_down;
+    
+    pass_pressed = keys_pressed;
+    keys_pressed = 0;
+    hal_irq_restore(sreg);
+    
+    for (uint8_t i = 0; i < 4; i++) {
+        button_states[i] = ((down | pass_pressed) >> i) & 1;
+        if (pass_pressed & (1 << i)) {
+            button_press_flags[i] = 1;
+            telemetry_text(PSTR("key"), button_names[i]);
         }
     }
 }
@@ -67,7 +111,7 @@ void buttons_read_input(void)
 bool button_is_pressed(uint8_t button)
 {
     if (button < 4) {
-        return (button_states[button] == 1 && last_button_states[button] == 0);
+        return (pass_pressed >> button) & 1;
     }
     return false;
 }
@@ -103,4 +147,15 @@ uint8_t button_get_state(uint8_t button)
         return button_states[button];
     }
     return 0;
-} 
\ No newline at end of file
+}
+
+// Time stamp (timebase.h) of the button's last press, taken by the scan
+// interrupt when the key first read pressed
+uint32_t button_press_time(uint8_t button)
+{
+    uint8_t sreg = hal_irq_save();
+    uint32_t stamp = (button < 4) ? press_times[button] : 0;
+    
+    hal_irq_restore(sreg);
+    return stamp;
+}
@@ -21,8 +21,15 @@
 #define BTN_PRESSED         0
 #define BTN_RELEASED        1
 
-// Debounce time in milliseconds
-#define BTN_DEBOUNCE_TIME   50
+// Debounce time in milliseconds: a key changes state once it has read the
+// same for this long. Its press is time-stamped at the first of those
+// readings, so the stamp is late by one scan at most.
+#define BTN_DEBOUNCE_TIME   10
+
+// The scan interrupt reads one row per HAL_SCAN_PERIOD_US, so each key is
+// sampled every BTN_SCAN_ROWS periods
+#define BTN_SCAN_ROWS       2
+#define BTN_DEBOUNCE_SCANS  (BTN_DEBOUNCE_TIME * 1000UL / (HAL_SCAN_PERIOD_US * BTN_SCAN_ROWS))
 
 // Function prototypes
 void buttons_init(void);
@@ -31,5 +38,6 @@ bool button_is_pressed(uint8_t button);
 bool button_was_pressed(uint8_t button);
 void button_clear_press(uint8_t button);
 uint8_t get_pressed_button(void);
+uint32_t button_press_time(uint8_t button);
 
 #endif // BUTTONS_H 
\ No newline at end of file
@@ -1,12 +1,27 @@
-#include <avr/io.h>
-#include <util/delay.h>
 #include <stdint.h>
+#include "hal.h"
 #include "buzzer.h"
+#include "trace.h"
+#include "pt.h"
+#include "alarm.h"
+
+// Beep in progress (buzzer_beep()), ended by buzzer_poll()
+static pt_t beep = { .lc = PT_DONE };
+static uint16_t beep_ms;
+
+static bool buzzer_beep_thread(pt_t* pt)
+{
+    PT_BEGIN(pt);
+    buzzer_on();
+    PT_AWAIT_MS(pt, beep_ms);
+    buzzer_off();
+    PT_END(pt);
+}
 
 void buzzer_init(void)
 {
     // Configure buzzer pin as output
-    DDRA |= (1 << BUZZER_PIN);
+    hal_gpio_output(A, 1 << BUZZER_PIN);
     
     // Ensure buzzer is off initially
     buzzer_off();
@@ -15,20 +30,38 @@ void buzzer_init(void)
 void buzzer_on(void)
 {
     // Set buzzer pin high
-    PORTA |= (1 << BUZZER_PIN);
+    hal_gpio_set(A, 1 << BUZZER_PIN);
+    TRACE_EVENT(TRACE_BUZZER_ON, 0);
 }
 
 void buzzer_off(void)
 {
     // Set buzzer pin low
-    PORTA &= ~(1 << BUZZER_PIN);
+    hal_gpio_clear(A, 1 << BUZZER_PIN);
+    TRACE_EVENT(TRACE_BUZZER_OFF, 0);
 }
 
+// Sound the buzzer for duration_ms without blocking: it starts now and
+// buzzer_poll() ends it. A ringing alarm owns the buzzer, so no beep then.
 void buzzer_beep(uint16_t duration_ms)
 {
-    buzzer_on();
-    _delay_ms(duration_ms);
-    buzzer_off();
+    if (alarm_is_ringing()) {
+        return;
+    }
+    beep_ms = duration_ms;
+    PT_INIT(&beep);
+    buzzer_beep_thread(&beep);
+}
+
+// Every main loop pass: run the beep. An alarm that starts ringing during
+// one takes the buzzer over, and the beep ends without switching it off.
+void buzzer_poll(void)
+{
+    if (alarm_is_ringing()) {
+        PT_STOP(&beep);
+    } else if (PT_RUNNING(&beep)) {
+        buzzer_beep_thread(&beep);
+    }
 }
 
 void buzzer_tone(uint16_t frequency, uint16_t duration_ms)
@@ -37,8 +70,8 @@ void buzzer_tone(uint16_t frequency, uint16_t duration_ms)
     
     for (uint16_t i = 0; i < cycles; i++) {
         buzzer_on();
-        _delay_us(500000 / frequency);  // Half period
+        hal_delay_us(500000 / frequency);  // Half period
         buzzer_off();
-        _delay_us(500000 / frequency);  // Half period
+        hal_delay_us(500000 / frequency);  // Half period
     }
 } 
\ No newline at end of file
@@ -11,6 +11,7 @@ void buzzer_init(void);
 void buzzer_on(void);
 void buzzer_off(void);
 void buzzer_beep(uint16_t duration_ms);
+void buzzer_poll(void);
 void buzzer_tone(uint16_t frequency, uint16_t duration_ms);
 
 #endif // BUZZER_H 
\ No newline at end of file
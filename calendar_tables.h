@@ -0,0 +1,24 @@
+#ifndef CALENDAR_TABLES_H
+#define CALENDAR_TABLES_H
+
+#include <stdint.h>
+#include <avr/pgmspace.h>
+
+// Calendar lookup tables in flash, generated at build time by tools/calgen.c
+// into calendar_tables.c and verified by tools/calcheck.c (make check-tables)
+
+// 2000 to 2136, the whole range of the 32-bit epoch (2136-02-07 06:28:15);
+// the clock and the editors stay within 2000-2099
+#define CALENDAR_FIRST_YEAR     2000
+#define CALENDAR_YEARS          137
+
+// Days before the first of each month, [leap][month - 1]; entry 12 is the year length
+extern const uint16_t calendar_days_before_month[2][13] PROGMEM;
+
+// Days from 2000-01-01 to January 1st of each year; the extra entry is 2137-01-01
+extern const uint16_t calendar_year_start[CALENDAR_YEARS + 1] PROGMEM;
+
+// Weekday of January 1st of each year, 0=Monday..6=Sunday
+extern const uint8_t calendar_jan1_weekday[CALENDAR_YEARS] PROGMEM;
+
+#endif // CALENDAR_TABLES_H 
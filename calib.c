@@ -0,0 +1,152 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include "hal.h"
+#include "calib.h"
+#include "rtc.h"
+#include "timebase.h"
+#include "settings.h"
+#include "telemetry.h"
+
+#define MAX_GAP_COUNTS      (CALIB_MAX_GAP_MS * 125UL / 16)
+
+typedef enum {
+    CALIB_OFF,          // No chip to measure against (RTC_CAP_CLOCK)
+    CALIB_START,        // Capture the window start on the next tick
+    CALIB_WINDOW,       // Window running
+    CALIB_CAPTURE       // Looking for a rollover
+} calib_state_t;
+
+static calib_state_t state = CALIB_START;
+static bool window_open = false;        // The capture ends a window
+
+// Window start: rollover stamp and the epoch the RTC reached there
+static uint32_t start_stamp = 0;
+static epoch_t start_epoch = 0;
+static uint8_t start_writes = 0;
+
+// Capture: seconds register and stamp of the last read
+static uint8_t last_second = RTC_NO_SECOND;
+static uint32_t last_stamp = 0;
+
+void calib_init(void)
+{
+    // The software clock counts the tick itself: nothing to measure
+    state = (rtc_caps() & RTC_CAP_CLOCK) ? CALIB_START : CALIB_OFF;
+    window_open = false;
+}
+
+// Epoch at which the seconds register reads second, within a minute
+// after the shadow clock
+static epoch_t calib_epoch_of(uint8_t second)
+{
+    epoch_t now = rtc_now();
+    uint8_t now_second = now % 60;
+    
+    return now - now_second + second + (second < now_second ? 60 : 0);
+}
+
+// Start a capture; the first read of calib_poll() is its reference
+static void calib_capture(void)
+{
+    last_second = RTC_NO_SECOND;
+    state = CALIB_CAPTURE;
+}
+
+// Window over: apply the period it measured and start the next one there
+static void calib_finish(uint32_t stamp, epoch_t epoch)
+{
+    uint32_t seconds = epoch - start_epoch;
+    uint32_t counts = stamp - start_stamp;
+    uint32_t period;
+    uint32_t rest;
+    
+    if (window_open && rtc_clock_writes() == start_writes && seconds > 0) {
+        // Whole counts per second, then the 16 fraction bits one at a time
+        period = counts / seconds;
+        rest = counts % seconds;
+        for (uint8_t bit = 0; bit < 16; bit++) {
+            rest <<= 1;
+            period <<= 1;
+            if (rest >= seconds) {
+                rest -= seconds;
+                period |= 1;
+            }
+        }
+        if (timebase_set_period(period)) {
+            settings_changed();
+            // Counts per second in thousandths
+            telemetry_event(PSTR("calib"), (period >> 16) * 1000 + (((period & 0xFFFF) * 1000) >> 16));
+        }
+    }
+    
+    start_stamp = stamp;
+    start_epoch = epoch;
+    start_writes = rtc_clock_writes();
+    window_open = true;
+    state = CALIB_WINDOW;
+}
+
+// Once per tick, after rtc_sync()
+void calib_tick(void)
+{
+    switch (state) {
+        case CALIB_START:
+            window_open = false;
+            calib_capture();
+            break;
+        
+        case CALIB_WINDOW:
+            // A clock write restarted the RTC's second: start over
+            if (rtc_clock_writes() != start_writes) {
+                window_open = false;
+                calib_capture();
+            } else if (rtc_now() - start_epoch >= CALIB_WINDOW_S) {
+                calib_capture();
+            }
+            break;
+        
+        case CALIB_OFF:
+        case CALIB_CAPTURE:
+            break;
+    }
+}
+
+// Every main loop pass: read the seconds register while capturing
+void calib_poll(void)
+{
+    uint32_t stamp, gap;
+    uint8_t second;
+    
+    if (state != CALIB_CAPTURE) {
+        return;
+    }
+    
+    stamp = timebase_now();
+    second = rtc_read_second();
+    
+    if (second >= 60) {
+        // Bus error or a halted clock: try again on the next second
+        state = window_open ? CALIB_WINDOW : CALIB_START;
+        return;
+    }
+    if (last_second == RTC_NO_SECOND || second == last_second) {
+        last_second = second;
+        last_stamp = stamp;
+        return;
+    }
+    
+    // The register moved between the last read and this one
+    gap = stamp - last_stamp;
+    if (gap > MAX_GAP_COUNTS || second != (last_second + 1) % 60) {
+        last_second = RTC_NO_SECOND;
+        state = window_open ? CALIB_WINDOW : CALIB_START;
+        return;
+    }
+    calib_finish(last_stamp + gap / 2, calib_epoch_of(second));
+}
+
+// The main loop polls quickly while this is true
+bool calib_is_capturing(void)
+{
+    return state == CALIB_CAPTURE;
+}
@@ -0,0 +1,37 @@
+#ifndef CALIB_H
+#define CALIB_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Tick calibration against the RTC. The chip's second is the reference:
+// a window starts and ends on a rollover of its seconds register, time
+// stamped on the Timer1 time base, and the counts over the window divided
+// by its seconds give the tick period (timebase.h). Windows follow each
+// other, each ending where the next starts; a measured period is applied
+// and saved with the settings. Without a chip (RTC_CAP_CLOCK) the clock
+// is the tick itself and calibration stays off.
+//
+// The rollover is found by reading the seconds register on every main
+// loop pass, which shortens its pause to CALIB_POLL_MS until the register
+// moves, about half a second on average. The stamp is the middle of the
+// two reads around the move, so a window end is good to about 5 ms: over
+// CALIB_WINDOW_S that is below 1 ppm.
+
+// Seconds of RTC time per measurement window
+#define CALIB_WINDOW_S          14400UL
+
+// Main loop pause while looking for a rollover
+#define CALIB_POLL_MS           10
+
+// Reads further apart than this around a rollover leave it too vague;
+// the capture is tried again on the next second
+#define CALIB_MAX_GAP_MS        20
+
+// Function prototypes
+void calib_init(void);
+void calib_tick(void);
+void calib_poll(void);
+bool calib_is_capturing(void);
+
+#endif // CALIB_H 
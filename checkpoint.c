@@ -0,0 +1,112 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include "checkpoint.h"
+#include "rtc.h"
+#include "stopwatch.h"
+#include "countdown.h"
+#include "settings.h"
+#include "timebase.h"
+
+// Timer state at the last checkpoint, used to detect state changes
+static uint8_t saved_flags = 0;
+static uint32_t saved_stopwatch = 0;
+static uint16_t saved_countdown = 0;
+
+// Running timers count on the tick (timebase_seconds()), the record holds
+// UTC instants: the clock's offset from the tick when it was written
+static int32_t saved_offset = 0;
+
+// UTC minus the tick count; moves when the clock is set or the chip
+// corrects it
+static int32_t checkpoint_offset(void)
+{
+    return (int32_t)(rtc_now() - timebase_seconds());
+}
+
+// Snapshot the running flags for comparison with the last checkpoint
+static uint8_t checkpoint_flags(void)
+{
+    uint8_t flags = 0;
+    
+    if (stopwatch_is_running()) flags |= CHECKPOINT_STOPWATCH_RUNNING;
+    if (countdown_is_running()) flags |= CHECKPOINT_COUNTDOWN_RUNNING;
+    return flags;
+}
+
+// Restore timers from NVRAM at boot; running timers resume with the time
+// that passed while the MCU was down
+void checkpoint_restore(void)
+{
+    checkpoint_t record;
+    epoch_t now;
+    
+    if (!rtc_read_nvram(CHECKPOINT_NVRAM_OFFSET, &record, sizeof(record))) {
+        return;
+    }
+    if (record.magic != CHECKPOINT_MAGIC ||
+        record.crc != settings_crc8((const uint8_t*)&record, sizeof(record) - 1)) {
+        return;
+    }
+    
+    now = rtc_now();
+    
+    if (record.flags & CHECKPOINT_STOPWATCH_RUNNING) {
+        stopwatch_set_seconds(now > record.stopwatch ? now - record.stopwatch : 0);
+        stopwatch_start(timebase_now());
+    } else {
+        stopwatch_set_seconds(record.stopwatch);
+    }
+    
+    if (record.flags & CHECKPOINT_COUNTDOWN_RUNNING) {
+        // A countdown that ran out while the power was off stays at 00:00
+        countdown_set_remaining(record.countdown > now ? record.countdown - now : 0);
+        if (countdown_get_time() > 0) {
+            countdown_start();
+        }
+    } else {
+        countdown_set_remaining((uint16_t)record.countdown);
+    }
+    
+    saved_flags = checkpoint_flags();
+    saved_stopwatch = stopwatch_get_seconds();
+    saved_countdown = countdown_get_time();
+    saved_offset = checkpoint_offset();
+}
+
+// Write a new checkpoint whenever a timer changes state. Running values
+// advance by themselves, so only the flags and the stopped values count,
+// and the instants of running timers once the clock moved against the
+// tick they run on (a second either way is the tick's phase, not a move).
+// Called every main loop pass; costs no I2C traffic unless something changed.
+void checkpoint_service(void)
+{
+    checkpoint_t record;
+    uint8_t flags = checkpoint_flags();
+    uint32_t stopwatch = stopwatch_get_seconds();
+    uint16_t countdown = countdown_get_time();
+    int32_t offset = checkpoint_offset();
+    epoch_t now;
+    
+    if (flags == saved_flags &&
+        ((flags & CHECKPOINT_STOPWATCH_RUNNING) || stopwatch == saved_stopwatch) &&
+        ((flags & CHECKPOINT_COUNTDOWN_RUNNING) || countdown == saved_countdown) &&
+        (flags == 0 || (offset - saved_offset >= -1 && offset - saved_offset <= 1))) {
+        return;
+    }
+    
+    saved_flags = flags;
+    saved_stopwatch = stopwatch;
+    saved_countdown = countdown;
+    saved_offset = offset;
+    
+    now = rtc_now();
+    
+    record.magic = CHECKPOINT_MAGIC;
+    record.flags = flags;
+    record.stopwatch = (flags & CHECKPOINT_STOPWATCH_RUNNING) ? now - stopwatch : stopwatch;
+    record.countdown = (flags & CHECKPOINT_COUNTDOWN_RUNNING) ? now + countdown : countdown;
+    record.crc = settings_crc8((const uint8_t*)&record, sizeof(record) - 1);
+    
+    // NVRAM has no wear limit, so every state change is written immediately
+    rtc_write_nvram(CHECKPOINT_NVRAM_OFFSET, &record, sizeof(record));
+}
@@ -0,0 +1,29 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Location of the record in the RTC's battery-backed RAM
+#define CHECKPOINT_NVRAM_OFFSET     0
+#define CHECKPOINT_MAGIC            0xC7
+
+// Checkpoint flags
+#define CHECKPOINT_STOPWATCH_RUNNING    0x01
+#define CHECKPOINT_COUNTDOWN_RUNNING    0x02
+
+// Timer checkpoint as stored in RTC NVRAM. Timestamps are RTC epoch
+// values, so elapsed time survives a reset or brownout.
+typedef struct {
+    uint8_t magic;
+    uint8_t flags;
+    uint32_t stopwatch;     // Running: start epoch, stopped: elapsed seconds
+    uint32_t countdown;     // Running: end epoch, stopped: seconds left
+    uint8_t crc;            // CRC-8 over all preceding bytes
+} __attribute__((packed)) checkpoint_t;
+
+// Function prototypes
+void checkpoint_restore(void);
+void checkpoint_service(void);
+
+#endif // CHECKPOINT_H 
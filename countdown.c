@@ -1,21 +1,27 @@
-#include <avr/io.h>
 #include <stdint.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include "countdown.h"
 #include "lcd.h"
 #include "buzzer.h"
+#include "timebase.h"
+#include "eventlog.h"
+#include "mode.h"
 
-// Countdown variables
-static uint16_t countdown_time = 0;
-static uint16_t countdown_current = 0;
+// Countdown variables: while running, the time left is derived from the
+// end on the tick count (timebase_seconds()), which clock writes do not
+// move. Only the checkpoint turns it into a UTC instant, and rewrites it
+// when the clock moves (checkpoint.c), so a reset restores the same time.
+static uint16_t countdown_time = 0;        // Preset
+static uint16_t countdown_current = 0;     // Time left while stopped
+static uint32_t countdown_end = 0;         // End tick while running
 static countdown_state_t countdown_state = COUNTDOWN_STOPPED;
 
 // Initialize countdown
 void countdown_init(void)
 {
-    countdown_time = 0;
-    countdown_current = 0;
+    countdown_time = COUNTDOWN_DEFAULT_SECONDS;
+    countdown_current = COUNTDOWN_DEFAULT_SECONDS;
     countdown_state = COUNTDOWN_STOPPED;
 }
 
@@ -23,14 +29,24 @@ void countdown_init(void)
 void countdown_set(uint16_t seconds)
 {
     countdown_time = seconds;
+    countdown_set_remaining(seconds);
+}
+
+// Set the time left without changing the preset
+void countdown_set_remaining(uint16_t seconds)
+{
     countdown_current = seconds;
+    countdown_end = timebase_seconds() + seconds;
+    mode_dirty(MODE_DIRTY_COUNTDOWN);
 }
 
 // Start countdown
 void countdown_start(void)
 {
     if (countdown_state == COUNTDOWN_STOPPED && countdown_time > 0) {
+        countdown_end = timebase_seconds() + countdown_current;
         countdown_state = COUNTDOWN_RUNNING;
+        mode_dirty(MODE_DIRTY_COUNTDOWN);
     }
 }
 
@@ -38,7 +54,9 @@ void countdown_start(void)
 void countdown_stop(void)
 {
     if (countdown_state == COUNTDOWN_RUNNING) {
+        countdown_current = countdown_get_time();
         countdown_state = COUNTDOWN_STOPPED;
+        mode_dirty(MODE_DIRTY_COUNTDOWN);
     }
 }
 
@@ -47,13 +65,21 @@ void countdown_reset(void)
 {
     countdown_current = countdown_time;
     countdown_state = COUNTDOWN_STOPPED;
+    mode_dirty(MODE_DIRTY_COUNTDOWN);
 }
 
-// Update countdown (called every second)
+// Update countdown (called every second); the time left changes with it
 void countdown_update(void)
 {
     if (countdown_state == COUNTDOWN_RUNNING) {
-        countdown_decrement();
+        mode_dirty(MODE_DIRTY_COUNTDOWN);
+    }
+    if (countdown_state == COUNTDOWN_RUNNING && countdown_get_time() == 0) {
+        countdown_current = 0;
+        countdown_state = COUNTDOWN_FINISHED;
+        // Trigger buzzer when countdown finishes
+        buzzer_beep(1000);
+        eventlog_record(EVENTLOG_COUNTDOWN, countdown_time);
     }
 }
 
@@ -72,9 +98,20 @@ bool countdown_is_finished(void)
 // Get current countdown time
 uint16_t countdown_get_time(void)
 {
+    if (countdown_state == COUNTDOWN_RUNNING) {
+        int32_t left = (int32_t)(countdown_end - timebase_seconds());
+        return (left > 0) ? (uint16_t)left : 0;
+    }
+    
     return countdown_current;
 }
 
+// Get the preset the countdown restarts from
+uint16_t countdown_get_preset(void)
+{
+    return countdown_time;
+}
+
 // Display countdown time on LCD
 void countdown_display(void)
 {
@@ -83,20 +120,6 @@ void countdown_display(void)
     lcd_print(time_str);
 }
 
-// Decrement countdown time
-void countdown_decrement(void)
-{
-    if (countdown_current > 0) {
-        countdown_current--;
-        
-        if (countdown_current == 0) {
-            countdown_state = COUNTDOWN_FINISHED;
-            // Trigger buzzer when countdown finishes
-            buzzer_beep(1000);
-        }
-    }
-}
-
 // Format countdown time to string
 void countdown_format_time(char* buffer)
 {
@@ -108,11 +131,11 @@ void countdown_format_time(char* buffer)
 // Get minutes from countdown time
 uint8_t countdown_get_minutes(void)
 {
-    return (uint8_t)(countdown_current / 60);
+    return (uint8_t)(countdown_get_time() / 60);
 }
 
 // Get seconds from countdown time
 uint8_t countdown_get_seconds(void)
 {
-    return (uint8_t)(countdown_current % 60);
-} 
\ No newline at end of file
+    return (uint8_t)(countdown_get_time() % 60);
+}
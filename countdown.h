@@ -4,6 +4,9 @@
 #include <stdint.h>
 #include <stdbool.h>
 
+// Preset loaded at power-up when no saved settings exist
+#define COUNTDOWN_DEFAULT_SECONDS   120
+
 // Countdown states
 typedef enum {
     COUNTDOWN_STOPPED = 0,
@@ -14,6 +17,7 @@ typedef enum {
 // Function prototypes
 void countdown_init(void);
 void countdown_set(uint16_t seconds);
+void countdown_set_remaining(uint16_t seconds);
 void countdown_start(void);
 void countdown_stop(void);
 void countdown_reset(void);
@@ -21,10 +25,10 @@ void countdown_update(void);
 bool countdown_is_running(void);
 bool countdown_is_finished(void);
 uint16_t countdown_get_time(void);
+uint16_t countdown_get_preset(void);
 void countdown_display(void);
 
 // Internal functions
-void countdown_decrement(void);
 void countdown_format_time(char* buffer);
 uint8_t countdown_get_minutes(void);
 uint8_t countdown_get_seconds(void);
@@ -0,0 +1,197 @@
+#include <avr/pgmspace.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "editor.h"
+#include "buttons.h"
+#include "lcd.h"
+#include "rtc.h"
+#include "time_utils.h"
+
+// Copy descriptor index out of flash
+static void editor_load(const editor_t* editor, uint8_t index, editor_field_t* field)
+{
+    memcpy_P(field, &editor->fields[index], sizeof(*field));
+}
+
+static uint16_t editor_get(const editor_field_t* field)
+{
+    if (field->type & EDITOR_WORD) {
+        return *(uint16_t*)field->value;
+    }
+    return *(uint8_t*)field->value;
+}
+
+static void editor_set(const editor_field_t* field, uint16_t value)
+{
+    if (field->type & EDITOR_WORD) {
+        *(uint16_t*)field->value = value;
+    } else {
+        *(uint8_t*)field->value = (uint8_t)value;
+    }
+}
+
+// Upper bound, following the month and year for day-of-month fields
+static uint16_t editor_max(const editor_field_t* field)
+{
+    if (field->type & EDITOR_DAY) {
+        const date_t* date = (const date_t*)field->aux;
+        return days_in_month(date->month, date->year);
+    }
+    return field->max;
+}
+
+// Step a value through min..max
+static uint16_t editor_step_number(const editor_field_t* field, uint16_t value, bool forward)
+{
+    uint16_t max = editor_max(field);
+    bool wrap = field->type & EDITOR_WRAP;
+    
+    if (forward) {
+        if (value < max) return value + 1;
+        return wrap ? field->min : max;
+    }
+    if (value > field->min) return value - 1;
+    return wrap ? max : field->min;
+}
+
+// Step a value through the list in aux; values not in the list restart it
+static uint16_t editor_step_list(const editor_field_t* field, uint16_t value, bool forward)
+{
+    const uint8_t* list = (const uint8_t*)field->aux;
+    uint8_t count = field->max;
+    uint8_t i = 0;
+    
+    while (i < count && pgm_read_byte(&list[i]) != value) {
+        i++;
+    }
+    
+    if (i == count) {
+        i = 0;
+    } else if (forward) {
+        i = (i + 1 == count) ? 0 : i + 1;
+    } else {
+        i = (i == 0) ? count - 1 : i - 1;
+    }
+    return pgm_read_byte(&list[i]);
+}
+
+// Draw a field's value as zero-padded digits
+static void editor_draw(const editor_field_t* field)
+{
+    char digits[6];
+    uint16_t value;
+    uint8_t i;
+    
+    if (field->width == 0) {
+        return;
+    }
+    
+    value = editor_get(field);
+    digits[field->width] = '\0';
+    for (i = field->width; i > 0; i--) {
+        digits[i - 1] = '0' + value % 10;
+        value /= 10;
+    }
+    
+    lcd_goto(field->row, field->col);
+    lcd_print(digits);
+}
+
+// Pull day-of-month fields back into range after their month or year changed
+static void editor_clamp_days(const editor_t* editor)
+{
+    editor_field_t field;
+    
+    for (uint8_t i = 0; i < editor->count; i++) {
+        editor_load(editor, i, &field);
+        if ((field.type & EDITOR_DAY) && editor_get(&field) > editor_max(&field)) {
+            editor_set(&field, editor_max(&field));
+            editor_draw(&field);
+        }
+    }
+}
+
+// Standard buttons: SET selects the next field, START/STOP step the active
+// one up/down. Returns true when a value changed. Button presses are edge
+// detected, so no debounce delay is needed and only the edited field is
+// redrawn.
+bool editor_poll(editor_t* editor)
+{
+    if (button_is_pressed(BTN_SET)) {
+        editor_next(editor);
+        return false;
+    }
+    if (button_is_pressed(BTN_START)) {
+        return editor_step(editor, true);
+    }
+    if (button_is_pressed(BTN_STOP)) {
+        return editor_step(editor, false);
+    }
+    return false;
+}
+
+// Select the next field
+void editor_next(editor_t* editor)
+{
+    editor->active = (editor->active + 1 == editor->count) ? 0 : editor->active + 1;
+    editor_show_cursor(editor);
+}
+
+// Step the active field; redraws it when the editor owns its digits
+bool editor_step(editor_t* editor, bool forward)
+{
+    editor_field_t field;
+    uint16_t old_value, new_value;
+    
+    editor_load(editor, editor->active, &field);
+    old_value = editor_get(&field);
+    
+    switch (field.type & EDITOR_KIND_MASK) {
+        case EDITOR_LIST:
+            new_value = editor_step_list(&field, old_value, forward);
+            break;
+        case EDITOR_TOGGLE:
+            new_value = old_value ^ field.min;
+            break;
+        default:
+            new_value = editor_step_number(&field, old_value, forward);
+            break;
+    }
+    
+    if (new_value == old_value) {
+        return false;
+    }
+    
+    editor_set(&field, new_value);
+    editor_draw(&field);
+    editor_clamp_days(editor);
+    editor_show_cursor(editor);
+    return true;
+}
+
+// Draw every field with editor-owned digits
+void editor_render(const editor_t* editor)
+{
+    editor_field_t field;
+    
+    for (uint8_t i = 0; i < editor->count; i++) {
+        editor_load(editor, i, &field);
+        editor_draw(&field);
+    }
+}
+
+// Park the blinking cursor on the active field; call after each redraw,
+// since printing moves the cursor
+void editor_show_cursor(const editor_t* editor)
+{
+    editor_field_t field;
+    
+    editor_load(editor, editor->active, &field);
+    lcd_goto(field.row, field.col);
+    lcd_blink(true);
+}
+
+void editor_hide_cursor(void)
+{
+    lcd_blink(false);
+}
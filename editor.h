@@ -0,0 +1,45 @@
+#ifndef EDITOR_H
+#define EDITOR_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Field kinds (low bits of editor_field_t.type)
+#define EDITOR_NUMBER       0x00    // Value steps through min..max
+#define EDITOR_LIST         0x01    // Value steps through the PROGMEM byte list in aux
+#define EDITOR_TOGGLE       0x02    // The bits of min are flipped in the value
+#define EDITOR_KIND_MASK    0x0F
+
+// Field flags
+#define EDITOR_WORD         0x10    // Value is a uint16_t (default uint8_t)
+#define EDITOR_WRAP         0x20    // Step past either end to the other (default clamp)
+#define EDITOR_DAY          0x40    // max is the length of the month of the date_t in aux
+
+// Field descriptor, kept in flash. Each editing mode is a table of these.
+typedef struct {
+    void* value;            // Edited variable
+    const void* aux;        // EDITOR_LIST: PROGMEM list, EDITOR_DAY: date_t
+    uint16_t min;           // EDITOR_TOGGLE: bits to flip
+    uint16_t max;           // EDITOR_LIST: list length
+    uint8_t type;           // Kind | flags
+    uint8_t row;            // Display position of the field (and its cursor)
+    uint8_t col;
+    uint8_t width;          // Digits drawn by the editor, 0 = drawn by the mode
+} editor_field_t;
+
+// Editor state: a field table and the active field
+typedef struct {
+    const editor_field_t* fields;   // PROGMEM
+    uint8_t count;
+    uint8_t active;
+} editor_t;
+
+// Function prototypes
+bool editor_poll(editor_t* editor);
+void editor_next(editor_t* editor);
+bool editor_step(editor_t* editor, bool forward);
+void editor_render(const editor_t* editor);
+void editor_show_cursor(const editor_t* editor);
+void editor_hide_cursor(void);
+
+#endif // EDITOR_H 
@@ -0,0 +1,266 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "hal.h"
+#include "eventlog.h"
+#include "i2c_bus.h"
+#include "rtc.h"
+#include "settings.h"
+#include "telemetry.h"
+#include "timebase.h"
+#include "pt.h"
+
+// Newest page: the records written to the EEPROM and the ones moved in
+// from the staging ring since
+static eventlog_page_t head;
+static uint8_t written = 0;             // Records of head on the EEPROM
+
+// Whether the EEPROM answered at boot; without it the log is off
+static bool present = false;
+
+// Writer thread (eventlog_poll()): records of the page write in its
+// write cycle, and whether the EEPROM answered again
+static pt_t writer;
+static uint8_t write_count = 0;
+static bool write_done = false;
+
+// Seconds until the records of head not yet written are flushed
+static uint8_t flush_ticks = 0;
+
+// Records waiting for room in head
+static eventlog_record_t staged[EVENTLOG_STAGED];
+static uint8_t staged_first = 0;
+static uint8_t staged_count = 0;
+
+// Counters, saturating
+static uint16_t dropped = 0;
+static uint16_t errors = 0;
+
+static void eventlog_error(void)
+{
+    if (errors < UINT16_MAX) {
+        errors++;
+    }
+    telemetry_event(PSTR("log_err"), errors);
+}
+
+// The EEPROM answers its address unless a write cycle is running
+static bool eventlog_ready(void)
+{
+    return i2c_probe(EVENTLOG_I2C_ADDRESS);
+}
+
+static bool eventlog_valid(const eventlog_page_t* page)
+{
+    return page->count >= 1 && page->count <= EVENTLOG_PAGE_RECORDS &&
+           page->crc == settings_crc8((const uint8_t*)page, sizeof(*page) - 1);
+}
+
+// Read an EEPROM page; EVENTLOG_PAGE_BUSY while a write cycle runs, which
+// is not waited out, and after a failed transfer
+static uint8_t eventlog_read(uint8_t index, eventlog_page_t* page)
+{
+    uint16_t address = (uint16_t)index * EVENTLOG_PAGE_SIZE;
+    uint8_t header[2] = {address >> 8, address & 0xFF};
+    
+    if (!eventlog_ready()) {
+        return EVENTLOG_PAGE_BUSY;
+    }
+    if (!i2c_read(EVENTLOG_I2C_ADDRESS, header, sizeof(header), (uint8_t*)page, sizeof(*page))) {
+        eventlog_error();
+        return EVENTLOG_PAGE_BUSY;
+    }
+    return EVENTLOG_PAGE_OK;
+}
+
+// A page read at boot that holds a valid page
+static bool eventlog_load(uint8_t index, eventlog_page_t* page)
+{
+    return eventlog_read(index, page) == EVENTLOG_PAGE_OK && eventlog_valid(page);
+}
+
+// Send head to its EEPROM page; the write cycle starts at the stop
+static bool eventlog_write(void)
+{
+    uint16_t address = (uint16_t)(head.sequence % EVENTLOG_PAGES) * EVENTLOG_PAGE_SIZE;
+    uint8_t header[2] = {address >> 8, address & 0xFF};
+    
+    head.crc = settings_crc8((const uint8_t*)&head, sizeof(head) - 1);
+    return i2c_write(EVENTLOG_I2C_ADDRESS, header, sizeof(header),
+                     (const uint8_t*)&head, sizeof(head));
+}
+
+static void eventlog_next_page(void)
+{
+    head.sequence++;
+    head.count = 0;
+    memset(head.records, 0, sizeof(head.records));
+    written = 0;
+}
+
+// Find the newest page and log the boot (after rtc_sync(), for its time);
+// an EEPROM that does not answer turns the log off
+void eventlog_init(uint8_t reset_cause)
+{
+    eventlog_page_t page;
+    uint8_t low = 0;
+    uint8_t high = EVENTLOG_PAGES - 1;
+    uint8_t middle;
+    
+    head.sequence = 0;
+    head.count = 0;
+    
+    // A reset during a page write leaves the EEPROM in its write cycle,
+    // which does not answer either: give it the time the writer would
+    for (uint8_t ms = 0; !(present = eventlog_ready()); ms++) {
+        if (ms == EVENTLOG_WRITE_TIMEOUT_MS) {
+            return;
+        }
+        hal_delay_ms(1);
+    }
+    
+    // Page 0 starts each lap, and the pages after it that follow on from
+    // its sequence are this lap's. A torn write of page 0 itself leaves
+    // page EVENTLOG_PAGES - 1 as the newest.
+    if (eventlog_load(0, &page) && page.sequence % EVENTLOG_PAGES == 0) {
+        head = page;
+        while (low < high) {
+            middle = (low + high + 1) / 2;
+            if (eventlog_load(middle, &page) &&
+                page.sequence == (uint16_t)(head.sequence + middle - low)) {
+                head = page;
+                low = middle;
+            } else {
+                high = middle - 1;
+            }
+        }
+    } else if (eventlog_load(EVENTLOG_PAGES - 1, &page) &&
+               page.sequence % EVENTLOG_PAGES == EVENTLOG_PAGES - 1) {
+        head.sequence = page.sequence + 1;
+    }
+    
+    // A full page is closed, a partial one fills on
+    written = head.count;
+    if (head.count == EVENTLOG_PAGE_RECORDS) {
+        eventlog_next_page();
+    }
+    
+    eventlog_record(EVENTLOG_POWER_UP, reset_cause);
+}
+
+// Stage an event at the current time; no I2C traffic
+void eventlog_record(uint8_t id, uint16_t arg)
+{
+    eventlog_record_t* record;
+    
+    if (!present) {
+        return;
+    }
+    if (staged_count == EVENTLOG_STAGED) {
+        if (dropped < UINT16_MAX) {
+            dropped++;
+        }
+        return;
+    }
+    
+    record = &staged[(staged_first + staged_count) % EVENTLOG_STAGED];
+    record->epoch = rtc_now();
+    record->id = id;
+    record->arg = arg;
+    staged_count++;
+}
+
+// Count down to the flush of a partly filled page (called on the 1 Hz tick)
+void eventlog_tick(void)
+{
+    if (flush_ticks > 0) {
+        flush_ticks--;
+    }
+}
+
+// Move staged records into head; true when head is due to be written
+// (full, or its first unwritten record waited EVENTLOG_FLUSH_S)
+static bool eventlog_fill(void)
+{
+    while (staged_count > 0 && head.count < EVENTLOG_PAGE_RECORDS) {
+        if (head.count == written) {
+            flush_ticks = EVENTLOG_FLUSH_S;
+        }
+        head.records[head.count++] = staged[staged_first];
+        staged_first = (staged_first + 1) % EVENTLOG_STAGED;
+        staged_count--;
+    }
+    return head.count > written && (head.count == EVENTLOG_PAGE_RECORDS || flush_ticks == 0);
+}
+
+// Write head when it is due and wait out the write cycle; a write that
+// fails or a cycle that does not end is retried at the next flush
+static bool eventlog_writer(pt_t* pt)
+{
+    PT_BEGIN(pt);
+    for (;;) {
+        PT_WAIT_UNTIL(pt, eventlog_fill());
+        if (!eventlog_write()) {
+            flush_ticks = EVENTLOG_FLUSH_S;
+            eventlog_error();
+            PT_YIELD(pt);
+            continue;
+        }
+        write_count = head.count;
+        
+        PT_AWAIT_I2C(pt, EVENTLOG_I2C_ADDRESS, EVENTLOG_WRITE_TIMEOUT_MS, write_done);
+        if (!write_done) {
+            flush_ticks = EVENTLOG_FLUSH_S;
+            eventlog_error();
+            PT_YIELD(pt);
+            continue;
+        }
+        written = write_count;
+        if (written == EVENTLOG_PAGE_RECORDS) {
+            eventlog_next_page();
+        }
+    }
+    PT_END(pt);
+}
+
+// Every main loop pass: run the writer
+void eventlog_poll(void)
+{
+    if (present) {
+        eventlog_writer(&writer);
+    }
+}
+
+// Page back pages before the newest (0: the newest, records not yet
+// written included); EVENTLOG_PAGE_NONE past the oldest and without the
+// EEPROM, EVENTLOG_PAGE_BUSY during a write cycle
+uint8_t eventlog_read_page(uint8_t back, eventlog_page_t* page)
+{
+    uint16_t sequence = head.sequence - back;
+    uint8_t status;
+    
+    if (!present || back >= EVENTLOG_PAGES) {
+        return EVENTLOG_PAGE_NONE;
+    }
+    if (back == 0) {
+        *page = head;
+        return EVENTLOG_PAGE_OK;
+    }
+    status = eventlog_read(sequence % EVENTLOG_PAGES, page);
+    if (status == EVENTLOG_PAGE_OK && !(eventlog_valid(page) && page->sequence == sequence)) {
+        status = EVENTLOG_PAGE_NONE;
+    }
+    return status;
+}
+
+// Events lost to a full staging ring since boot
+uint16_t eventlog_dropped(void)
+{
+    return dropped;
+}
+
+// Page transfers the EEPROM did not answer or finish since boot
+uint16_t eventlog_errors(void)
+{
+    return errors;
+}
@@ -0,0 +1,74 @@
+#ifndef EVENTLOG_H
+#define EVENTLOG_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Event log in the AT24C32 EEPROM of the RTC module. Events are staged in
+// RAM as they happen and written a page at a time: a page holds
+// EVENTLOG_PAGE_RECORDS records behind a sequence number and ends in the
+// CRC-8 of settings_crc8(). Page n of the log goes to EEPROM page
+// n % EVENTLOG_PAGES, so the log is circular and the newest page at boot
+// is the last one whose sequence follows on from page 0's: a binary
+// search finds it in 7 page reads, and a page that was not full is
+// filled on from there.
+//
+// A page is written once it is full or EVENTLOG_FLUSH_S seconds after
+// the first record it has not written yet, so a partly filled page is
+// written again as it fills. The EEPROM's write cycle (up to 10 ms) is
+// not waited out: later main loop passes poll its address until it
+// acknowledges again, and a page read during one reports the EEPROM busy
+// instead of waiting. At boot the EEPROM is polled for up to
+// EVENTLOG_WRITE_TIMEOUT_MS, as a reset may have cut into a write cycle;
+// a module without one leaves the log off.
+
+// I2C address: 0x57 on DS3231 modules, which pull A0-A2 high; 0x50 on
+// DS1307 "Tiny RTC" boards
+#ifndef EVENTLOG_I2C_ADDRESS
+#define EVENTLOG_I2C_ADDRESS    0x57
+#endif
+
+#define EVENTLOG_PAGE_SIZE      32
+#define EVENTLOG_PAGES          128     // AT24C32: 4 KB
+#define EVENTLOG_PAGE_RECORDS   4
+#define EVENTLOG_STAGED         8       // RAM records waiting for a page
+#define EVENTLOG_FLUSH_S        30
+
+// A write cycle that has not ended after this is an I2C error
+#define EVENTLOG_WRITE_TIMEOUT_MS   20
+
+// eventlog_read_page() results
+#define EVENTLOG_PAGE_OK        0
+#define EVENTLOG_PAGE_BUSY      1       // Write cycle or failed transfer: try again
+#define EVENTLOG_PAGE_NONE      2       // Past the oldest page, or no EEPROM
+
+// Events and their argument
+#define EVENTLOG_POWER_UP       1       // Reset cause (HAL_RESET_* bits)
+#define EVENTLOG_TIME_CHANGED   2       // Seconds the clock moved, signed and clamped
+#define EVENTLOG_ALARM          3       // Alarm slot, from 1
+#define EVENTLOG_COUNTDOWN      4       // Countdown preset in seconds
+#define EVENTLOG_I2C_ERROR      5       // RTC reads rejected since boot
+
+typedef struct {
+    uint32_t epoch;                 // UTC, seconds since 2000-01-01
+    uint8_t id;                     // EVENTLOG_*
+    uint16_t arg;
+} __attribute__((packed)) eventlog_record_t;
+
+typedef struct {
+    uint16_t sequence;              // Pages written before this one
+    uint8_t count;                  // Records used, 1 to EVENTLOG_PAGE_RECORDS
+    eventlog_record_t records[EVENTLOG_PAGE_RECORDS];
+    uint8_t crc;                    // CRC-8 over all preceding bytes
+} __attribute__((packed)) eventlog_page_t;
+
+// Function prototypes
+void eventlog_init(uint8_t reset_cause);
+void eventlog_record(uint8_t id, uint16_t arg);
+void eventlog_tick(void);
+void eventlog_poll(void);
+uint8_t eventlog_read_page(uint8_t back, eventlog_page_t* page);
+uint16_t eventlog_dropped(void);
+uint16_t eventlog_errors(void);
+
+#endif // EVENTLOG_H 
@@ -0,0 +1,46 @@
+#ifndef HAL_H
+#define HAL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Hardware abstraction layer: GPIO, delays, the 1 Hz tick, I2C, EEPROM,
+// USART, reset cause and interrupt masking. Drivers use only these.
+//
+// hal_avr.h maps everything onto the ATmega32 registers with macros and
+// inline functions, so the firmware compiles to the same code as with
+// direct register access. host/hal_host.h (HAL_HOST, make host) backs the
+// same calls with simulated devices so the whole firmware runs on Linux.
+//
+// GPIO calls take the port letter and a bit mask:
+//   hal_gpio_output(D, 1 << LCD_EN_PIN);  hal_gpio_set(D, 1 << LCD_EN_PIN);
+
+// Reset cause bits returned by hal_reset_cause()
+#define HAL_RESET_POWER_ON      0x01
+#define HAL_RESET_BROWNOUT      0x02
+#define HAL_RESET_WATCHDOG      0x04
+
+#ifdef HAL_HOST
+#include "hal_host.h"
+#else
+#include "hal_avr.h"
+#endif
+
+// I2C master, byte level (hal_i2c.c bit-bangs PC0/PC1 on the AVR; i2c_bus.h
+// builds transactions on it). A write returns whether the slave
+// acknowledged the byte. A slave may stretch the clock for up to
+// HAL_I2C_STRETCH_US; past that the transfer is abandoned, writes return
+// false and reads 0xFF until the next start, and hal_i2c_timed_out() is
+// true. A start fails if the bus is not free, typically a slave that a
+// reset cut off mid-byte holding SDA low: hal_i2c_recover() clocks it free.
+#define HAL_I2C_STRETCH_US      200
+
+void hal_i2c_init(void);
+bool hal_i2c_start(void);
+void hal_i2c_stop(void);
+bool hal_i2c_write(uint8_t data);
+uint8_t hal_i2c_read(bool ack);
+bool hal_i2c_timed_out(void);
+bool hal_i2c_recover(void);
+
+#endif // HAL_H 
@@ -0,0 +1,150 @@
+#ifndef HAL_AVR_H
+#define HAL_AVR_H
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/eeprom.h>
+#include <util/delay.h>
+
+// ATmega32 backend of hal.h. Everything expands to the register accesses
+// the drivers used before, so sbi/cbi/in/out are generated as before.
+
+// GPIO (port is the letter A-D)
+#define hal_gpio_output(port, mask)     (DDR##port |= (mask))
+#define hal_gpio_input(port, mask)      (DDR##port &= ~(mask))
+#define hal_gpio_set(port, mask)        (PORT##port |= (mask))
+#define hal_gpio_clear(port, mask)      (PORT##port &= ~(mask))
+#define hal_gpio_read(port)             (PIN##port)
+
+// Busy-wait delays (compile-time constants keep them exact)
+#define hal_delay_ms(ms)                _delay_ms(ms)
+#define hal_delay_us(us)                _delay_us(us)
+
+// Pause between main-loop polls; nothing to do meanwhile
+#define hal_idle_ms(ms)                 _delay_ms(ms)
+
+// Benchmark marker (make bench). SPI is not used and stays disabled, so a
+// write to SPDR reaches no pin; simavr reports it to tools/bench.c.
+#define hal_bench_mark(code)            (SPDR = (code))
+
+// Interrupt masking
+#define hal_irq_enable()                sei()
+#define hal_irq_disable()               cli()
+
+static inline uint8_t hal_irq_save(void)
+{
+    uint8_t sreg = SREG;
+    cli();
+    return sreg;
+}
+
+static inline void hal_irq_restore(uint8_t sreg)
+{
+    SREG = sreg;
+}
+
+// 1 Hz tick: Timer1 in CTC mode with prescaler 1024.
+// 8 MHz / 1024 = 7812.5 Hz; a compare value of 7811 gives 7812 counts.
+// The time base (timebase.c) sets each following period so that the
+// half count, and the crystal error it measured, are made up.
+#define HAL_TICK_ISR()                  ISR(TIMER1_COMPA_vect)
+
+static inline void hal_tick_start(void)
+{
+    TCCR1A = 0x00;
+    TCCR1B = (1 << WGM12) | (1 << CS12) | (1 << CS10); // CTC mode, prescaler 1024
+    OCR1A = 7811; // Compare value for 1 second
+    TIMSK |= (1 << OCIE1A); // Enable Timer1 compare interrupt
+}
+
+// Position inside the current tick, in Timer1 counts (0 to the period - 1)
+#define HAL_TICK_COUNTS                 7812
+#define HAL_TICK_COUNT_US               128
+#define hal_tick_phase()                (TCNT1)
+
+// Timer1 counts per second in 1/65536 counts (F_CPU / 1024 << 16)
+#define HAL_TICK_RATE_Q16               ((uint32_t)F_CPU * 64UL)
+
+// Period of the tick that is running, from the tick ISR. CTC mode has no
+// double buffering: the new compare value applies to the period that
+// started at the match.
+#define hal_tick_set_period(counts)     (OCR1A = (counts) - 1)
+
+// Compare match not yet handled (the ISR clears the flag)
+#define hal_tick_pending()              (TIFR & (1 << OCF1A))
+
+// 1 kHz keypad scan: Timer2 in CTC mode with prescaler 64.
+// 8 MHz / 64 = 125 kHz; a compare value of 124 gives 125 counts.
+#define HAL_SCAN_PERIOD_US              1000
+#define HAL_SCAN_ISR()                  ISR(TIMER2_COMP_vect)
+
+static inline void hal_scan_start(void)
+{
+    TCCR2 = (1 << WGM21) | (1 << CS22); // CTC mode, prescaler 64
+    OCR2 = 124;
+    TIMSK |= (1 << OCIE2); // Enable Timer2 compare interrupt
+}
+
+// Free-running cycle counter for the profiler (hal_cycles.c, PROF builds):
+// Timer0 at clk/8, extended to 32 bits by its overflow interrupt
+void hal_cycles_start(void);
+uint32_t hal_cycles(void);
+
+// Stack high-water mark (hal_stack.c): bytes below RAMEND the stack has
+// reached since reset, from the paint laid down before main()
+uint16_t hal_stack_used(void);
+
+// Reset cause (HAL_RESET_* bits), cleared once read
+static inline uint8_t hal_reset_cause(void)
+{
+    uint8_t flags = MCUCSR;
+    uint8_t cause = 0;
+    
+    MCUCSR = 0;
+    if (flags & (1 << PORF)) cause |= HAL_RESET_POWER_ON;
+    if (flags & (1 << BORF)) cause |= HAL_RESET_BROWNOUT;
+    if (flags & (1 << WDRF)) cause |= HAL_RESET_WATCHDOG;
+    return cause;
+}
+
+// RAM left alone by the C startup code, survives warm resets
+#define HAL_NOINIT                      __attribute__((section(".noinit")))
+
+// Internal EEPROM. Writes are one byte per EEPROM-ready interrupt.
+#define HAL_EEPROM_SIZE                 (E2END + 1)
+#define HAL_EEPROM_READY_ISR()          ISR(EE_RDY_vect)
+#define hal_eeprom_read_block(dst, address, length) \
+    eeprom_read_block((dst), (const void*)(uintptr_t)(address), (length))
+#define hal_eeprom_irq_enable()         (EECR |= (1 << EERIE))
+#define hal_eeprom_irq_disable()        (EECR &= ~(1 << EERIE))
+
+// Start writing one byte; call from the EEPROM-ready ISR (interrupts off)
+static inline void hal_eeprom_write_byte(uint16_t address, uint8_t data)
+{
+    EEAR = address;
+    EEDR = data;
+    // EEWE must follow EEMWE within four cycles
+    EECR |= (1 << EEMWE);
+    EECR |= (1 << EEWE);
+}
+
+// USART, 8N1. Received bytes interrupt on RXC; the transmit interrupt
+// (data register empty) is only enabled while there is something to send.
+#define HAL_UART_RX_ISR()               ISR(USART_RXC_vect)
+#define HAL_UART_TX_ISR()               ISR(USART_UDRE_vect)
+#define hal_uart_read()                 (UDR)
+#define hal_uart_write(data)            (UDR = (data))
+#define hal_uart_tx_irq_enable()        (UCSRB |= (1 << UDRIE))
+#define hal_uart_tx_irq_disable()       (UCSRB &= ~(1 << UDRIE))
+
+static inline void hal_uart_start(uint32_t baud)
+{
+    uint16_t divider = (uint16_t)((F_CPU + 8UL * baud) / (16UL * baud) - 1);
+    
+    UBRRH = (uint8_t)(divider >> 8);
+    UBRRL = (uint8_t)divider;
+    UCSRC = (1 << URSEL) | (1 << UCSZ1) | (1 << UCSZ0); // 8 data bits, no parity, 1 stop
+    UCSRB = (1 << RXEN) | (1 << TXEN) | (1 << RXCIE);
+}
+
+#endif // HAL_AVR_H 
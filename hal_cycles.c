@@ -0,0 +1,46 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include "hal.h"
+
+// Cycle counter of the AVR backend for the profiler (prof.h). Only PROF
+// builds have it, so normal builds keep Timer0 and its vector free.
+// Host builds count virtual time instead (hal_host.h).
+
+#ifdef PROF
+
+#define CYCLES_PER_COUNT    8       // Timer0 prescaler
+
+// Timer0 overflows, the upper bits of the count
+static volatile uint32_t overflows = 0;
+
+void hal_cycles_start(void)
+{
+    TCCR0 = (1 << CS01);    // Normal mode, clk/8
+    TCNT0 = 0;
+    TIFR = (1 << TOV0);     // Clear a stale overflow
+    TIMSK |= (1 << TOIE0);
+}
+
+// Cycles since hal_cycles_start(), in steps of 8; wraps every 9 minutes
+uint32_t hal_cycles(void)
+{
+    uint8_t sreg = hal_irq_save();
+    uint8_t count = TCNT0;
+    uint32_t high = overflows;
+    
+    // An overflow not yet serviced belongs to this reading once the counter
+    // has wrapped past it
+    if ((TIFR & (1 << TOV0)) && count < 0x80) {
+        high++;
+    }
+    hal_irq_restore(sreg);
+    
+    return ((high << 8) | count) * CYCLES_PER_COUNT;
+}
+
+ISR(TIMER0_OVF_vect)
+{
+    overflows++;
+}
+
+#endif
@@ -0,0 +1,199 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include "hal.h"
+
+// Bit-banged I2C master for the AVR backend (host builds use the bus of
+// host/i2c.c and its device models instead)
+
+// I2C pin definitions (for ATmega32)
+#define I2C_SDA_PIN        PC1
+#define I2C_SCL_PIN        PC0
+
+#define SDA                (1 << I2C_SDA_PIN)
+#define SCL                (1 << I2C_SCL_PIN)
+
+// The lines are open drain: pulled low by making the pin an output (its
+// PORT bit stays 0), released by making it an input, when the 4.7k
+// pull-ups take it high unless a slave holds it low
+#define sda_low()          hal_gpio_output(C, SDA)
+#define sda_release()      hal_gpio_input(C, SDA)
+#define scl_low()          hal_gpio_output(C, SCL)
+
+// 5 us polls of a stretched clock before giving up
+#define STRETCH_POLLS      (HAL_I2C_STRETCH_US / 5)
+
+// A clock was stretched too long: the transfer is abandoned until the
+// next start
+static bool timed_out = false;
+
+// Release SCL and wait for it to rise: a slave may hold it low to stretch
+// the clock. False (and timed_out set) if it stays low.
+static bool scl_release(void)
+{
+    uint8_t polls = STRETCH_POLLS;
+    
+    hal_gpio_input(C, SCL);
+    while (!(hal_gpio_read(C) & SCL)) {
+        if (polls-- == 0) {
+            timed_out = true;
+            return false;
+        }
+        hal_delay_us(5);
+    }
+    return true;
+}
+
+// Idle bus: both lines released
+void hal_i2c_init(void)
+{
+    hal_gpio_clear(C, SDA | SCL);
+    hal_gpio_input(C, SDA | SCL);
+    timed_out = false;
+}
+
+// Start, or repeated start after a byte; false if the bus is not free
+// (SDA held low by a slave, or SCL stretched too long)
+bool hal_i2c_start(void)
+{
+    timed_out = false;
+    
+    // Release both lines
+    sda_release();
+    hal_delay_us(5);
+    if (!scl_release() || !(hal_gpio_read(C) & SDA)) {
+        return false;
+    }
+    hal_delay_us(5);
+    
+    // Start condition: SDA goes low while SCL is high
+    sda_low();
+    hal_delay_us(5);
+    scl_low();
+    return true;
+}
+
+void hal_i2c_stop(void)
+{
+    // SDA low while SCL is low
+    scl_low();
+    sda_low();
+    hal_delay_us(5);
+    
+    // Stop condition: SDA goes high while SCL is high
+    if (!timed_out && scl_release()) {
+        hal_delay_us(5);
+    }
+    hal_gpio_input(C, SCL);
+    sda_release();
+    hal_delay_us(5);
+}
+
+bool hal_i2c_write(uint8_t data)
+{
+    uint8_t i;
+    bool ack;
+    
+    if (timed_out) {
+        return false;
+    }
+    
+    for (i = 0; i < 8; i++) {
+        // SCL is low: set SDA according to bit
+        if (data & 0x80) {
+            sda_release();
+        } else {
+            sda_low();
+        }
+        
+        // Clock it
+        if (!scl_release()) {
+            return false;
+        }
+        hal_delay_us(5);
+        scl_low();
+        
+        data <<= 1;
+    }
+    
+    // Read ACK: the slave holds SDA low while SCL is high
+    sda_release();
+    if (!scl_release()) {
+        return false;
+    }
+    hal_delay_us(5);
+    ack = !(hal_gpio_read(C) & SDA);
+    scl_low();
+    
+    return ack;
+}
+
+uint8_t hal_i2c_read(bool ack)
+{
+    uint8_t data = 0;
+    uint8_t i;
+    
+    if (timed_out) {
+        return 0xFF;
+    }
+    
+    sda_release(); // The slave drives SDA
+    
+    for (i = 0; i < 8; i++) {
+        // SCL low, then high
+        hal_delay_us(5);
+        if (!scl_release()) {
+            return 0xFF;
+        }
+        hal_delay_us(5);
+        
+        // Read bit
+        data <<= 1;
+        if (hal_gpio_read(C) & SDA) {
+            data |= 1;
+        }
+        
+        // Set SCL low
+        scl_low();
+    }
+    
+    // Send ACK/NACK
+    if (ack) {
+        sda_low(); // ACK
+    }
+    if (scl_release()) {
+        hal_delay_us(5);
+    }
+    scl_low();
+    sda_release();
+    
+    return data;
+}
+
+// The last transfer was abandoned on a stretched clock
+bool hal_i2c_timed_out(void)
+{
+    return timed_out;
+}
+
+// Bus clear: a slave cut off mid-byte (by a reset of the MCU) holds SDA
+// low while it waits for clocks. Up to nine clocks let it finish the byte;
+// SDA released on the last one reads as a NACK, and a stop frees the bus.
+// False if the bus is still not free.
+bool hal_i2c_recover(void)
+{
+    uint8_t i;
+    
+    timed_out = false;
+    sda_release();
+    for (i = 0; i < 9 && !(hal_gpio_read(C) & SDA); i++) {
+        scl_low();
+        hal_delay_us(5);
+        if (!scl_release()) {
+            return false;
+        }
+        hal_delay_us(5);
+    }
+    
+    hal_i2c_stop();
+    return (hal_gpio_read(C) & (SDA | SCL)) == (SDA | SCL);
+}
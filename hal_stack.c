@@ -0,0 +1,39 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include "hal.h"
+
+// Stack high-water mark of the AVR backend. Before main() runs, the SRAM
+// between the end of .bss and the stack is filled with a paint byte; the
+// stack grows down into it, and the lowest byte that no longer holds the
+// paint marks the deepest point reached. The firmware has no heap, so
+// nothing else writes there. Host builds have no such mark (hal_host.h).
+
+#define STACK_PAINT     0xC5
+
+extern uint8_t __heap_start;    // End of .bss, from the linker script
+
+// In .init3: the stack pointer is set up and .data/.bss are not yet
+// copied, which does not matter as they lie below __heap_start. Naked, so
+// nothing is pushed while the stack is painted.
+void hal_stack_paint(void) __attribute__((naked, used, section(".init3")));
+
+void hal_stack_paint(void)
+{
+    uint8_t* p = &__heap_start;
+    
+    while (p <= (uint8_t*)SP) {
+        *p++ = STACK_PAINT;
+    }
+}
+
+// Deepest stack use since reset, in bytes below RAMEND. A frame that
+// happens to store the paint byte at its bottom reads a little shallower.
+uint16_t hal_stack_used(void)
+{
+    const uint8_t* p = &__heap_start;
+    
+    while (p <= (const uint8_t*)RAMEND && *p == STACK_PAINT) {
+        p++;
+    }
+    return (uint16_t)((const uint8_t*)RAMEND - p + 1);
+}
@@ -0,0 +1,110 @@
+/*
+ * AT24C32 model on the I2C bus (i2c.c): 4 KB of EEPROM, erased to 0xFF,
+ * behind a two-byte address. Written bytes go to a 32-byte page buffer,
+ * wrapping within the page, and are programmed when the stop condition
+ * ends the transfer; for the write cycle after that the device ignores
+ * its address, which is how the master polls for the end. Reads continue
+ * from the address and wrap at the end of the memory. The contents can be
+ * loaded from and saved to a file (rtc_host --at24c32). Scripts can take
+ * it off the bus, as on RTC boards without one.
+ */
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include "hal.h"
+#include "host.h"
+
+#define AT24C32_SIZE        4096
+#define AT24C32_PAGE        32
+#define AT24C32_WRITE_US    10000ULL    // Write cycle, datasheet maximum
+
+static uint8_t memory[AT24C32_SIZE];
+static uint8_t page[AT24C32_PAGE];
+static uint32_t page_loaded = 0;        // Bit per byte of page[] written
+static uint16_t address = 0;
+static uint8_t address_pending = 0;     // Address bytes still to come
+static uint64_t busy_until = 0;
+static bool fitted = true;              // Off the bus: never acknowledges
+
+void at24c32_fit(bool on)
+{
+    fitted = on;
+}
+
+bool at24c32_select(bool read)
+{
+    if (!fitted || host_time_us() < busy_until) {
+        return false;
+    }
+    
+    // A write starts with the address; a new transfer drops unsent data
+    address_pending = read ? 0 : 2;
+    page_loaded = 0;
+    return true;
+}
+
+bool at24c32_write(uint8_t data)
+{
+    if (address_pending == 2) {
+        address = (uint16_t)(data << 8) % AT24C32_SIZE;
+        address_pending = 1;
+    } else if (address_pending == 1) {
+        address = (address & 0xFF00) | data;
+        address_pending = 0;
+    } else {
+        page[address % AT24C32_PAGE] = data;
+        page_loaded |= 1UL << (address % AT24C32_PAGE);
+        address = (address & ~(AT24C32_PAGE - 1)) | ((address + 1) % AT24C32_PAGE);
+    }
+    return true;
+}
+
+uint8_t at24c32_read(void)
+{
+    uint8_t data = memory[address];
+    
+    address = (address + 1) % AT24C32_SIZE;
+    return data;
+}
+
+// Program the bytes of the page buffer and start the write cycle
+void at24c32_stop(void)
+{
+    uint16_t base = address & ~(AT24C32_PAGE - 1);
+    
+    if (page_loaded == 0) {
+        return;
+    }
+    for (uint8_t i = 0; i < AT24C32_PAGE; i++) {
+        if (page_loaded & (1UL << i)) {
+            memory[base + i] = page[i];
+        }
+    }
+    page_loaded = 0;
+    busy_until = host_time_us() + AT24C32_WRITE_US;
+}
+
+// Contents from a file, or erased when there is none yet
+void at24c32_load(const char* path)
+{
+    FILE* file;
+    
+    memset(memory, 0xFF, sizeof(memory));
+    if (path != NULL && (file = fopen(path, "rb")) != NULL) {
+        if (fread(memory, 1, sizeof(memory), file) != sizeof(memory)) {
+            fprintf(stderr, "%s: short AT24C32 image\n", path);
+        }
+        fclose(file);
+    }
+}
+
+void at24c32_save(const char* path)
+{
+    FILE* file;
+    
+    if (path != NULL && (file = fopen(path, "wb")) != NULL) {
+        fwrite(memory, 1, sizeof(memory), file);
+        fclose(file);
+    }
+}
@@ -0,0 +1,20 @@
+/*
+ * Minimal <avr/pgmspace.h> for host-side builds of firmware sources:
+ * flash data is ordinary memory on the host.
+ */
+#ifndef HOST_AVR_PGMSPACE_H
+#define HOST_AVR_PGMSPACE_H
+
+#include <stdint.h>
+#include <string.h>
+
+#define PROGMEM
+#define PSTR(s)                 (s)
+#define pgm_read_byte(addr)     (*(const uint8_t*)(addr))
+#define pgm_read_word(addr)     (*(const uint16_t*)(addr))
+#define pgm_read_dword(addr)    (*(const uint32_t*)(addr))
+#define pgm_read_ptr(addr)      (*(void* const*)(addr))
+#define memcpy_P                memcpy
+#define strlen_P                strlen
+
+#endif // HOST_AVR_PGMSPACE_H
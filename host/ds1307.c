@@ -0,0 +1,256 @@
+/*
+ * DS1307 model on the I2C bus (i2c.c): 64 registers (clock, control, 56
+ * bytes of NVRAM) with the auto-incrementing register pointer, and a
+ * clock that counts whole virtual seconds unless the CH bit is set. The
+ * clock catches up when it is addressed, so it never wakes the simulation.
+ * Its second can be set off from the virtual one (the MCU's clock) to
+ * model crystal drift.
+ *
+ * The same clock can answer as a DS3231 (the same registers, with a
+ * read-only temperature where the DS1307 has RAM) or as a PCF8563 at its
+ * own address, whose registers map onto the DS1307 ones; or not at all.
+ */
+#include <stdint.h>
+#include <stdbool.h>
+#include "hal.h"
+#include "host.h"
+
+#define DS1307_REGISTERS    64
+#define DS3231_TEMP_MSB     0x11
+#define DS3231_TEMP_LSB     0x12
+#define PCF8563_REGISTERS   16
+#define PCF8563_STOP        0x20
+#define SECOND_US           1000000ULL
+
+static host_rtc_t chip = HOST_RTC_DS1307;
+static uint8_t regs[DS1307_REGISTERS];
+static uint8_t pointer = 0;
+static bool pointer_pending = false;     // Next written byte sets the pointer
+
+// PCF8563 face: its registers, those of the clock read through regs[]
+static uint8_t pcf_regs[PCF8563_REGISTERS];
+static uint8_t pcf_pointer = 0;
+static bool pcf_pointer_pending = false;
+
+// DS1307 register behind each PCF8563 clock register (0x02-0x08)
+static const uint8_t pcf_clock[] = {0, 1, 2, 4, 3, 5, 6};
+#define PCF8563_CLOCK_FIRST 0x02
+#define PCF8563_WEEKDAYS    0x06
+static uint64_t next_second = SECOND_US;
+static uint64_t second_us = SECOND_US;
+
+static uint8_t bcd(uint8_t value)
+{
+    return ((value / 10) << 4) | (value % 10);
+}
+
+static uint8_t bin(uint8_t value)
+{
+    return (value >> 4) * 10 + (value & 0x0F);
+}
+
+static uint8_t month_days(uint8_t month, uint16_t year)
+{
+    static const uint8_t days[] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+    
+    if (month == 2 && (year % 4) == 0) return 29;   // 2000-2099
+    return days[(month - 1) % 12];
+}
+
+// Set the clock registers, weekday included (1 = Monday)
+void ds1307_set(uint16_t year, uint8_t month, uint8_t day,
+                uint8_t hour, uint8_t minute, uint8_t second)
+{
+    // Count days from 2000-01-01, which was a Saturday
+    uint32_t days = 0;
+    
+    for (uint16_t y = 2000; y < year; y++) days += (y % 4) ? 365 : 366;
+    for (uint8_t m = 1; m < month; m++) days += month_days(m, year);
+    days += day - 1;
+    
+    regs[0] = bcd(second);
+    regs[1] = bcd(minute);
+    regs[2] = bcd(hour);
+    regs[3] = (days + 5) % 7 + 1;
+    regs[4] = bcd(day);
+    regs[5] = bcd(month);
+    regs[6] = bcd(year - 2000);
+    
+    // Like a write over the bus, this restarts the one-second divider
+    next_second = host_time_us() + second_us;
+}
+
+// Run the clock ppm fast (negative: slow) against virtual time
+void ds1307_drift(int32_t ppm)
+{
+    second_us = SECOND_US - ppm;
+}
+
+// Put a chip on the bus, or none
+void ds1307_chip(host_rtc_t new_chip)
+{
+    chip = new_chip;
+    if (chip == HOST_RTC_DS3231) {
+        regs[DS3231_TEMP_MSB] = 25;     // 25.00 degrees
+        regs[DS3231_TEMP_LSB] = 0;
+    }
+}
+
+// Advance the clock registers by one second
+static void ds1307_tick(void)
+{
+    uint8_t second = bin(regs[0] & 0x7F);
+    uint8_t minute = bin(regs[1] & 0x7F);
+    uint8_t hour = bin(regs[2] & 0x3F);
+    uint8_t day = bin(regs[4] & 0x3F);
+    uint8_t month = bin(regs[5] & 0x1F);
+    uint16_t year = 2000 + bin(regs[6]);
+    
+    if (regs[0] & 0x80) {
+        return;     // Clock halted
+    }
+    
+    if (++second == 60) {
+        second = 0;
+        if (++minute == 60) {
+            minute = 0;
+            if (++hour == 24) {
+                hour = 0;
+                regs[3] = (regs[3] % 7) + 1;
+                if (++day > month_days(month, year)) {
+                    day = 1;
+                    if (++month == 13) {
+                        month = 1;
+                        year = (year == 2099) ? 2000 : year + 1;
+                    }
+                }
+            }
+        }
+    }
+    
+    regs[0] = bcd(second);
+    regs[1] = bcd(minute);
+    regs[2] = bcd(hour);
+    regs[4] = bcd(day);
+    regs[5] = bcd(month);
+    regs[6] = bcd(year - 2000);
+}
+
+// Count the seconds that passed since the last access
+static void ds1307_catch_up(void)
+{
+    uint64_t now = host_time_us();
+    
+    while (next_second <= now) {
+        ds1307_tick();
+        next_second += second_us;
+    }
+}
+
+// Slave side, called by the bus (i2c.c). The first byte written after
+// the address sets the register pointer, reads continue from it.
+
+bool ds1307_select(bool read)
+{
+    if (chip != HOST_RTC_DS1307 && chip != HOST_RTC_DS3231) {
+        return false;
+    }
+    ds1307_catch_up();
+    pointer_pending = !read;
+    return true;
+}
+
+// A register write as the DS1307 takes it
+static void ds1307_store(uint8_t reg, uint8_t data)
+{
+    // Writing the seconds register restarts the one-second divider
+    if (reg == 0) {
+        next_second = host_time_us() + second_us;
+    }
+    // The DS3231's temperature is read-only
+    if (chip == HOST_RTC_DS3231 && (reg == DS3231_TEMP_MSB || reg == DS3231_TEMP_LSB)) {
+        return;
+    }
+    regs[reg] = data;
+}
+
+bool ds1307_write(uint8_t data)
+{
+    if (pointer_pending) {
+        pointer = data % DS1307_REGISTERS;
+        pointer_pending = false;
+        return true;
+    }
+    
+    ds1307_store(pointer, data);
+    pointer = (pointer + 1) % DS1307_REGISTERS;
+    return true;
+}
+
+uint8_t ds1307_read(void)
+{
+    uint8_t data = regs[pointer];
+    
+    pointer = (pointer + 1) % DS1307_REGISTERS;
+    return data;
+}
+
+// PCF8563 face. The STOP bit of control 1 is the DS1307's CH bit, the
+// weekday counts 0-6 where the DS1307's counts 1-7, and VL and the
+// century bit always read 0.
+
+bool pcf8563_select(bool read)
+{
+    if (chip != HOST_RTC_PCF8563) {
+        return false;
+    }
+    ds1307_catch_up();
+    pcf_pointer_pending = !read;
+    return true;
+}
+
+bool pcf8563_write(uint8_t data)
+{
+    uint8_t reg = pcf_pointer;
+    
+    if (pcf_pointer_pending) {
+        pcf_pointer = data % PCF8563_REGISTERS;
+        pcf_pointer_pending = false;
+        return true;
+    }
+    
+    if (reg == 0) {
+        regs[0] = (regs[0] & 0x7F) | ((data & PCF8563_STOP) ? 0x80 : 0);
+        pcf_regs[0] = data & ~PCF8563_STOP;
+    } else if (reg == PCF8563_CLOCK_FIRST) {
+        ds1307_store(0, (regs[0] & 0x80) | (data & 0x7F));
+    } else if (reg == PCF8563_WEEKDAYS) {
+        ds1307_store(pcf_clock[reg - PCF8563_CLOCK_FIRST], (data % 7) + 1);
+    } else if (reg > PCF8563_CLOCK_FIRST && reg < PCF8563_CLOCK_FIRST + sizeof(pcf_clock)) {
+        ds1307_store(pcf_clock[reg - PCF8563_CLOCK_FIRST], data & 0x7F);
+    } else {
+        pcf_regs[reg] = data;
+    }
+    pcf_pointer = (pcf_pointer + 1) % PCF8563_REGISTERS;
+    return true;
+}
+
+uint8_t pcf8563_read(void)
+{
+    uint8_t reg = pcf_pointer;
+    uint8_t data;
+    
+    if (reg == 0) {
+        data = pcf_regs[0] | ((regs[0] & 0x80) ? PCF8563_STOP : 0);
+    } else if (reg == PCF8563_CLOCK_FIRST) {
+        data = regs[0] & 0x7F;
+    } else if (reg == PCF8563_WEEKDAYS) {
+        data = regs[pcf_clock[reg - PCF8563_CLOCK_FIRST]] - 1;
+    } else if (reg > PCF8563_CLOCK_FIRST && reg < PCF8563_CLOCK_FIRST + sizeof(pcf_clock)) {
+        data = regs[pcf_clock[reg - PCF8563_CLOCK_FIRST]];
+    } else {
+        data = pcf_regs[reg];
+    }
+    pcf_pointer = (pcf_pointer + 1) % PCF8563_REGISTERS;
+    return data;
+}
@@ -0,0 +1,175 @@
+#ifndef HAL_HOST_H
+#define HAL_HOST_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Linux backend of hal.h (make host). Time is virtual: it only advances
+// inside the delay calls, which is where the simulated tick, EEPROM and
+// keypad events are delivered, so runs are deterministic and as fast as
+// the CPU allows. The devices behind the pins are models: an HD44780 on
+// port D, a DS1307 and an AT24C32 on the I2C bus, a scripted keypad on
+// port B and a serial terminal on the USART.
+
+// AVR pin numbers used by the drivers' pin definitions
+#define PA0 0
+#define PA1 1
+#define PA2 2
+#define PA3 3
+#define PA4 4
+#define PA5 5
+#define PA6 6
+#define PA7 7
+#define PB0 0
+#define PB1 1
+#define PB2 2
+#define PB3 3
+#define PB4 4
+#define PB5 5
+#define PB6 6
+#define PB7 7
+#define PC0 0
+#define PC1 1
+#define PC2 2
+#define PC3 3
+#define PC4 4
+#define PC5 5
+#define PC6 6
+#define PC7 7
+#define PD0 0
+#define PD1 1
+#define PD2 2
+#define PD3 3
+#define PD4 4
+#define PD5 5
+#define PD6 6
+#define PD7 7
+
+// Port indices for the GPIO calls
+#define HOST_PORT_A 0
+#define HOST_PORT_B 1
+#define HOST_PORT_C 2
+#define HOST_PORT_D 3
+
+// Port and direction registers. Writes are inline; the models are only
+// called on edges of a host_watch[] bit (buzzer) and falling edges of a
+// host_latch[] bit (LCD enable).
+extern uint8_t host_ddr[4];
+extern uint8_t host_port[4];
+extern uint8_t host_watch[4];
+extern uint8_t host_latch[4];
+
+void host_pins_changed(uint8_t port, uint8_t previous);
+uint8_t host_gpio_read(uint8_t port);
+
+static inline void host_gpio_direction(uint8_t port, uint8_t mask, bool output)
+{
+    host_ddr[port] = output ? (host_ddr[port] | mask) : (host_ddr[port] & ~mask);
+}
+
+static inline void host_gpio_write(uint8_t port, uint8_t mask, bool high)
+{
+    uint8_t previous = host_port[port];
+    uint8_t now = high ? (previous | mask) : (previous & ~mask);
+    
+    host_port[port] = now;
+    if (((previous ^ now) & host_watch[port]) | (previous & ~now & host_latch[port])) {
+        host_pins_changed(port, previous);
+    }
+}
+
+#define hal_gpio_output(port, mask)     host_gpio_direction(HOST_PORT_##port, (mask), true)
+#define hal_gpio_input(port, mask)      host_gpio_direction(HOST_PORT_##port, (mask), false)
+#define hal_gpio_set(port, mask)        host_gpio_write(HOST_PORT_##port, (mask), true)
+#define hal_gpio_clear(port, mask)      host_gpio_write(HOST_PORT_##port, (mask), false)
+#define hal_gpio_read(port)             host_gpio_read(HOST_PORT_##port)
+
+// Virtual clock in microseconds. A delay that ends before the next
+// scheduled event is a single addition; longer ones and display pauses
+// (the host samples the LCD on those) run the event loop in host.c.
+#define HOST_FRAME_SAMPLE_US            10000UL
+
+extern uint64_t host_now_us;
+extern uint64_t host_next_event_us;
+
+void host_delay_run(uint32_t us);
+
+static inline void host_delay_us(uint32_t us)
+{
+    if (us < HOST_FRAME_SAMPLE_US && host_now_us + us < host_next_event_us) {
+        host_now_us += us;
+    } else {
+        host_delay_run(us);
+    }
+}
+
+#define hal_delay_ms(ms)                host_delay_us((uint32_t)(ms) * 1000UL)
+#define hal_delay_us(us)                host_delay_us((uint32_t)(us))
+
+// Every input is a scheduled event, so a poll before the next one would
+// find nothing new: an idle pause runs on to that event
+void host_idle_us(uint32_t us);
+
+#define hal_idle_ms(ms)                 host_idle_us((uint32_t)(ms) * 1000UL)
+
+// Profiler cycle counter: virtual time at 8 cycles per microsecond
+#define hal_cycles_start()              ((void)0)
+#define hal_cycles()                    ((uint32_t)(host_now_us * 8))
+
+// Benchmark markers only mean something under simavr
+#define hal_bench_mark(code)            ((void)(code))
+
+// Interrupt masking; pending interrupts run when they are enabled again
+void hal_irq_enable(void);
+void hal_irq_disable(void);
+uint8_t hal_irq_save(void);
+void hal_irq_restore(uint8_t state);
+
+// 1 Hz tick with the Timer1 period (7812 counts of 128 us)
+#define HAL_TICK_ISR()                  void hal_tick_isr(void)
+void hal_tick_isr(void);
+void hal_tick_start(void);
+
+#define HAL_TICK_COUNTS                 7812
+#define HAL_TICK_COUNT_US               128
+#define HAL_TICK_RATE_Q16               512000000UL
+uint16_t hal_tick_phase(void);
+bool hal_tick_pending(void);
+void hal_tick_set_period(uint16_t counts);
+
+// Keypad scan with the Timer2 period. A scan finds news only while a key
+// is held or settling, so the host runs it only then (host.c).
+#define HAL_SCAN_PERIOD_US              1000
+#define HAL_SCAN_ISR()                  void hal_scan_isr(void)
+void hal_scan_isr(void);
+void hal_scan_start(void);
+
+uint8_t hal_reset_cause(void);
+
+// The host stack says nothing about the AVR's: no high-water mark
+#define hal_stack_used()                ((uint16_t)0)
+
+// Outside the fw_* sections, so a scripted reset (host.c) leaves it alone
+#define HAL_NOINIT                      __attribute__((section(".noinit")))
+
+// Internal EEPROM model (erased to 0xFF, 8.5 ms per byte written)
+#define HAL_EEPROM_SIZE                 1024
+#define HAL_EEPROM_READY_ISR()          void hal_eeprom_ready_isr(void)
+void hal_eeprom_ready_isr(void);
+void hal_eeprom_read_block(void* dst, uint16_t address, uint16_t length);
+void hal_eeprom_irq_enable(void);
+void hal_eeprom_irq_disable(void);
+void hal_eeprom_write_byte(uint16_t address, uint8_t data);
+
+// USART model: one byte time per character at the configured baud rate
+#define HAL_UART_RX_ISR()               void hal_uart_rx_isr(void)
+#define HAL_UART_TX_ISR()               void hal_uart_tx_isr(void)
+void hal_uart_rx_isr(void);
+void hal_uart_tx_isr(void);
+void hal_uart_start(uint32_t baud);
+uint8_t hal_uart_read(void);
+void hal_uart_write(uint8_t data);
+void hal_uart_tx_irq_enable(void);
+void hal_uart_tx_irq_disable(void);
+
+#endif // HAL_HOST_H 
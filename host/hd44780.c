@@ -0,0 +1,114 @@
+/*
+ * HD44780 model: takes the 4-bit bus at the falling edge of EN (from port
+ * D in host.c, or from the PCF8574 model), executes the instruction set
+ * the driver uses and keeps the DDRAM.
+ */
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "hal.h"
+#include "host.h"
+#include "lcd.h"
+
+static uint8_t ddram[0x80];
+static uint8_t address = 0;
+static bool cgram = false;          // Data goes to CGRAM (ignored)
+static bool four_bit = false;       // Controller powers up in 8-bit mode
+static bool have_high = false;      // First nibble of a 4-bit transfer seen
+static uint8_t high_nibble = 0;
+static bool initialized = false;
+static bool changed = true;         // DDRAM differs from the last frame
+
+static void hd44780_reset(void)
+{
+    memset(ddram, ' ', sizeof(ddram));
+    address = 0;
+    initialized = true;
+    changed = true;
+}
+
+// Next DDRAM address: rows are 0x00-0x27 and 0x40-0x67
+static uint8_t hd44780_next(uint8_t addr)
+{
+    addr++;
+    if (addr == 0x28) return 0x40;
+    if (addr == 0x68) return 0x00;
+    return addr;
+}
+
+static void hd44780_execute(bool data, uint8_t value)
+{
+    if (data) {
+        if (!cgram) {
+            changed |= (ddram[address & 0x7F] != value);
+            ddram[address & 0x7F] = value;
+            address = hd44780_next(address);
+        }
+        return;
+    }
+    
+    if (value & LCD_SET_DDRAM_ADDR) {
+        address = value & 0x7F;
+        cgram = false;
+    } else if (value & LCD_SET_CGRAM_ADDR) {
+        cgram = true;
+    } else if (value & LCD_FUNCTION_SET) {
+        four_bit = !(value & 0x10);
+        have_high = false;
+    } else if (value & (LCD_CURSOR_SHIFT | LCD_DISPLAY_CONTROL | LCD_ENTRY_MODE_SET)) {
+        // Shift, display control and entry mode keep the driver's defaults
+    } else if (value & LCD_RETURN_HOME) {
+        address = 0;
+        cgram = false;
+    } else if (value == LCD_CLEAR_DISPLAY) {
+        memset(ddram, ' ', sizeof(ddram));
+        address = 0;
+        cgram = false;
+        changed = true;
+    }
+}
+
+// Called on each falling edge of EN with RS and D4-D7
+void hd44780_latch(bool rs, uint8_t nibble)
+{
+    if (!initialized) {
+        hd44780_reset();
+    }
+    
+    if (!four_bit) {
+        // 8-bit mode: D4-D7 are the high half, the low half reads as 0
+        hd44780_execute(rs, nibble << 4);
+    } else if (!have_high) {
+        high_nibble = nibble;
+        have_high = true;
+    } else {
+        have_high = false;
+        hd44780_execute(rs, (high_nibble << 4) | nibble);
+    }
+}
+
+// Visible 16x2 window
+void hd44780_frame(char rows[2][17])
+{
+    if (!initialized) {
+        hd44780_reset();
+    }
+    
+    for (uint8_t col = 0; col < 16; col++) {
+        uint8_t top = ddram[col];
+        uint8_t bottom = ddram[0x40 + col];
+        rows[0][col] = (top >= 0x20 && top < 0x7F) ? top : '?';
+        rows[1][col] = (bottom >= 0x20 && bottom < 0x7F) ? bottom : '?';
+    }
+    rows[0][16] = '\0';
+    rows[1][16] = '\0';
+}
+
+// True once after each change of the DDRAM
+bool hd44780_changed(void)
+{
+    bool result = changed;
+    
+    changed = false;
+    return result;
+}
@@ -0,0 +1,707 @@
+/*
+ * Linux backend of hal.h. The firmware's main() is compiled as
+ * firmware_main() and runs on a virtual clock: every delay advances it,
+ * delivering the tick, keypad scan, EEPROM and script events that fall
+ * inside, and short delays with nothing due cost a single addition. The
+ * main loop's idle pause skips ahead to the next event. Port D drives
+ * the HD44780 model, port A the buzzer, port B reads the scripted keypad,
+ * the I2C calls reach the DS1307, AT24C32 and PCF8574 models (the last
+ * drives the HD44780 in an LCD_PCF8574 build) and the USART sends to a
+ * terminal.
+ *
+ * The run is recorded on stdout as timestamped lines: every change of the
+ * visible LCD frame, buzzer edges, script events. Compared against a
+ * golden file this checks rollovers and alarm recurrence over days or a
+ * whole year in seconds (make sim-test). With --uart (or a script's
+ * UART on) the console lines the firmware sends are recorded too, as
+ * "uart <line>", and provisioning frames as "uart frame <hex bytes>".
+ * A TRACE build writes the trace records to a file with --trace, for
+ * tools/tracedec.
+ *
+ * A script's RESET is a watchdog reset: the firmware's writable data goes
+ * back to its load-time values and firmware_main() starts over with the
+ * peripherals stopped, while the LCD, RTC and EEPROM models keep their
+ * state. The Makefile links the firmware into one object whose data
+ * sections are renamed fw_*, so the linker brackets them with
+ * __start_fw_* and __stop_fw_*.
+ *
+ * Usage: rtc_host [--seconds N] [--time "YYYY-MM-DD HH:MM:SS"]
+ *                 [--script FILE] [--eeprom FILE] [--at24c32 FILE]
+ *                 [--realtime] [--uart] [--trace FILE]
+ *
+ * --eeprom and --at24c32 keep the MCU's EEPROM and the RTC module's
+ * EEPROM in files across runs.
+ */
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <setjmp.h>
+#include <time.h>
+#include "hal.h"
+#include "host.h"
+#include "lcd.h"
+#include "buzzer.h"
+#include "trace.h"
+
+#define HOST_PORTS          4
+#define EEPROM_WRITE_US     8500ULL
+#define UART_FRAME_BITS     10          // Start, 8 data, stop
+#define UART_LINE_MAX       80
+#define UART_RX_QUEUE       256
+#define UART_FRAME_SYNC     0xA5        // PROVISION_SYNC (provision.h needs rtc.h,
+#define UART_FRAME_MAX      36          // whose time_t clashes with <time.h>)
+#define DEFAULT_RUN_US      10000000ULL
+
+int firmware_main(void);
+
+uint8_t host_ddr[HOST_PORTS];
+uint8_t host_port[HOST_PORTS];
+
+// The buzzer is logged on every edge, the HD44780 latches when EN falls
+uint8_t host_watch[HOST_PORTS] = {[HOST_PORT_A] = 1 << BUZZER_PIN};
+uint8_t host_latch[HOST_PORTS] = {[HOST_PORT_D] = 1 << LCD_EN_PIN};
+
+uint64_t host_now_us = 0;
+static uint64_t end_us = HOST_NEVER;
+static bool realtime = false;
+static bool event_since_idle = true;
+uint64_t host_next_event_us = 0;     // Earliest tick, scan, EEPROM, UART, script or end event
+
+static bool irq_enabled = false;
+static bool tick_running = false;
+static bool tick_pending = false;
+static uint64_t next_tick = HOST_NEVER;
+static uint64_t tick_period_us = (uint64_t)HAL_TICK_COUNTS * HAL_TICK_COUNT_US;
+
+static bool scan_running = false;
+static bool scan_pending = false;
+static uint64_t scan_started = 0;
+static uint64_t next_scan = HOST_NEVER;     // While the keypad is busy
+
+static uint8_t eeprom[HAL_EEPROM_SIZE];
+static bool eeprom_irq = false;
+static uint64_t eeprom_ready_at = 0;
+static const char* eeprom_path = NULL;
+static const char* at24c32_path = NULL;
+
+static bool uart_running = false;
+static bool uart_tx_irq = false;
+static uint64_t uart_byte_us = 0;
+static uint64_t uart_ready_at = 0;
+static bool uart_record = false;
+static char uart_line[UART_LINE_MAX + 1];
+static uint8_t uart_line_length = 0;
+static uint8_t uart_frame[UART_FRAME_MAX];
+static uint8_t uart_frame_length = 0;
+static uint8_t uart_rx_queue[UART_RX_QUEUE];
+static uint16_t uart_rx_count = 0;
+static uint16_t uart_rx_next = 0;
+static uint64_t uart_rx_at = 0;         // Arrival of the next queued byte
+static uint8_t uart_rx_data = 0;
+
+static FILE* trace_file = NULL;
+
+static char last_frame[2][17];
+static bool record_frames = true;
+
+static uint8_t reset_cause = HAL_RESET_POWER_ON;
+static bool reset_requested = false;
+static jmp_buf reset_jump;
+
+// The firmware's writable data (weak: a section the build does not have
+// is left out) and a copy of it from before the first boot
+extern char __start_fw_data[] __attribute__((weak));
+extern char __stop_fw_data[] __attribute__((weak));
+extern char __start_fw_data_rel[] __attribute__((weak));
+extern char __stop_fw_data_rel[] __attribute__((weak));
+extern char __start_fw_data_rel_local[] __attribute__((weak));
+extern char __stop_fw_data_rel_local[] __attribute__((weak));
+extern char __start_fw_bss[] __attribute__((weak));
+extern char __stop_fw_bss[] __attribute__((weak));
+
+typedef struct {
+    char* start;
+    char* stop;
+    char* initial;
+} firmware_section_t;
+
+static firmware_section_t firmware_sections[4];
+
+uint64_t host_time_us(void)
+{
+    return host_now_us;
+}
+
+static uint64_t earliest(uint64_t a, uint64_t b)
+{
+    return (a < b) ? a : b;
+}
+
+void host_schedule(void)
+{
+    uint64_t next = earliest(end_us, next_tick);
+    
+    // The next keypad scan after now, on the Timer2 period
+    next_scan = HOST_NEVER;
+    if (scan_running && keypad_busy(host_now_us)) {
+        next_scan = host_now_us + HAL_SCAN_PERIOD_US -
+                    (host_now_us - scan_started) % HAL_SCAN_PERIOD_US;
+        next = earliest(next, next_scan);
+    }
+    next = earliest(next, script_next_event());
+    if (eeprom_irq && eeprom_ready_at > host_now_us) {
+        next = earliest(next, eeprom_ready_at);
+    }
+    if (uart_tx_irq && uart_ready_at > host_now_us) {
+        next = earliest(next, uart_ready_at);
+    }
+    if (uart_rx_next < uart_rx_count) {
+        next = earliest(next, uart_rx_at);
+    }
+    host_next_event_us = next;
+}
+
+// Recording
+
+void host_log(const char* format, ...)
+{
+    va_list args;
+    
+    printf("[%10.3f] ", host_now_us / 1e6);
+    va_start(args, format);
+    vprintf(format, args);
+    va_end(args);
+    putchar('\n');
+}
+
+static void host_print_frame(void)
+{
+    char frame[2][17];
+    
+    if (!record_frames || !hd44780_changed()) {
+        return;
+    }
+    hd44780_frame(frame);
+    if (memcmp(frame, last_frame, sizeof(frame)) != 0) {
+        memcpy(last_frame, frame, sizeof(frame));
+        host_log("|%s|%s|", frame[0], frame[1]);
+    }
+}
+
+void host_record_frames(bool on)
+{
+    record_frames = on;
+    if (on) {
+        // Start from the current frame
+        hd44780_frame(last_frame);
+        host_log("|%s|%s|", last_frame[0], last_frame[1]);
+    }
+}
+
+// GPIO
+
+void host_pins_changed(uint8_t index, uint8_t previous)
+{
+    uint8_t changed = previous ^ host_port[index];
+    
+    if (index == HOST_PORT_D) {
+        uint8_t port_d = host_port[index];
+        
+        hd44780_latch(port_d & (1 << LCD_RS_PIN),
+                      ((port_d >> LCD_D4_PIN) & 1) | (((port_d >> LCD_D5_PIN) & 1) << 1) |
+                      (((port_d >> LCD_D6_PIN) & 1) << 2) | (((port_d >> LCD_D7_PIN) & 1) << 3));
+    } else if (index == HOST_PORT_A && (changed & (1 << BUZZER_PIN))) {
+        host_log("buzzer %s", (host_port[index] & (1 << BUZZER_PIN)) ? "on" : "off");
+    }
+}
+
+uint8_t host_gpio_read(uint8_t index)
+{
+    if (index == HOST_PORT_B) {
+        return keypad_pins(host_ddr[index], host_port[index]);
+    }
+    return host_port[index];
+}
+
+// Interrupts
+
+static void host_service_interrupts(void)
+{
+    if (!irq_enabled) {
+        return;
+    }
+    
+    // Interrupt handlers run with interrupts disabled, as on the AVR
+    irq_enabled = false;
+    if (tick_pending) {
+        tick_pending = false;
+        hal_tick_isr();
+    }
+    if (scan_pending) {
+        scan_pending = false;
+        hal_scan_isr();
+    }
+    while (uart_rx_next < uart_rx_count && uart_rx_at <= host_now_us) {
+        uart_rx_data = uart_rx_queue[uart_rx_next++];
+        uart_rx_at += uart_byte_us;
+        hal_uart_rx_isr();
+    }
+    while (uart_tx_irq && uart_ready_at <= host_now_us) {
+        hal_uart_tx_isr();
+    }
+    while (eeprom_irq && eeprom_ready_at <= host_now_us) {
+        hal_eeprom_ready_isr();
+    }
+    irq_enabled = true;
+}
+
+void hal_irq_enable(void)
+{
+    irq_enabled = true;
+    host_service_interrupts();
+}
+
+void hal_irq_disable(void)
+{
+    irq_enabled = false;
+}
+
+uint8_t hal_irq_save(void)
+{
+    uint8_t state = irq_enabled;
+    
+    irq_enabled = false;
+    return state;
+}
+
+void hal_irq_restore(uint8_t state)
+{
+    if (state) {
+        hal_irq_enable();
+    }
+}
+
+void hal_tick_start(void)
+{
+    tick_running = true;
+    next_tick = host_now_us + tick_period_us;
+    host_schedule();
+}
+
+// New compare value for the running period (CTC mode, no buffering)
+void hal_tick_set_period(uint16_t counts)
+{
+    uint64_t started = next_tick - tick_period_us;
+    
+    tick_period_us = (uint64_t)counts * HAL_TICK_COUNT_US;
+    next_tick = started + tick_period_us;
+    host_schedule();
+}
+
+// Timer1 count: time since the last tick in 128 us steps
+uint16_t hal_tick_phase(void)
+{
+    if (!tick_running) {
+        return 0;
+    }
+    return (uint16_t)((host_now_us - (next_tick - tick_period_us)) / HAL_TICK_COUNT_US);
+}
+
+bool hal_tick_pending(void)
+{
+    return tick_pending;
+}
+
+void hal_scan_start(void)
+{
+    scan_running = true;
+    scan_started = host_now_us;
+    host_schedule();
+}
+
+uint8_t hal_reset_cause(void)
+{
+    return reset_cause;
+}
+
+// EEPROM
+
+void hal_eeprom_read_block(void* dst, uint16_t address, uint16_t length)
+{
+    memcpy(dst, &eeprom[address], length);
+}
+
+// A ready EEPROM interrupts as soon as its interrupt is enabled
+void hal_eeprom_irq_enable(void)
+{
+    eeprom_irq = true;
+    host_schedule();
+    host_service_interrupts();
+}
+
+void hal_eeprom_irq_disable(void)
+{
+    eeprom_irq = false;
+    host_schedule();
+}
+
+void hal_eeprom_write_byte(uint16_t address, uint8_t data)
+{
+    eeprom[address % HAL_EEPROM_SIZE] = data;
+    eeprom_ready_at = host_now_us + EEPROM_WRITE_US;
+    host_schedule();
+}
+
+static void eeprom_load(void)
+{
+    FILE* file;
+    
+    memset(eeprom, 0xFF, sizeof(eeprom));
+    if (eeprom_path != NULL && (file = fopen(eeprom_path, "rb")) != NULL) {
+        if (fread(eeprom, 1, sizeof(eeprom), file) != sizeof(eeprom)) {
+            fprintf(stderr, "%s: short EEPROM image\n", eeprom_path);
+        }
+        fclose(file);
+    }
+}
+
+static void eeprom_save(void)
+{
+    FILE* file;
+    
+    if (eeprom_path != NULL && (file = fopen(eeprom_path, "wb")) != NULL) {
+        fwrite(eeprom, 1, sizeof(eeprom), file);
+        fclose(file);
+    }
+}
+
+// USART
+
+void hal_uart_start(uint32_t baud)
+{
+    uart_running = true;
+    uart_byte_us = (UART_FRAME_BITS * 1000000ULL + baud - 1) / baud;
+}
+
+uint8_t hal_uart_read(void)
+{
+    return uart_rx_data;
+}
+
+// Bytes sent by the terminal (script RX events), one byte time apart
+void host_uart_receive(const uint8_t* data, uint8_t length)
+{
+    if (!uart_running) {
+        return;
+    }
+    if (uart_rx_next == uart_rx_count) {
+        uart_rx_next = uart_rx_count = 0;
+        uart_rx_at = host_now_us + uart_byte_us;
+    }
+    while (length-- > 0 && uart_rx_count < UART_RX_QUEUE) {
+        uart_rx_queue[uart_rx_count++] = *data++;
+    }
+    host_schedule();
+}
+
+void host_record_uart(bool on)
+{
+    uart_record = on;
+}
+
+// A provisioning frame starts with UART_FRAME_SYNC where a line would
+// start and runs for LEN + 3 bytes
+static bool uart_frame_byte(uint8_t data)
+{
+    char text[3 * sizeof(uart_frame) + 1];
+    
+    if (uart_frame_length == 0 && (uart_line_length != 0 || data != UART_FRAME_SYNC)) {
+        return false;
+    }
+    uart_frame[uart_frame_length++] = data;
+    if (uart_frame_length < 2 ||
+        (uart_frame_length < uart_frame[1] + 3 && uart_frame_length < sizeof(uart_frame))) {
+        return true;
+    }
+    
+    if (uart_record) {
+        for (uint8_t i = 0; i < uart_frame_length; i++) {
+            sprintf(&text[3 * i], " %02x", uart_frame[i]);
+        }
+        host_log("uart frame%s", text);
+    }
+    uart_frame_length = 0;
+    return true;
+}
+
+// The terminal collects whole lines and frames; each byte takes one byte
+// time
+void hal_uart_write(uint8_t data)
+{
+    if (!uart_running) {
+        return;
+    }
+    uart_ready_at = host_now_us + uart_byte_us;
+    host_schedule();
+    
+    if (uart_frame_byte(data)) {
+        return;
+    }
+    if (data == '\n') {
+        uart_line[uart_line_length] = '\0';
+        if (uart_record) {
+            host_log("uart %s", uart_line);
+        }
+        uart_line_length = 0;
+    } else if (data != '\r' && uart_line_length < UART_LINE_MAX) {
+        uart_line[uart_line_length++] = (char)data;
+    }
+}
+
+// The data register is empty once the previous byte has gone out
+void hal_uart_tx_irq_enable(void)
+{
+    uart_tx_irq = true;
+    host_schedule();
+    host_service_interrupts();
+}
+
+void hal_uart_tx_irq_disable(void)
+{
+    uart_tx_irq = false;
+    host_schedule();
+}
+
+// Trace records (TRACE builds): the ring is emptied as it fills, so a
+// run of any length is kept whole
+
+static void trace_drain(void)
+{
+#ifdef TRACE
+    trace_record_t records[TRACE_SIZE];
+    uint8_t count;
+    
+    if (trace_file != NULL && (count = trace_take(records, TRACE_SIZE)) > 0) {
+        fwrite(records, sizeof(records[0]), count, trace_file);
+    }
+#endif
+}
+
+// Virtual time
+
+void host_finish(void)
+{
+    trace_drain();
+    if (trace_file != NULL) {
+        fclose(trace_file);
+    }
+    host_print_frame();
+    eeprom_save();
+    at24c32_save(at24c32_path);
+    fflush(stdout);
+    exit(0);
+}
+
+// Firmware data and reset
+
+static void firmware_save(void)
+{
+    char* bounds[][2] = {
+        {__start_fw_data, __stop_fw_data},
+        {__start_fw_data_rel, __stop_fw_data_rel},
+        {__start_fw_data_rel_local, __stop_fw_data_rel_local},
+        {__start_fw_bss, __stop_fw_bss}
+    };
+    
+    for (uint8_t i = 0; i < 4; i++) {
+        firmware_section_t* section = &firmware_sections[i];
+        
+        section->start = bounds[i][0];
+        section->stop = bounds[i][1];
+        if (section->start != NULL && section->stop > section->start) {
+            section->initial = malloc(section->stop - section->start);
+            memcpy(section->initial, section->start, section->stop - section->start);
+        }
+    }
+}
+
+static void firmware_restore(void)
+{
+    for (uint8_t i = 0; i < 4; i++) {
+        firmware_section_t* section = &firmware_sections[i];
+        
+        if (section->initial != NULL) {
+            memcpy(section->start, section->initial, section->stop - section->start);
+        }
+    }
+}
+
+void host_reset(void)
+{
+    reset_requested = true;
+}
+
+// Stop the peripherals as the reset does and start the firmware over. The
+// buzzer pin goes back to an input, which silences it.
+static void host_reset_run(void)
+{
+    reset_requested = false;
+    if (host_port[HOST_PORT_A] & (1 << BUZZER_PIN)) {
+        host_log("buzzer off");
+    }
+    memset(host_ddr, 0, sizeof(host_ddr));
+    memset(host_port, 0, sizeof(host_port));
+    
+    irq_enabled = false;
+    tick_running = tick_pending = false;
+    next_tick = HOST_NEVER;
+    tick_period_us = (uint64_t)HAL_TICK_COUNTS * HAL_TICK_COUNT_US;
+    scan_running = scan_pending = false;
+    eeprom_irq = false;
+    uart_running = uart_tx_irq = false;
+    uart_rx_next = uart_rx_count = 0;
+    uart_line_length = 0;
+    uart_frame_length = 0;
+    
+    reset_cause = HAL_RESET_WATCHDOG;
+    event_since_idle = true;
+    host_schedule();
+    longjmp(reset_jump, 1);
+}
+
+// Delays that reach an event or sample the display (see hal_host.h)
+void host_delay_run(uint32_t us)
+{
+    uint64_t target = host_now_us + us;
+    
+    if (us >= HOST_FRAME_SAMPLE_US) {
+        host_print_frame();
+    }
+    
+    while (host_now_us < target) {
+        uint64_t step = earliest(target, host_next_event_us);
+        
+        if (realtime && step > host_now_us) {
+            struct timespec pause;
+            
+            pause.tv_sec = (step - host_now_us) / 1000000ULL;
+            pause.tv_nsec = (long)((step - host_now_us) % 1000000ULL) * 1000L;
+            nanosleep(&pause, NULL);
+        }
+        host_now_us = step;
+        event_since_idle |= (step == host_next_event_us);
+        
+        if (host_now_us >= end_us) {
+            host_finish();
+        }
+        if (tick_running && host_now_us >= next_tick) {
+            tick_pending = true;
+            next_tick += tick_period_us;
+        }
+        if (host_now_us >= next_scan) {
+            scan_pending = true;
+        }
+        script_run(host_now_us);
+        if (reset_requested) {
+            host_reset_run();
+        }
+        host_schedule();
+        host_service_interrupts();
+        trace_drain();
+    }
+}
+
+// An idle pause runs on to the next event, but only after the loop had a
+// full pass without news: an event that arrived while the firmware was
+// busy (a key released during a blocking delay) still gets a normal poll.
+void host_idle_us(uint32_t us)
+{
+    uint64_t wake = host_next_event_us;
+    
+    if (!event_since_idle && wake > host_now_us + us && wake - host_now_us <= UINT32_MAX) {
+        us = (uint32_t)(wake - host_now_us);
+    }
+    host_delay_run(us);
+    
+    // The loop pass after this pause sees everything up to now
+    event_since_idle = false;
+}
+
+static void usage(const char* program)
+{
+    fprintf(stderr,
+            "Usage: %s [--seconds N] [--time \"YYYY-MM-DD HH:MM:SS\"]\n"
+            "       [--script FILE] [--eeprom FILE] [--at24c32 FILE]\n"
+            "       [--realtime] [--uart] [--trace FILE]\n", program);
+    exit(2);
+}
+
+int main(int argc, char** argv)
+{
+    unsigned year = 2024, month = 1, day = 15, hour = 12, minute = 30, second = 0;
+    bool scripted = false;
+    
+    for (int i = 1; i < argc; i++) {
+        const char* option = argv[i];
+        
+        if (strcmp(option, "--realtime") == 0) {
+            realtime = true;
+        } else if (strcmp(option, "--uart") == 0) {
+            uart_record = true;
+        } else if (i + 1 >= argc) {
+            usage(argv[0]);
+        } else if (strcmp(option, "--seconds") == 0) {
+            end_us = (uint64_t)(strtod(argv[++i], NULL) * 1e6);
+        } else if (strcmp(option, "--script") == 0) {
+            if (!script_load(argv[++i])) {
+                return 1;
+            }
+            scripted = true;
+        } else if (strcmp(option, "--trace") == 0) {
+#ifndef TRACE
+            fprintf(stderr, "%s: built without TRACE (make TRACE=1)\n", argv[0]);
+            return 2;
+#endif
+            if ((trace_file = fopen(argv[++i], "wb")) == NULL) {
+                perror(argv[i]);
+                return 1;
+            }
+        } else if (strcmp(option, "--eeprom") == 0) {
+            eeprom_path = argv[++i];
+        } else if (strcmp(option, "--at24c32") == 0) {
+            at24c32_path = argv[++i];
+        } else if (strcmp(option, "--time") == 0) {
+            if (sscanf(argv[++i], "%u-%u-%u %u:%u:%u",
+                       &year, &month, &day, &hour, &minute, &second) != 6) {
+                usage(argv[0]);
+            }
+        } else {
+            usage(argv[0]);
+        }
+    }
+    
+    // Without --seconds a script runs to its END, a plain run for 10 s
+    if (end_us == HOST_NEVER) {
+        end_us = scripted ? script_end() : DEFAULT_RUN_US;
+        if (end_us == HOST_NEVER) {
+            fprintf(stderr, "%s: the script has no END, pass --seconds\n", argv[0]);
+            return 2;
+        }
+    }
+    
+    eeprom_load();
+    at24c32_load(at24c32_path);
+    ds1307_set(year, month, day, hour, minute, second);
+    script_run(0);
+    host_schedule();
+    firmware_save();
+    if (setjmp(reset_jump) != 0) {
+        firmware_restore();
+    }
+    firmware_main();
+    host_finish();
+    return 0;
+}
@@ -0,0 +1,99 @@
+#ifndef HOST_H
+#define HOST_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Interfaces between the host backend (host.c) and the device models.
+// Each model reports the virtual time of its next event and is run when
+// the clock reaches it.
+
+#define HOST_NEVER      UINT64_MAX
+
+// Virtual time in microseconds since power-up
+uint64_t host_time_us(void);
+
+// Recompute the next event after it may have moved
+void host_schedule(void);
+
+// Recording: timestamped lines on stdout
+void host_log(const char* format, ...) __attribute__((format(printf, 1, 2)));
+void host_record_frames(bool on);
+void host_finish(void) __attribute__((noreturn));
+
+// Watchdog reset of the MCU (host.c): taken at the end of the current
+// event, the device models keep their state
+void host_reset(void);
+
+// USART model (host.c): bytes sent to the firmware, console recording
+void host_uart_receive(const uint8_t* data, uint8_t length);
+void host_record_uart(bool on);
+
+// HD44780 model (hd44780.c), wired to port D as in lcd.h or behind the
+// PCF8574 model
+void hd44780_latch(bool rs, uint8_t nibble);    // Falling edge of EN
+void hd44780_frame(char rows[2][17]);
+bool hd44780_changed(void);
+
+// I2C slaves (i2c.c routes the bus by address): select after a start
+// (false is a NACK), write, read, and the stop that ends a transfer
+#define DS1307_ADDRESS  0x68
+#define AT24C32_ADDRESS 0x57
+#define PCF8574_ADDRESS 0x27
+#define PCF8563_ADDRESS 0x51
+
+// Bus faults injected by the script (i2c.c)
+typedef enum {
+    HOST_I2C_STUCK,     // A slave holds SDA low until a bus clear
+    HOST_I2C_GLITCH,    // The next address bytes go unacknowledged
+    HOST_I2C_STRETCH,   // The next address bytes time out on a stretched clock
+    HOST_I2C_FAULTS
+} host_i2c_fault_t;
+
+void host_i2c_fault(host_i2c_fault_t fault, uint8_t count);
+
+// RTC chip models (ds1307.c): one clock behind the register map of the
+// chip on the bus, a DS1307 unless the script says otherwise
+typedef enum {
+    HOST_RTC_NONE,
+    HOST_RTC_DS1307,
+    HOST_RTC_DS3231,
+    HOST_RTC_PCF8563,
+    HOST_RTC_CHIPS
+} host_rtc_t;
+
+bool ds1307_select(bool read);
+bool ds1307_write(uint8_t data);
+uint8_t ds1307_read(void);
+bool pcf8563_select(bool read);
+bool pcf8563_write(uint8_t data);
+uint8_t pcf8563_read(void);
+void ds1307_set(uint16_t year, uint8_t month, uint8_t day,
+                uint8_t hour, uint8_t minute, uint8_t second);
+void ds1307_drift(int32_t ppm);
+void ds1307_chip(host_rtc_t chip);
+
+// AT24C32 EEPROM model (at24c32.c), as on DS3231 modules
+bool at24c32_select(bool read);
+bool at24c32_write(uint8_t data);
+uint8_t at24c32_read(void);
+void at24c32_stop(void);
+void at24c32_fit(bool on);
+void at24c32_load(const char* path);
+void at24c32_save(const char* path);
+
+// PCF8574 LCD backpack model (pcf8574.c), driving the HD44780 model
+bool pcf8574_select(bool read);
+bool pcf8574_write(uint8_t data);
+uint8_t pcf8574_read(void);
+
+// Event script (script.c): keys on the port B matrix of buttons.h,
+// clock jumps and drift, and recording control
+bool script_load(const char* path);
+uint64_t script_end(void);
+uint64_t script_next_event(void);
+void script_run(uint64_t now);
+uint8_t keypad_pins(uint8_t ddr, uint8_t port);
+bool keypad_busy(uint64_t now);
+
+#endif // HOST_H 
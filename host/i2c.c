@@ -0,0 +1,149 @@
+/*
+ * I2C bus of the host build: the byte-level master calls of hal.h, routed
+ * by slave address to the device models. A model acknowledges its address
+ * (or not, like a busy EEPROM) and each byte written to it; an address
+ * nobody acknowledges leaves the rest of the transfer unanswered, and a
+ * read from nobody returns 0xFF (SDA released).
+ *
+ * Scripts inject bus faults (host_i2c_fault()): a slave stuck holding SDA
+ * low until a bus clear, glitched address bytes that go unacknowledged,
+ * and clocks stretched past the HAL limit.
+ */
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "hal.h"
+#include "host.h"
+
+typedef enum {
+    BUS_IDLE,       // Waiting for a start condition
+    BUS_ADDRESS,    // Next byte is the slave address
+    BUS_WRITE,      // Written bytes go to the selected device
+    BUS_READ,       // Reads come from the selected device
+    BUS_IGNORE      // Nobody answered the address
+} bus_state_t;
+
+typedef struct {
+    uint8_t address;
+    bool (*select)(bool read);      // Addressed after a start; false is a NACK
+    bool (*write)(uint8_t data);
+    uint8_t (*read)(void);
+    void (*stop)(void);             // Optional
+} i2c_device_t;
+
+static const i2c_device_t devices[] = {
+    { DS1307_ADDRESS,  ds1307_select,  ds1307_write,  ds1307_read,  NULL },
+    { AT24C32_ADDRESS, at24c32_select, at24c32_write, at24c32_read, at24c32_stop },
+    { PCF8574_ADDRESS, pcf8574_select, pcf8574_write, pcf8574_read, NULL },
+    { PCF8563_ADDRESS, pcf8563_select, pcf8563_write, pcf8563_read, NULL },
+};
+#define DEVICE_COUNT        (sizeof(devices) / sizeof(devices[0]))
+
+static bus_state_t bus = BUS_IDLE;
+static const i2c_device_t* device = NULL;
+
+// Injected faults
+static bool stuck = false;          // SDA held low until hal_i2c_recover()
+static uint8_t glitches = 0;        // Address bytes still to go unacknowledged
+static uint8_t stretches = 0;       // Address bytes still to time out
+static bool timed_out = false;
+
+void host_i2c_fault(host_i2c_fault_t fault, uint8_t count)
+{
+    switch (fault) {
+        case HOST_I2C_STUCK:
+            stuck = true;
+            break;
+        case HOST_I2C_GLITCH:
+            glitches = count;
+            break;
+        case HOST_I2C_STRETCH:
+            stretches = count;
+            break;
+        default:
+            break;
+    }
+}
+
+void hal_i2c_init(void)
+{
+    bus = BUS_IDLE;
+    device = NULL;
+    timed_out = false;
+}
+
+// A repeated start ends the transfer to the device without a stop
+bool hal_i2c_start(void)
+{
+    timed_out = false;
+    if (stuck) {
+        bus = BUS_IDLE;
+        return false;
+    }
+    bus = BUS_ADDRESS;
+    return true;
+}
+
+void hal_i2c_stop(void)
+{
+    if (device != NULL && device->stop != NULL) {
+        device->stop();
+    }
+    device = NULL;
+    bus = BUS_IDLE;
+}
+
+bool hal_i2c_write(uint8_t data)
+{
+    switch (bus) {
+        case BUS_ADDRESS:
+            bus = BUS_IGNORE;
+            device = NULL;
+            if (stretches > 0) {
+                stretches--;
+                timed_out = true;
+                return false;
+            }
+            if (glitches > 0) {
+                glitches--;
+                return false;
+            }
+            for (size_t i = 0; i < DEVICE_COUNT; i++) {
+                if ((data >> 1) == devices[i].address && devices[i].select(data & 1)) {
+                    device = &devices[i];
+                    bus = (data & 1) ? BUS_READ : BUS_WRITE;
+                }
+            }
+            return bus != BUS_IGNORE;
+        case BUS_WRITE:
+            return device->write(data);
+        default:
+            return false;
+    }
+}
+
+uint8_t hal_i2c_read(bool ack)
+{
+    (void)ack;
+    if (bus != BUS_READ) {
+        return 0xFF;    // Nobody drives SDA
+    }
+    return device->read();
+}
+
+bool hal_i2c_timed_out(void)
+{
+    return timed_out;
+}
+
+// The clocks of a bus clear free a stuck slave
+bool hal_i2c_recover(void)
+{
+    if (stuck) {
+        stuck = false;
+        host_log("i2c bus clear");
+    }
+    hal_i2c_stop();
+    timed_out = false;
+    return true;
+}
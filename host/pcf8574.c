@@ -0,0 +1,33 @@
+/*
+ * PCF8574 LCD backpack model on the I2C bus (i2c.c): every byte written
+ * sets the eight pins, wired as in lcd.h (P0 RS, P2 EN, P4-P7 D4-D7), and
+ * a falling edge of EN latches a nibble into the HD44780 model. The
+ * expander powers up with every pin high.
+ */
+#include <stdint.h>
+#include <stdbool.h>
+#include "hal.h"
+#include "host.h"
+#include "lcd.h"
+
+static uint8_t pins = 0xFF;
+
+bool pcf8574_select(bool read)
+{
+    (void)read;
+    return true;
+}
+
+bool pcf8574_write(uint8_t data)
+{
+    if ((pins & LCD_PCF8574_EN) && !(data & LCD_PCF8574_EN)) {
+        hd44780_latch(pins & LCD_PCF8574_RS, pins >> 4);
+    }
+    pins = data;
+    return true;
+}
+
+uint8_t pcf8574_read(void)
+{
+    return pins;
+}
@@ -0,0 +1,412 @@
+/*
+ * Event script of the host build: key presses on the 2x2 matrix of
+ * buttons.h, jumps of the DS1307 clock, bytes on the USART, resets of the
+ * MCU and control of the recording. One event per line, '#' starts a comment:
+ *
+ *     <when> MODE|SET|START|STOP down|up|tap   press, release or tap a key
+ *     <when> TIME YYYY-MM-DD HH:MM:SS          set the DS1307 (time jump)
+ *     <when> DRIFT <ppm>                       run the DS1307 ppm fast (or slow)
+ *     <when> RTC DS1307|DS3231|PCF8563|none    chip on the bus (at 0: before the probe)
+ *     <when> AT24C32 on|off                    module EEPROM on the bus or not
+ *     <when> I2C stuck|glitch N|stretch N      bus fault: SDA held low until a bus
+ *                                              clear, next N addresses NACKed or
+ *                                              timed out
+ *     <when> RX a5 01 01 ...                   send bytes (hex) to the USART
+ *     <when> FRAMES on|off                     record LCD frames or not
+ *     <when> UART on|off                       record the console or not
+ *     <when> RESET                             watchdog reset of the MCU
+ *     <when> END                               end of the run
+ *
+ * <when> is the virtual time since power-up, a sum of terms like 1d, 2h,
+ * 30m, 15s and 250ms (a bare number is milliseconds). "tap" holds the key
+ * for SCRIPT_TAP_MS. A held key pulls its column low while its row is
+ * driven low.
+ */
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "hal.h"
+#include "host.h"
+#include "buttons.h"
+
+#define SCRIPT_MAX_EVENTS   4096
+#define SCRIPT_TAP_MS       100
+#define KEYPAD_SETTLE_US    50000ULL    // Longer than any debounce (buttons.h)
+#define SCRIPT_KEYS         4
+#define SCRIPT_RX_MAX       40
+#define MS_US               1000ULL
+
+typedef enum {
+    EVENT_KEY_DOWN,
+    EVENT_KEY_UP,
+    EVENT_TIME,
+    EVENT_DRIFT,
+    EVENT_RTC,
+    EVENT_AT24C32,
+    EVENT_I2C,
+    EVENT_RX,
+    EVENT_FRAMES,
+    EVENT_UART,
+    EVENT_RESET,
+    EVENT_END
+} event_kind_t;
+
+typedef struct {
+    uint64_t time;
+    uint8_t kind;           // event_kind_t
+    uint8_t key;            // BTN_* for key events, on/off for FRAMES, UART
+                            // and AT24C32,
+                            // byte count for RX, host_rtc_t for RTC,
+                            // host_i2c_fault_t for I2C
+    uint8_t count;          // I2C only
+    uint16_t year;          // TIME only
+    uint8_t month, day, hour, minute, second;
+    int32_t ppm;            // DRIFT only
+    uint8_t data[SCRIPT_RX_MAX];    // RX only
+} script_event_t;
+
+static script_event_t events[SCRIPT_MAX_EVENTS];
+static uint16_t event_count = 0;
+static uint16_t next_event = 0;
+static uint8_t held = 0;            // Bit per key, (1 << BTN_*)
+static uint64_t keys_changed = 0;   // Time of the last key event
+static uint64_t end_time = HOST_NEVER;
+
+static const char* const key_names[SCRIPT_KEYS] = {"MODE", "SET", "START", "STOP"};
+static const char* const rtc_names[HOST_RTC_CHIPS] = {"none", "DS1307", "DS3231", "PCF8563"};
+static const char* const i2c_fault_names[HOST_I2C_FAULTS] = {"stuck", "glitch", "stretch"};
+
+static bool script_add(const script_event_t* event)
+{
+    uint16_t i;
+    
+    if (event_count == SCRIPT_MAX_EVENTS) {
+        return false;
+    }
+    
+    // Keep the list ordered by time (stable for equal times)
+    i = event_count++;
+    while (i > 0 && events[i - 1].time > event->time) {
+        events[i] = events[i - 1];
+        i--;
+    }
+    events[i] = *event;
+    return true;
+}
+
+// Parse "<n><unit>..." into microseconds
+static bool script_parse_when(const char* text, uint64_t* when)
+{
+    uint64_t total = 0;
+    
+    if (*text == '\0') {
+        return false;
+    }
+    while (*text != '\0') {
+        char* end;
+        unsigned long long value = strtoull(text, &end, 10);
+        uint64_t unit;
+        
+        if (end == text) {
+            return false;
+        }
+        if (strncmp(end, "ms", 2) == 0) {
+            unit = MS_US;
+            end += 2;
+        } else if (*end == 'd') {
+            unit = 86400000ULL * MS_US;
+            end++;
+        } else if (*end == 'h') {
+            unit = 3600000ULL * MS_US;
+            end++;
+        } else if (*end == 'm') {
+            unit = 60000ULL * MS_US;
+            end++;
+        } else if (*end == 's') {
+            unit = 1000ULL * MS_US;
+            end++;
+        } else {
+            unit = MS_US;
+        }
+        total += value * unit;
+        text = end;
+    }
+    *when = total;
+    return true;
+}
+
+static bool script_parse_line(const char* line, script_event_t* event, bool* tap)
+{
+    char when[32], command[16], argument[16];
+    unsigned year, month, day, hour, minute, second;
+    int fields = sscanf(line, "%31s %15s %15s", when, command, argument);
+    
+    memset(event, 0, sizeof(*event));
+    *tap = false;
+    if (fields < 2 || !script_parse_when(when, &event->time)) {
+        return false;
+    }
+    
+    if (strcmp(command, "END") == 0 || strcmp(command, "RESET") == 0) {
+        event->kind = (command[0] == 'E') ? EVENT_END : EVENT_RESET;
+        return fields == 2;
+    }
+    if (fields < 3) {
+        return false;
+    }
+    
+    if (strcmp(command, "FRAMES") == 0 || strcmp(command, "UART") == 0) {
+        event->kind = (command[0] == 'F') ? EVENT_FRAMES : EVENT_UART;
+        event->key = (strcmp(argument, "on") == 0);
+        return event->key || strcmp(argument, "off") == 0;
+    }
+    
+    if (strcmp(command, "AT24C32") == 0) {
+        event->kind = EVENT_AT24C32;
+        event->key = (strcmp(argument, "on") == 0);
+        return event->key || strcmp(argument, "off") == 0;
+    }
+    
+    if (strcmp(command, "RX") == 0) {
+        const char* text = strstr(line, "RX") + 2;
+        
+        event->kind = EVENT_RX;
+        while (text += strspn(text, " \t"), *text != '\0' && *text != '\r' && *text != '\n' &&
+               *text != '#') {
+            char* end;
+            unsigned long value = strtoul(text, &end, 16);
+            
+            if (end == text || value > 0xFF || event->key == SCRIPT_RX_MAX) {
+                return false;
+            }
+            event->data[event->key++] = (uint8_t)value;
+            text = end;
+        }
+        return true;
+    }
+    
+    if (strcmp(command, "DRIFT") == 0) {
+        char* end;
+        long ppm = strtol(argument, &end, 10);
+        
+        event->kind = EVENT_DRIFT;
+        event->ppm = (int32_t)ppm;
+        return *end == '\0' && ppm > -100000 && ppm < 100000;
+    }
+    
+    if (strcmp(command, "RTC") == 0) {
+        event->kind = EVENT_RTC;
+        for (event->key = 0; event->key < HOST_RTC_CHIPS; event->key++) {
+            if (strcmp(argument, rtc_names[event->key]) == 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+    
+    if (strcmp(command, "I2C") == 0) {
+        unsigned count = 0;
+        
+        event->kind = EVENT_I2C;
+        for (event->key = 0; event->key < HOST_I2C_FAULTS; event->key++) {
+            if (strcmp(argument, i2c_fault_names[event->key]) == 0) {
+                break;
+            }
+        }
+        if (event->key == HOST_I2C_FAULTS) {
+            return false;
+        }
+        if (event->key == HOST_I2C_STUCK) {
+            return fields == 3;
+        }
+        if (sscanf(line, "%*s %*s %*s %u", &count) != 1 || count < 1 || count > 255) {
+            return false;
+        }
+        event->count = (uint8_t)count;
+        return true;
+    }
+    
+    if (strcmp(command, "TIME") == 0) {
+        if (sscanf(line, "%*s %*s %u-%u-%u %u:%u:%u",
+                   &year, &month, &day, &hour, &minute, &second) != 6 ||
+            year < 2000 || year > 2099 || month < 1 || month > 12 || day < 1 || day > 31 ||
+            hour > 23 || minute > 59 || second > 59) {
+            return false;
+        }
+        event->kind = EVENT_TIME;
+        event->year = year;
+        event->month = month;
+        event->day = day;
+        event->hour = hour;
+        event->minute = minute;
+        event->second = second;
+        return true;
+    }
+    
+    for (event->key = 0; event->key < SCRIPT_KEYS; event->key++) {
+        if (strcmp(command, key_names[event->key]) == 0) {
+            break;
+        }
+    }
+    if (event->key == SCRIPT_KEYS) {
+        return false;
+    }
+    if (strcmp(argument, "tap") == 0) {
+        *tap = true;
+        event->kind = EVENT_KEY_DOWN;
+    } else if (strcmp(argument, "down") == 0) {
+        event->kind = EVENT_KEY_DOWN;
+    } else if (strcmp(argument, "up") == 0) {
+        event->kind = EVENT_KEY_UP;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+bool script_load(const char* path)
+{
+    FILE* file = fopen(path, "r");
+    char line[128];
+    unsigned line_number = 0;
+    
+    if (file == NULL) {
+        perror(path);
+        return false;
+    }
+    
+    while (fgets(line, sizeof(line), file) != NULL) {
+        script_event_t event;
+        bool tap, added;
+        
+        line_number++;
+        if (line[0] == '#' || strspn(line, " \t\r\n") == strlen(line)) {
+            continue;
+        }
+        if (!script_parse_line(line, &event, &tap)) {
+            fprintf(stderr, "%s:%u: cannot parse '%s'\n", path, line_number, strtok(line, "\r\n"));
+            fclose(file);
+            return false;
+        }
+        added = script_add(&event);
+        if (added && tap) {
+            event.kind = EVENT_KEY_UP;
+            event.time += SCRIPT_TAP_MS * MS_US;
+            added = script_add(&event);
+        }
+        if (event.kind == EVENT_END && event.time < end_time) {
+            end_time = event.time;
+        }
+        if (!added) {
+            fprintf(stderr, "%s:%u: more than %u events\n", path, line_number, SCRIPT_MAX_EVENTS);
+            fclose(file);
+            return false;
+        }
+    }
+    
+    fclose(file);
+    return true;
+}
+
+// Time of the first END, HOST_NEVER without one
+uint64_t script_end(void)
+{
+    return end_time;
+}
+
+uint64_t script_next_event(void)
+{
+    return (next_event < event_count) ? events[next_event].time : HOST_NEVER;
+}
+
+void script_run(uint64_t now)
+{
+    while (next_event < event_count && events[next_event].time <= now) {
+        const script_event_t* event = &events[next_event++];
+        
+        switch (event->kind) {
+            case EVENT_KEY_DOWN:
+            case EVENT_KEY_UP:
+                if (event->kind == EVENT_KEY_DOWN) {
+                    held |= 1 << event->key;
+                } else {
+                    held &= ~(1 << event->key);
+                }
+                keys_changed = now;
+                host_log("key %s %s", key_names[event->key],
+                         (event->kind == EVENT_KEY_DOWN) ? "down" : "up");
+                break;
+            case EVENT_TIME:
+                ds1307_set(event->year, event->month, event->day,
+                           event->hour, event->minute, event->second);
+                host_log("time %04u-%02u-%02u %02u:%02u:%02u", event->year, event->month,
+                         event->day, event->hour, event->minute, event->second);
+                break;
+            case EVENT_DRIFT:
+                ds1307_drift(event->ppm);
+                host_log("drift %+d ppm", (int)event->ppm);
+                break;
+            case EVENT_RTC:
+                ds1307_chip((host_rtc_t)event->key);
+                host_log("rtc %s", rtc_names[event->key]);
+                break;
+            case EVENT_AT24C32:
+                at24c32_fit(event->key);
+                host_log("at24c32 %s", event->key ? "on" : "off");
+                break;
+            case EVENT_I2C:
+                host_i2c_fault((host_i2c_fault_t)event->key, event->count);
+                if (event->key == HOST_I2C_STUCK) {
+                    host_log("i2c %s", i2c_fault_names[event->key]);
+                } else {
+                    host_log("i2c %s %u", i2c_fault_names[event->key], event->count);
+                }
+                break;
+            case EVENT_RX:
+                host_uart_receive(event->data, event->key);
+                host_log("rx %u bytes", event->key);
+                break;
+            case EVENT_FRAMES:
+                host_record_frames(event->key);
+                break;
+            case EVENT_UART:
+                host_record_uart(event->key);
+                break;
+            case EVENT_RESET:
+                host_log("reset");
+                host_reset();
+                break;
+            case EVENT_END:
+                break;              // Ends the run through script_end()
+        }
+    }
+}
+
+// Keys are held or were let go too recently for the debounce to settle;
+// otherwise every scan of the keypad reads what the last one did
+bool keypad_busy(uint64_t now)
+{
+    return held != 0 || now < keys_changed + KEYPAD_SETTLE_US;
+}
+
+// Pin levels of port B: outputs read back, inputs are pulled up unless a
+// held key connects them to a row driven low
+uint8_t keypad_pins(uint8_t ddr, uint8_t port)
+{
+    uint8_t pins = port;
+    
+    if (held == 0) {
+        return pins;
+    }
+    for (uint8_t key = 0; key < SCRIPT_KEYS; key++) {
+        uint8_t row = 1 << (ROW1_PIN + key / 2);
+        uint8_t col = 1 << (COL1_PIN + key % 2);
+        
+        if ((held & (1 << key)) && (ddr & row) && !(port & row)) {
+            pins &= ~col;
+        }
+    }
+    return pins;
+}
@@ -0,0 +1,177 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "hal.h"
+#include "i2c_bus.h"
+
+static i2c_counters_t devices[I2C_DEVICES];
+
+// Streamed write (i2c_begin()): its device and whether every byte got through
+static i2c_counters_t* stream = NULL;
+static bool stream_ok = false;
+
+// Saturating increment (the counters are packed: no pointers to them)
+static uint16_t counter_bump(uint16_t counter)
+{
+    return (counter < UINT16_MAX) ? counter + 1 : counter;
+}
+
+// Counters of the device at address; a spare slot past the table when
+// all are taken, so that callers need not check
+static i2c_counters_t* i2c_device(uint8_t address)
+{
+    static i2c_counters_t spare;
+    
+    for (uint8_t i = 0; i < I2C_DEVICES; i++) {
+        if (devices[i].address == address) {
+            return &devices[i];
+        }
+        if (devices[i].address == 0) {
+            devices[i].address = address;
+            return &devices[i];
+        }
+    }
+    return &spare;
+}
+
+// Start a transfer and send the address byte. A bus held low is cleared
+// first; false if it stays held, the clock stretched too long or the
+// address was not acknowledged. The caller sends the stop either way.
+static bool i2c_start(i2c_counters_t* device, uint8_t address_byte)
+{
+    if (!hal_i2c_start()) {
+        device->recoveries = counter_bump(device->recoveries);
+        if (!hal_i2c_recover() || !hal_i2c_start()) {
+            return false;
+        }
+    }
+    return hal_i2c_write(address_byte);
+}
+
+// Count a failed attempt: a timeout if the clock was held, else a NACK
+static void i2c_failed(i2c_counters_t* device, bool count_nack)
+{
+    if (hal_i2c_timed_out()) {
+        device->timeouts = counter_bump(device->timeouts);
+    } else if (count_nack) {
+        device->nacks = counter_bump(device->nacks);
+    }
+}
+
+// Whether a device answers its address. A NACK is an answer (an absent
+// chip, a busy EEPROM) and is neither counted nor retried; a timeout is.
+bool i2c_probe(uint8_t address)
+{
+    i2c_counters_t* device = i2c_device(address);
+    
+    for (uint8_t attempt = 0; attempt <= I2C_RETRIES; attempt++) {
+        bool ack = i2c_start(device, address << 1);
+        
+        hal_i2c_stop();
+        if (ack) {
+            return true;
+        }
+        if (!hal_i2c_timed_out()) {
+            return false;
+        }
+        i2c_failed(device, false);
+    }
+    return false;
+}
+
+// Write the header, then read length bytes after a repeated start
+bool i2c_read(uint8_t address, const uint8_t* header, uint8_t header_length,
+              uint8_t* data, uint8_t length)
+{
+    i2c_counters_t* device = i2c_device(address);
+    
+    for (uint8_t attempt = 0; attempt <= I2C_RETRIES; attempt++) {
+        const uint8_t* next = header;
+        uint8_t remaining = header_length;
+        bool ack = i2c_start(device, address << 1);
+        
+        while (ack && remaining--) {
+            ack = hal_i2c_write(*next++);
+        }
+        ack = ack && hal_i2c_start() && hal_i2c_write((address << 1) | 1);
+        if (ack) {
+            for (uint8_t i = 0; i < length; i++) {
+                data[i] = hal_i2c_read(i + 1 < length);    // NACK the last byte
+            }
+            ack = !hal_i2c_timed_out();
+        }
+        hal_i2c_stop();
+        if (ack) {
+            return true;
+        }
+        i2c_failed(device, true);
+    }
+    return false;
+}
+
+// Write the header and the data in one transaction
+bool i2c_write(uint8_t address, const uint8_t* header, uint8_t header_length,
+               const uint8_t* data, uint8_t length)
+{
+    i2c_counters_t* device = i2c_device(address);
+    
+    for (uint8_t attempt = 0; attempt <= I2C_RETRIES; attempt++) {
+        const uint8_t* next = header;
+        uint8_t remaining = header_length;
+        bool ack = i2c_start(device, address << 1);
+        
+        while (ack && remaining--) {
+            ack = hal_i2c_write(*next++);
+        }
+        next = data;
+        remaining = length;
+        while (ack && remaining--) {
+            ack = hal_i2c_write(*next++);
+        }
+        hal_i2c_stop();
+        if (ack) {
+            return true;
+        }
+        i2c_failed(device, true);
+    }
+    return false;
+}
+
+// Streamed write, for data not held in one buffer: i2c_begin() addresses
+// the device (with retries), i2c_send() adds bytes and i2c_end() sends the
+// stop. A byte that fails is not retried; i2c_end() reports it.
+bool i2c_begin(uint8_t address)
+{
+    stream = i2c_device(address);
+    for (uint8_t attempt = 0; attempt <= I2C_RETRIES; attempt++) {
+        if (i2c_start(stream, address << 1)) {
+            stream_ok = true;
+            return true;
+        }
+        hal_i2c_stop();
+        i2c_failed(stream, true);
+    }
+    return false;
+}
+
+void i2c_send(uint8_t data)
+{
+    if (stream_ok) {
+        stream_ok = hal_i2c_write(data);
+    }
+}
+
+bool i2c_end(void)
+{
+    hal_i2c_stop();
+    if (!stream_ok) {
+        i2c_failed(stream, true);
+    }
+    return stream_ok;
+}
+
+// The I2C_DEVICES counter slots
+const i2c_counters_t* i2c_counters(void)
+{
+    return devices;
+}
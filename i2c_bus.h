@@ -0,0 +1,45 @@
+#ifndef I2C_BUS_H
+#define I2C_BUS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// I2C transactions over the byte-level master of hal.h, with bounded time
+// and per-device health counters. A transaction is a start, the address,
+// a header (register or memory address) and then either the data to write
+// or a repeated start and the data to read. It is tried up to
+// 1 + I2C_RETRIES times: after a NACK, after a clock stretched past
+// HAL_I2C_STRETCH_US, and after a bus held low by a slave that a reset
+// cut off mid-byte, which is cleared with nine clocks and a stop first.
+//
+// Nothing waits without a bound, so the worst case is fixed: the RTC's
+// burst read (10 bytes on the bus) takes about 1 ms on the bit-banged bus,
+// an attempt at most 1.5 ms with a bus clear and a timeout, and the
+// transaction under 5 ms with its retries.
+
+#define I2C_RETRIES         2
+
+// Counter slots, taken by address on first use: the two RTC addresses
+// probed at boot, the event log EEPROM and the LCD backpack
+#define I2C_DEVICES         4
+
+// Health of one device since boot, saturating (sent as is by provision.c)
+typedef struct {
+    uint8_t address;                // 0: slot unused
+    uint16_t nacks;                 // Bytes not acknowledged
+    uint16_t timeouts;              // Clocks stretched past HAL_I2C_STRETCH_US
+    uint16_t recoveries;            // Bus clears before its transfers
+} __attribute__((packed)) i2c_counters_t;
+
+// Function prototypes
+bool i2c_probe(uint8_t address);
+bool i2c_read(uint8_t address, const uint8_t* header, uint8_t header_length,
+              uint8_t* data, uint8_t length);
+bool i2c_write(uint8_t address, const uint8_t* header, uint8_t header_length,
+               const uint8_t* data, uint8_t length);
+bool i2c_begin(uint8_t address);
+void i2c_send(uint8_t data);
+bool i2c_end(void);
+const i2c_counters_t* i2c_counters(void);
+
+#endif // I2C_BUS_H 
@@ -1,51 +1,78 @@
-#include <avr/io.h>
-#include <util/delay.h>
 #include <stdint.h>
 #include <stdio.h>
+#include "hal.h"
 #include "lcd.h"
+#include "prof.h"
 
 // LCD initialization
 void lcd_init(void)
 {
-    // Configure LCD pins as outputs
-    DDRD |= (1 << LCD_RS_PIN) | (1 << LCD_RW_PIN) | (1 << LCD_EN_PIN) |
-             (1 << LCD_D4_PIN) | (1 << LCD_D5_PIN) | (1 << LCD_D6_PIN) | (1 << LCD_D7_PIN);
+    // Configure the LCD pins or the backpack
+    lcd_bus_init();
     
     // Wait for power-up
-    _delay_ms(50);
+    hal_delay_ms(50);
     
     // Initialize LCD in 4-bit mode
     lcd_write_nibble(0x03);
-    _delay_ms(5);
+    hal_delay_ms(5);
     lcd_write_nibble(0x03);
-    _delay_ms(5);
+    hal_delay_ms(5);
     lcd_write_nibble(0x03);
-    _delay_ms(5);
+    hal_delay_ms(5);
     lcd_write_nibble(0x02);
-    _delay_ms(5);
+    hal_delay_ms(5);
     
     // Function set: 4-bit mode, 2 lines, 5x8 font
     lcd_write_command(LCD_FUNCTION_SET | LCD_4BIT_MODE | LCD_2LINE | LCD_5x8DOTS);
-    _delay_ms(5);
+    hal_delay_ms(5);
     
     // Display control: display on, cursor off, blink off
     lcd_write_command(LCD_DISPLAY_CONTROL | LCD_DISPLAY_ON | LCD_CURSOR_OFF | LCD_BLINK_OFF);
-    _delay_ms(5);
+    hal_delay_ms(5);
     
     // Entry mode set: increment cursor, no display shift
     lcd_write_command(LCD_ENTRY_MODE_SET | LCD_ENTRY_LEFT | LCD_ENTRY_SHIFT_DEC);
-    _delay_ms(5);
+    hal_delay_ms(5);
     
     // Clear display
     lcd_clear();
-    _delay_ms(5);
+    hal_delay_ms(5);
+}
+
+// Re-initialize an LCD that stayed powered across an MCU reset (watchdog or
+// brownout). The controller may be out of nibble sync, so the 8-bit resync
+// sequence is still sent, but with datasheet minimum waits instead of the
+// cold power-up delays: about 7 ms in total.
+void lcd_reinit(void)
+{
+    // Configure the LCD pins or the backpack
+    lcd_bus_init();
+    
+    lcd_write_nibble(0x03);
+    hal_delay_us(4100);
+    lcd_write_nibble(0x03);
+    hal_delay_us(100);
+    lcd_write_nibble(0x03);
+    hal_delay_us(100);
+    lcd_write_nibble(0x02);
+    hal_delay_us(100);
+    
+    lcd_write_command(LCD_FUNCTION_SET | LCD_4BIT_MODE | LCD_2LINE | LCD_5x8DOTS);
+    hal_delay_us(50);
+    lcd_write_command(LCD_DISPLAY_CONTROL | LCD_DISPLAY_ON | LCD_CURSOR_OFF | LCD_BLINK_OFF);
+    hal_delay_us(50);
+    lcd_write_command(LCD_ENTRY_MODE_SET | LCD_ENTRY_LEFT | LCD_ENTRY_SHIFT_DEC);
+    hal_delay_us(50);
+    
+    lcd_clear();
 }
 
 // Clear LCD display
 void lcd_clear(void)
 {
     lcd_write_command(LCD_CLEAR_DISPLAY);
-    _delay_ms(2);
+    hal_delay_ms(2);
 }
 
 // Move cursor to specified position
@@ -65,10 +92,7 @@ void lcd_goto(uint8_t row, uint8_t col)
 // Print string to LCD
 void lcd_print(const char* str)
 {
-    while (*str != '\0') {
-        lcd_print_char(*str);
-        str++;
-    }
+    lcd_write_run(str);
 }
 
 // Print single character to LCD
@@ -99,11 +123,39 @@ void lcd_display_mode_name(const char* mode_name)
     lcd_print(mode_name);
 }
 
+// Blinking block at the current cursor position, drawn by the controller
+void lcd_blink(bool on)
+{
+    lcd_write_command(LCD_DISPLAY_CONTROL | LCD_DISPLAY_ON | LCD_CURSOR_OFF |
+                      (on ? LCD_BLINK_ON : LCD_BLINK_OFF));
+}
+
+#ifndef LCD_PCF8574
+
+// Parallel bus on port D: RS, EN and D4-D7 set pin by pin
+
+// Configure LCD pins as outputs, RS low for the nibbles of the init sequence
+void lcd_bus_init(void)
+{
+    hal_gpio_output(D, (1 << LCD_RS_PIN) | (1 << LCD_EN_PIN) |
+                       (1 << LCD_D4_PIN) | (1 << LCD_D5_PIN) | (1 << LCD_D6_PIN) | (1 << LCD_D7_PIN));
+    hal_gpio_clear(D, 1 << LCD_RS_PIN);
+}
+
+// Pulse enable pin
+static void lcd_pulse_enable(void)
+{
+    hal_gpio_set(D, 1 << LCD_EN_PIN);
+    hal_delay_us(1);
+    hal_gpio_clear(D, 1 << LCD_EN_PIN);
+    hal_delay_us(1);
+}
+
 // Write command to LCD
 void lcd_write_command(uint8_t cmd)
 {
     // Set RS low for command
-    PORTD &= ~(1 << LCD_RS_PIN);
+    hal_gpio_clear(D, 1 << LCD_RS_PIN);
     
     // Write high nibble
     lcd_write_nibble(cmd >> 4);
@@ -116,7 +168,7 @@ void lcd_write_command(uint8_t cmd)
 void lcd_write_data(uint8_t data)
 {
     // Set RS high for data
-    PORTD |= (1 << LCD_RS_PIN);
+    hal_gpio_set(D, 1 << LCD_RS_PIN);
     
     // Write high nibble
     lcd_write_nibble(data >> 4);
@@ -125,27 +177,33 @@ void lcd_write_data(uint8_t data)
     lcd_write_nibble(data & 0x0F);
 }
 
+// Write characters at the cursor
+void lcd_write_run(const char* str)
+{
+    while (*str != '\0') {
+        lcd_write_data(*str);
+        str++;
+    }
+}
+
 // Write 4-bit nibble to LCD
 void lcd_write_nibble(uint8_t nibble)
 {
+    PROF_BEGIN(PROF_LCD_NIBBLE);
+    
     // Clear data pins
-    PORTD &= ~((1 << LCD_D4_PIN) | (1 << LCD_D5_PIN) | (1 << LCD_D6_PIN) | (1 << LCD_D7_PIN));
+    hal_gpio_clear(D, (1 << LCD_D4_PIN) | (1 << LCD_D5_PIN) | (1 << LCD_D6_PIN) | (1 << LCD_D7_PIN));
     
     // Set data pins according to nibble
-    if (nibble & 0x01) PORTD |= (1 << LCD_D4_PIN);
-    if (nibble & 0x02) PORTD |= (1 << LCD_D5_PIN);
-    if (nibble & 0x04) PORTD |= (1 << LCD_D6_PIN);
-    if (nibble & 0x08) PORTD |= (1 << LCD_D7_PIN);
+    if (nibble & 0x01) hal_gpio_set(D, 1 << LCD_D4_PIN);
+    if (nibble & 0x02) hal_gpio_set(D, 1 << LCD_D5_PIN);
+    if (nibble & 0x04) hal_gpio_set(D, 1 << LCD_D6_PIN);
+    if (nibble & 0x08) hal_gpio_set(D, 1 << LCD_D7_PIN);
     
     // Pulse enable
     lcd_pulse_enable();
+    
+    PROF_END(PROF_LCD_NIBBLE);
 }
 
-// Pulse enable pin
-void lcd_pulse_enable(void)
-{
-    PORTD |= (1 << LCD_EN_PIN);
-    _delay_us(1);
-    PORTD &= ~(1 << LCD_EN_PIN);
-    _delay_us(1);
-} 
\ No newline at end of file
+#endif 
\ No newline at end of file
@@ -2,6 +2,7 @@
 #define LCD_H
 
 #include <stdint.h>
+#include <stdbool.h>
 
 // LCD Commands
 #define LCD_CLEAR_DISPLAY    0x01
@@ -32,17 +33,31 @@
 #define LCD_2LINE            0x08
 #define LCD_5x8DOTS          0x00
 
+// The controller is wired to PD2-PD7 in parallel, or sits on a PCF8574
+// I2C backpack when built with LCD_PCF8574 (lcd_pcf8574.c), which leaves
+// port D to the USART and the keypad's neighbours.
+
 // LCD Pin Definitions (for ATmega32)
-#define LCD_RS_PIN           PD0
-#define LCD_RW_PIN           PD1
+// RW is tied to GND (the LCD is never read); PD0/PD1 are the USART
+#define LCD_RS_PIN           PD3
 #define LCD_EN_PIN           PD2
 #define LCD_D4_PIN           PD4
 #define LCD_D5_PIN           PD5
 #define LCD_D6_PIN           PD6
 #define LCD_D7_PIN           PD7
 
+// PCF8574 backpack: I2C address (0x3F for a PCF8574A) and its pins
+#ifndef LCD_PCF8574_ADDRESS
+#define LCD_PCF8574_ADDRESS  0x27
+#endif
+#define LCD_PCF8574_RS       0x01    // P0; P1 is RW, held low
+#define LCD_PCF8574_EN       0x04    // P2
+#define LCD_PCF8574_LIGHT    0x08    // P3, backlight
+                                     // P4-P7: D4-D7
+
 // Function prototypes
 void lcd_init(void);
+void lcd_reinit(void);
 void lcd_clear(void);
 void lcd_goto(uint8_t row, uint8_t col);
 void lcd_print(const char* str);
@@ -50,11 +65,13 @@ void lcd_print_char(char c);
 void lcd_display_time(uint8_t hour, uint8_t minute, uint8_t second);
 void lcd_display_date(uint8_t day, uint8_t month, uint16_t year);
 void lcd_display_mode_name(const char* mode_name);
+void lcd_blink(bool on);
 
-// Internal functions
+// Internal functions: the bus to the controller
+void lcd_bus_init(void);
 void lcd_write_command(uint8_t cmd);
 void lcd_write_data(uint8_t data);
+void lcd_write_run(const char* str);
 void lcd_write_nibble(uint8_t nibble);
-void lcd_pulse_enable(void);
 
 #endif // LCD_H 
\ No newline at end of file
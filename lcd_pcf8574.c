@@ -0,0 +1,101 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include "hal.h"
+#include "lcd.h"
+#include "i2c_bus.h"
+#include "prof.h"
+
+// LCD bus over a PCF8574 I2C backpack (built with LCD_PCF8574). Each byte
+// written to the expander sets all of its pins at once, so a nibble is
+// two bytes, EN high with the data and then EN low, and a whole byte four.
+// A command, a character or a whole string goes out as one transaction:
+// one start and address, then four bytes per character. The controller
+// needs 37 us per byte, less than the two bytes of a nibble take on the
+// bus, so no delays are needed between characters.
+
+#ifdef LCD_PCF8574
+
+// Address the backpack; false if it does not answer
+static bool lcd_begin(void)
+{
+    PROF_BEGIN(PROF_LCD_NIBBLE);
+    if (!i2c_begin(LCD_PCF8574_ADDRESS)) {
+        PROF_END(PROF_LCD_NIBBLE);
+        return false;
+    }
+    return true;
+}
+
+static void lcd_end(void)
+{
+    i2c_end();
+    PROF_END(PROF_LCD_NIBBLE);
+}
+
+// Latch a nibble on the falling edge of EN
+static void lcd_send_nibble(uint8_t nibble, uint8_t rs)
+{
+    uint8_t pins = (nibble << 4) | rs | LCD_PCF8574_LIGHT;
+    
+    i2c_send(pins | LCD_PCF8574_EN);
+    i2c_send(pins);
+}
+
+static void lcd_send_byte(uint8_t value, uint8_t rs)
+{
+    lcd_send_nibble(value >> 4, rs);
+    lcd_send_nibble(value & 0x0F, rs);
+}
+
+// The expander powers up with every pin high, EN included, so its first
+// write latches whatever it sets: make that an 8-bit function set, the
+// first step of the init sequence anyway
+void lcd_bus_init(void)
+{
+    hal_i2c_init();
+    if (lcd_begin()) {
+        i2c_send((0x03 << 4) | LCD_PCF8574_EN | LCD_PCF8574_LIGHT);
+        i2c_send((0x03 << 4) | LCD_PCF8574_LIGHT);
+        lcd_end();
+    }
+}
+
+void lcd_write_command(uint8_t cmd)
+{
+    if (lcd_begin()) {
+        lcd_send_byte(cmd, 0);
+        lcd_end();
+    }
+}
+
+void lcd_write_data(uint8_t data)
+{
+    if (lcd_begin()) {
+        lcd_send_byte(data, LCD_PCF8574_RS);
+        lcd_end();
+    }
+}
+
+// Characters at the cursor, all in one transaction
+void lcd_write_run(const char* str)
+{
+    if (*str == '\0' || !lcd_begin()) {
+        return;
+    }
+    while (*str != '\0') {
+        lcd_send_byte(*str, LCD_PCF8574_RS);
+        str++;
+    }
+    lcd_end();
+}
+
+// A nibble of the 8-bit init sequence, with RS low
+void lcd_write_nibble(uint8_t nibble)
+{
+    if (lcd_begin()) {
+        lcd_send_nibble(nibble, 0);
+        lcd_end();
+    }
+}
+
+#endif
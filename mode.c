@@ -0,0 +1,156 @@
+#include <avr/pgmspace.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "hal.h"
+#include "mode.h"
+#include "lcd.h"
+#include "alarm.h"
+#include "buttons.h"
+#include "editor.h"
+#include "settings.h"
+#include "bench.h"
+#include "prof.h"
+#include "trace.h"
+
+static uint8_t current = 0;
+
+// Data changed since the last redraw; a new mode starts with a full one
+static uint8_t dirty = MODE_DIRTY_SCREEN;
+
+// The mode copy in .noinit survives watchdog and brownout resets
+static uint8_t noinit_mode HAL_NOINIT;
+static uint8_t noinit_mode_check HAL_NOINIT;
+
+static void mode_load(uint8_t mode, mode_desc_t* desc)
+{
+    memcpy_P(desc, &mode_table[mode], sizeof(*desc));
+}
+
+// Power up into the saved mode (after settings_init())
+void mode_restore(bool warm_boot)
+{
+    uint8_t mode = settings_get_mode();
+    mode_desc_t desc;
+    
+    // After a warm reset the RAM copy is newer than the coalesced EEPROM one
+    if (warm_boot && (uint8_t)(noinit_mode ^ noinit_mode_check) == 0xFF) {
+        mode = noinit_mode;
+    }
+    
+    if (mode >= mode_count) {
+        mode = 0;
+    }
+    mode_load(mode, &desc);
+    if (desc.flags & MODE_NO_RESTORE) {
+        mode = 0;
+    }
+    
+    current = mode;
+    mode_reload();
+}
+
+void mode_set(uint8_t mode)
+{
+    mode_desc_t desc;
+    
+    mode_load(current, &desc);
+    if (desc.on_exit != NULL) {
+        desc.on_exit();
+    }
+    
+    current = mode;
+    
+    // Cheap copy for warm resets, EEPROM copy for power cycles
+    noinit_mode = mode;
+    noinit_mode_check = ~mode;
+    settings_set_mode(mode);
+    
+    mode_reload();
+}
+
+void mode_next(void)
+{
+    mode_set((current + 1 == mode_count) ? 0 : current + 1);
+}
+
+// Enter the active mode again, after the data it edits was replaced
+void mode_reload(void)
+{
+    mode_desc_t desc;
+    
+    mode_load(current, &desc);
+    if (desc.on_enter != NULL) {
+        desc.on_enter();
+    }
+    dirty |= MODE_DIRTY_SCREEN;
+}
+
+// Pass a key press to the active mode
+void mode_event(void)
+{
+    mode_desc_t desc;
+    
+    if (get_pressed_button() == 0xFF) {
+        return;
+    }
+    
+    mode_load(current, &desc);
+    if (desc.on_event != NULL) {
+        TRACE_EVENT(TRACE_MODE_BEGIN, current);
+        PROF_BEGIN(PROF_MODE_CLOCK + current);
+        desc.on_event();
+        PROF_END(PROF_MODE_CLOCK + current);
+        TRACE_EVENT(TRACE_MODE_END, current);
+    }
+}
+
+// Mark data as changed (MODE_DIRTY_*)
+void mode_dirty(uint8_t flags)
+{
+    dirty |= flags;
+}
+
+// Whether the active mode shows any of the data in flags
+bool mode_shows(uint8_t flags)
+{
+    return (pgm_read_byte(&mode_table[current].shows) & flags) != 0;
+}
+
+// Redraw the active mode if data it shows changed
+void mode_render(void)
+{
+    mode_desc_t desc;
+    const editor_t* editor = NULL;
+    
+    mode_load(current, &desc);
+    if (!(dirty & (desc.shows | MODE_DIRTY_SCREEN))) {
+        return;
+    }
+    dirty = 0;
+    
+    BENCH_BEGIN(BENCH_DISPLAY);
+    PROF_BEGIN(PROF_DISPLAY);
+    TRACE_EVENT(TRACE_LCD_BEGIN, current);
+    
+    if (desc.render != NULL) {
+        editor = desc.render();
+    }
+    
+    // Ringing banner over the mode title; the second row stays live
+    if (alarm_is_ringing()) {
+        lcd_goto(0, 0);
+        lcd_print("** ALARM **");
+    }
+    
+    // Blinking cursor on the field being edited
+    if (editor != NULL) {
+        editor_show_cursor(editor);
+    } else {
+        editor_hide_cursor();
+    }
+    
+    TRACE_EVENT(TRACE_LCD_END, current);
+    PROF_END(PROF_DISPLAY);
+    BENCH_END(BENCH_DISPLAY);
+}
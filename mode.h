@@ -0,0 +1,56 @@
+#ifndef MODE_H
+#define MODE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "editor.h"
+
+// Display modes. Each mode is a descriptor in mode_table[] (modes.c), in
+// the order MODE steps through them, so a mode is added there without
+// touching the main loop. Its hooks are called by the registry:
+//
+//   on_enter   the mode becomes active, or its data was replaced
+//              (provisioning): load what it edits, start at its first field
+//   on_exit    another mode takes over
+//   on_event   a main loop pass with a key press (button_is_pressed())
+//   render     draw the screen; returns the editor whose cursor is shown
+//
+// Any hook may be NULL. The modes do not redraw on a timer: data sources
+// mark what they changed with mode_dirty(), and mode_render() draws the
+// active mode only when data it shows is dirty.
+
+// Data shown by modes (mode_desc_t.shows)
+#define MODE_DIRTY_TIME         0x01    // Local time and date: rtc_sync(), clock writes, zones
+#define MODE_DIRTY_STOPWATCH    0x02    // Stopwatch time, state or laps
+#define MODE_DIRTY_COUNTDOWN    0x04    // Countdown time left, preset or state
+#define MODE_DIRTY_ALARM        0x08    // Alarm table
+#define MODE_DIRTY_VIEW         0x10    // The mode's own state: edited values, views
+#define MODE_DIRTY_SCREEN       0x80    // LCD cleared or overwritten: any mode redraws
+
+// Mode flags
+#define MODE_NO_RESTORE         0x01    // Never powered up into (editing modes write the RTC)
+
+typedef struct {
+    void (*on_enter)(void);
+    void (*on_exit)(void);
+    void (*on_event)(void);
+    const editor_t* (*render)(void);
+    uint8_t shows;                  // MODE_DIRTY_* flags that redraw the mode
+    uint8_t flags;                  // MODE_* flags
+} mode_desc_t;
+
+// The modes, in flash (modes.c); the first is the power-up default
+extern const mode_desc_t mode_table[];
+extern const uint8_t mode_count;
+
+// Function prototypes
+void mode_restore(bool warm_boot);
+void mode_set(uint8_t mode);
+void mode_next(void);
+void mode_reload(void);
+void mode_event(void);
+void mode_dirty(uint8_t flags);
+bool mode_shows(uint8_t flags);
+void mode_render(void);
+
+#endif // MODE_H 
@@ -0,0 +1,436 @@
+#include <avr/pgmspace.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include "mode.h"
+#include "lcd.h"
+#include "rtc.h"
+#include "buttons.h"
+#include "stopwatch.h"
+#include "countdown.h"
+#include "alarm.h"
+#include "time_utils.h"
+#include "settings.h"
+#include "tz.h"
+#include "editor.h"
+#include "prof.h"
+
+/*
+ * BUTTON ASSIGNMENTS BY MODE:
+ *
+ * CLOCK MODE (M0):
+ * - MODE: Switch to next mode
+ * - SET: No function
+ * - START: No function
+ * - STOP: No function
+ *
+ * TIME SET MODE (M1):
+ * - MODE: Switch to next mode
+ * - SET: Cycle through fields (Hour→Minute→Second→Day→Month→Year)
+ * - START: Increment selected field
+ * - STOP: Decrement selected field
+ *
+ * ALARM SET MODE (M2):
+ * - MODE: Switch to next mode
+ * - SET: Cycle through fields (Slot→Hour→Minute→Days→Repeat→On/Off)
+ * - START: Increment selected field (hour/minute auto-enable the alarm)
+ * - STOP: Decrement selected field (hour/minute auto-enable the alarm)
+ *
+ * STOPWATCH MODE (M3):
+ * - MODE: Switch to next mode
+ * - SET: Lap while running; when stopped, step through the lap views
+ *   (last, best, average, older laps)
+ * - START: Start/Stop stopwatch
+ * - STOP: Reset stopwatch and laps
+ *
+ * COUNTDOWN MODE (M4):
+ * - MODE: Switch to next mode
+ * - SET: Cycle through fields (Minute→Second)
+ * - START: Start/Stop countdown
+ * - STOP: Increment preset (minute or second based on field)
+ *
+ * SETUP MODE (M5):
+ * - MODE: Switch to next mode
+ * - SET: Cycle through fields (Hour→Minute→Second→Day→Month→Year→Zone)
+ * - START: Increment selected field
+ * - STOP: Decrement selected field
+ */
+
+// Local date, time and zone edited in time set and setup mode, loaded
+// from the clock when the mode is entered
+static time_t edit_time = {12, 0, 0};
+static date_t edit_date = {1, 1, 2024};
+static uint8_t edit_zone = TZ_DEFAULT_ZONE;
+
+// Seconds the edits of this time set or setup session moved the clock;
+// logged once when the mode is left
+static int32_t edit_moved = 0;
+static bool edit_written = false;
+
+// Lap view on the first row of stopwatch mode (STOPWATCH_VIEW_*)
+static uint8_t stopwatch_view = STOPWATCH_VIEW_LAST;
+
+// Alarm slot shown in alarm set mode and a working copy of its entry
+static uint8_t alarm_slot = 0;
+static alarm_t alarm_edit;
+
+// Countdown preset split into editable fields
+static uint8_t countdown_edit_minutes = 0;
+static uint8_t countdown_edit_seconds = 0;
+
+// Weekday sets offered by the alarm-set days field
+static const uint8_t alarm_day_presets[] PROGMEM = {
+    ALARM_DAYS_ALL, ALARM_DAYS_WEEKDAYS, ALARM_DAYS_WEEKEND,
+    ALARM_DAY_MON, ALARM_DAY_TUE, ALARM_DAY_WED, ALARM_DAY_THU,
+    ALARM_DAY_FRI, ALARM_DAY_SAT, ALARM_DAY_SUN
+};
+
+// Field tables of the editing modes; positions match the render hooks.
+// Time set edits the first six fields, setup mode adds the zone.
+#define DATETIME_FIELD_ZONE     6
+static const editor_field_t datetime_fields[] PROGMEM = {
+    {&edit_time.hour,   0, 0, 23, EDITOR_NUMBER | EDITOR_WRAP, 1, 0, 2},
+    {&edit_time.minute, 0, 0, 59, EDITOR_NUMBER | EDITOR_WRAP, 1, 3, 2},
+    {&edit_time.second, 0, 0, 59, EDITOR_NUMBER | EDITOR_WRAP, 1, 6, 2},
+    {&edit_date.day, &edit_date, 1, 31, EDITOR_NUMBER | EDITOR_WRAP | EDITOR_DAY, 1, 9, 2},
+    {&edit_date.month,  0, 1, 12, EDITOR_NUMBER | EDITOR_WRAP, 1, 12, 2},
+    {&edit_date.year,   0, 2000, 2099, EDITOR_NUMBER | EDITOR_WRAP | EDITOR_WORD, 0, 5, 4},
+    {&edit_zone,        0, 0, TZ_ZONE_COUNT - 1, EDITOR_NUMBER | EDITOR_WRAP, 0, 0, 0}
+};
+
+#define ALARM_FIELD_SLOT        0
+#define ALARM_FIELD_MINUTE      2
+static const editor_field_t alarm_fields[] PROGMEM = {
+    {&alarm_slot,        0, 0, ALARM_COUNT - 1, EDITOR_NUMBER | EDITOR_WRAP, 0, 6, 0},
+    {&alarm_edit.hour,   0, 0, 23, EDITOR_NUMBER | EDITOR_WRAP, 1, 0, 2},
+    {&alarm_edit.minute, 0, 0, 59, EDITOR_NUMBER | EDITOR_WRAP, 1, 3, 2},
+    {&alarm_edit.days, alarm_day_presets, 0, sizeof(alarm_day_presets), EDITOR_LIST, 1, 6, 0},
+    {&alarm_edit.flags,  0, ALARM_FLAG_REPEAT, 0, EDITOR_TOGGLE, 1, 14, 0},
+    {&alarm_edit.flags,  0, ALARM_FLAG_ENABLED, 0, EDITOR_TOGGLE, 0, 8, 0}
+};
+
+static const editor_field_t countdown_fields[] PROGMEM = {
+    {&countdown_edit_minutes, 0, 0, 99, EDITOR_NUMBER | EDITOR_WRAP, 1, 6, 2},
+    {&countdown_edit_seconds, 0, 0, 59, EDITOR_NUMBER | EDITOR_WRAP, 1, 9, 2}
+};
+
+static editor_t time_set_editor = {datetime_fields, DATETIME_FIELD_ZONE, 0};
+static editor_t setup_editor = {datetime_fields, DATETIME_FIELD_ZONE + 1, 0};
+static editor_t alarm_editor = {alarm_fields, 6, 0};
+static editor_t countdown_editor = {countdown_fields, 2, 0};
+
+// Title and mode number in the top row
+static void mode_title(const char* title, char number)
+{
+    lcd_goto(0, 0);
+    lcd_print(title);
+    lcd_goto(0, 11);
+    lcd_print_char('M');
+    lcd_print_char(number);
+}
+
+// Write a local date and time to the RTC as UTC. The zone cache and the
+// alarm schedule are relative to the clock, so both are refreshed.
+static void set_local_time(date_t* date, time_t* time)
+{
+    edit_moved += rtc_write_epoch(tz_to_utc(epoch_from_datetime(date, time)));
+    edit_written = true;
+    rtc_sync();
+    tz_refresh(rtc_now());
+    alarm_reschedule();
+}
+
+// Time set and setup mode edit the local date and time of the clock
+static void load_datetime(void)
+{
+    epoch_to_datetime(tz_to_local(rtc_now()), &edit_date, &edit_time);
+    edit_zone = tz_get_zone();
+}
+
+// Step a field of the clock as it is now: the other fields, the seconds
+// among them, come from the clock rather than from mode entry. The editor
+// redraws only the stepped field, so the whole view is redrawn.
+static bool datetime_poll(editor_t* editor)
+{
+    if (button_is_pressed(BTN_START) || button_is_pressed(BTN_STOP)) {
+        load_datetime();
+        mode_dirty(MODE_DIRTY_VIEW);
+    }
+    return editor_poll(editor);
+}
+
+// Leaving time set or setup mode logs its clock writes as one change
+static void datetime_exit(void)
+{
+    if (edit_written) {
+        rtc_log_moved(edit_moved);
+        edit_moved = 0;
+        edit_written = false;
+    }
+}
+
+// "Time YYYY  M1" (setup: zone instead of "Time") above "HH:MM:SS DD/MM";
+// the editor draws the digits
+static void render_datetime(const char* title, char number, const editor_t* editor)
+{
+    mode_title(title, number);
+    editor_render(editor);
+    lcd_goto(1, 2);
+    lcd_print_char(':');
+    lcd_goto(1, 5);
+    lcd_print_char(':');
+    lcd_goto(1, 11);
+    lcd_print_char('/');
+}
+
+// Clock mode - the time and date. PROF builds: SET pages through the
+// profiler table, STOP clears it.
+static void clock_mode_event(void)
+{
+    if (prof_page_key(button_is_pressed(BTN_SET), button_is_pressed(BTN_STOP))) {
+        lcd_clear();
+        mode_dirty(MODE_DIRTY_SCREEN);
+    }
+}
+
+static void clock_mode_exit(void)
+{
+    prof_page_close();
+}
+
+static const editor_t* clock_mode_render(void)
+{
+    time_t current_time;
+    date_t current_date;
+    char time_str[16];
+    char date_short[16];
+    
+    if (prof_page_shown()) {
+        prof_page_render();
+        return NULL;
+    }
+    
+    // Current local time and date from the shadow clock
+    epoch_to_datetime(tz_to_local(rtc_now()), &current_date, &current_time);
+    format_time_to_string(&current_time, time_str);
+    format_date_short(&current_date, date_short);
+    
+    mode_title("Clock Mode", '0');
+    lcd_goto(1, 0);
+    lcd_print(time_str);
+    lcd_goto(1, 9);
+    lcd_print(date_short);
+    return NULL;
+}
+
+static void time_set_mode_enter(void)
+{
+    load_datetime();
+    time_set_editor.active = 0;
+}
+
+// SET selects a field, START/STOP step it; each change goes to the RTC
+static void time_set_mode_event(void)
+{
+    if (datetime_poll(&time_set_editor)) {
+        set_local_time(&edit_date, &edit_time);
+    }
+}
+
+static const editor_t* time_set_mode_render(void)
+{
+    render_datetime("Time", '1', &time_set_editor);
+    return &time_set_editor;
+}
+
+static void alarm_set_mode_enter(void)
+{
+    alarm_editor.active = 0;
+}
+
+static void alarm_set_mode_event(void)
+{
+    // Edit a copy of the selected slot; the alarm module owns the table
+    alarm_edit = alarm_get(alarm_slot);
+    
+    if (!editor_poll(&alarm_editor)) {
+        return;
+    }
+    
+    // Days, repeat and on/off are drawn by the render hook
+    mode_dirty(MODE_DIRTY_VIEW);
+    
+    if (alarm_editor.active == ALARM_FIELD_SLOT) {
+        return;
+    }
+    
+    // Setting the hour or minute enables the alarm
+    if (alarm_editor.active <= ALARM_FIELD_MINUTE) {
+        alarm_edit.flags |= ALARM_FLAG_ENABLED;
+    }
+    
+    alarm_store(alarm_slot, &alarm_edit);
+    if (!(alarm_edit.flags & ALARM_FLAG_ENABLED)) {
+        alarm_disable(alarm_slot); // Also cancels a pending snooze
+    }
+    settings_changed();
+}
+
+// "Alarm N ON/OFF" above "HH:MM MTWTFSS R"
+static const editor_t* alarm_set_mode_render(void)
+{
+    lcd_goto(0, 0);
+    lcd_print("Alarm ");
+    lcd_print_char('1' + alarm_slot);
+    lcd_print(alarm_is_enabled(alarm_slot) ? " ON " : " OFF");
+    lcd_goto(0, 11);
+    lcd_print("M2");
+    lcd_goto(1, 0);
+    alarm_display(alarm_slot);
+    return &alarm_editor;
+}
+
+static void stopwatch_mode_event(void)
+{
+    // Times are the key press stamps of the keypad interrupt, not the
+    // moment this pass sees the press; the interrupt also debounces
+    
+    // Handle START button for start/stop
+    if (button_is_pressed(BTN_START)) {
+        if (stopwatch_is_running()) {
+            stopwatch_stop(button_press_time(BTN_START));
+        } else {
+            stopwatch_start(button_press_time(BTN_START));
+        }
+    }
+    
+    // Handle SET button for a lap, or the next lap view when stopped
+    if (button_is_pressed(BTN_SET)) {
+        if (stopwatch_is_running()) {
+            stopwatch_lap(button_press_time(BTN_SET));
+            stopwatch_view = STOPWATCH_VIEW_LAST;
+        } else if (stopwatch_view_count() > 0) {
+            stopwatch_view = (stopwatch_view + 1) % stopwatch_view_count();
+            mode_dirty(MODE_DIRTY_VIEW);
+        }
+    }
+    
+    // Handle STOP button for reset
+    if (button_is_pressed(BTN_STOP)) {
+        stopwatch_reset();
+        stopwatch_view = STOPWATCH_VIEW_LAST;
+    }
+}
+
+// The title until a lap is taken, then the lap view
+static const editor_t* stopwatch_mode_render(void)
+{
+    lcd_goto(0, 0);
+    if (stopwatch_lap_count() == 0) {
+        lcd_print("Stopwatch  M3   ");
+    } else {
+        stopwatch_display_lap(stopwatch_view);
+    }
+    lcd_goto(1, 0);
+    lcd_print("Time: ");
+    stopwatch_display();
+    return NULL;
+}
+
+static void countdown_mode_enter(void)
+{
+    uint16_t preset = countdown_get_preset();
+    
+    countdown_edit_minutes = preset / 60;
+    countdown_edit_seconds = preset % 60;
+    countdown_editor.active = 0;
+}
+
+static void countdown_mode_event(void)
+{
+    // Handle SET button to cycle through the preset fields (minute, second)
+    if (button_is_pressed(BTN_SET)) {
+        editor_next(&countdown_editor);
+    }
+    
+    // Handle START button for start/stop
+    if (button_is_pressed(BTN_START)) {
+        if (countdown_is_running()) {
+            countdown_stop();
+        } else {
+            countdown_start();
+        }
+    }
+    
+    // Handle STOP button to step the selected preset field up
+    if (button_is_pressed(BTN_STOP) && editor_step(&countdown_editor, true)) {
+        countdown_set((uint16_t)countdown_edit_minutes * 60 + countdown_edit_seconds);
+        settings_changed();
+    }
+}
+
+static const editor_t* countdown_mode_render(void)
+{
+    mode_title("Countdown", '4');
+    lcd_goto(1, 0);
+    lcd_print("Time: ");
+    countdown_display();
+    
+    // Only the preset is edited; no cursor over a running countdown
+    return countdown_is_running() ? NULL : &countdown_editor;
+}
+
+static void setup_mode_enter(void)
+{
+    load_datetime();
+    setup_editor.active = 0;
+}
+
+static void setup_mode_event(void)
+{
+    if (!datetime_poll(&setup_editor)) {
+        return;
+    }
+    
+    if (setup_editor.active == DATETIME_FIELD_ZONE) {
+        // Local time and the alarm schedule follow the new zone
+        tz_select(edit_zone);
+        load_datetime();
+        alarm_reschedule();
+        settings_changed();
+        mode_dirty(MODE_DIRTY_VIEW);
+    } else {
+        set_local_time(&edit_date, &edit_time);
+    }
+}
+
+static const editor_t* setup_mode_render(void)
+{
+    char zone_name[6];
+    char title[6];
+    
+    tz_get_name(edit_zone, zone_name);
+    sprintf(title, "%-4s", zone_name);
+    render_datetime(title, '5', &setup_editor);
+    return &setup_editor;
+}
+
+// The modes in MODE order; the index is the saved mode and the number in
+// the title
+const mode_desc_t mode_table[] PROGMEM = {
+    {NULL, clock_mode_exit, clock_mode_event, clock_mode_render,
+     MODE_DIRTY_TIME, 0},
+    {time_set_mode_enter, datetime_exit, time_set_mode_event, time_set_mode_render,
+     MODE_DIRTY_VIEW, MODE_NO_RESTORE},
+    {alarm_set_mode_enter, NULL, alarm_set_mode_event, alarm_set_mode_render,
+     MODE_DIRTY_ALARM | MODE_DIRTY_VIEW, 0},
+    {NULL, NULL, stopwatch_mode_event, stopwatch_mode_render,
+     MODE_DIRTY_STOPWATCH | MODE_DIRTY_VIEW, 0},
+    {countdown_mode_enter, NULL, countdown_mode_event, countdown_mode_render,
+     MODE_DIRTY_COUNTDOWN | MODE_DIRTY_VIEW, 0},
+    {setup_mode_enter, datetime_exit, setup_mode_event, setup_mode_render,
+     MODE_DIRTY_VIEW, MODE_NO_RESTORE}
+};
+
+const uint8_t mode_count = sizeof(mode_table) / sizeof(mode_table[0]);
@@ -0,0 +1,135 @@
+#include <avr/pgmspace.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include "hal.h"
+#include "prof.h"
+#include "lcd.h"
+
+#ifdef PROF
+
+#define CALIBRATION_RUNS    8
+
+uint32_t prof_start[PROF_REGION_COUNT];
+static prof_region_t regions[PROF_REGION_COUNT];
+
+// Overhead from prof_init(): cycles an empty region reads (included in
+// every region) and cycles a BEGIN/END pair adds to the code around it
+static uint16_t overhead_inside = 0;
+static uint16_t overhead_pair = 0;
+
+// Shown page: 0 = clock, 1 = overhead, 2.. = regions
+static uint8_t page = 0;
+
+static const char region_names[PROF_REGION_COUNT][9] PROGMEM = {
+    "lcd_nib", "rtc_i2c", "display",
+    "mode0", "mode1", "mode2", "mode3", "mode4", "mode5",
+    "tick_isr", "eep_isr"
+};
+
+// Start the counter and measure the instrumentation; call with interrupts
+// enabled so the counter keeps its overflows
+void prof_init(void)
+{
+    uint32_t start, empty, pair;
+    uint8_t i;
+    
+    hal_cycles_start();
+    
+    // The fastest of a few runs, an interrupt may hit any of them
+    overhead_inside = UINT16_MAX;
+    overhead_pair = UINT16_MAX;
+    for (i = 0; i < CALIBRATION_RUNS; i++) {
+        // Any region will do, the counters are cleared afterwards
+        start = hal_cycles();
+        empty = hal_cycles() - start;
+        
+        start = hal_cycles();
+        PROF_BEGIN(PROF_LCD_NIBBLE);
+        PROF_END(PROF_LCD_NIBBLE);
+        pair = hal_cycles() - start - empty;
+        
+        if (empty < overhead_inside) overhead_inside = empty;
+        if (pair < overhead_pair) overhead_pair = pair;
+    }
+    
+    prof_clear();
+}
+
+void prof_record(uint8_t id, uint32_t cycles)
+{
+    prof_region_t* region = &regions[id];
+    
+    region->count++;
+    region->total += cycles;
+    if (cycles > region->max) {
+        region->max = cycles;
+    }
+}
+
+void prof_clear(void)
+{
+    uint8_t sreg = hal_irq_save();
+    uint8_t i;
+    
+    for (i = 0; i < PROF_REGION_COUNT; i++) {
+        regions[i].count = 0;
+        regions[i].total = 0;
+        regions[i].max = 0;
+    }
+    hal_irq_restore(sreg);
+}
+
+// Keys of clock mode; returns true when the display must be redrawn
+bool prof_page_key(bool next, bool clear)
+{
+    if (next) {
+        page = (page + 1) % (PROF_REGION_COUNT + 2);
+        return true;
+    }
+    if (clear && page != 0) {
+        prof_clear();
+        return true;
+    }
+    return false;
+}
+
+bool prof_page_shown(void)
+{
+    return page != 0;
+}
+
+void prof_page_close(void)
+{
+    page = 0;
+}
+
+// "name       count" above "total     max"
+void prof_page_render(void)
+{
+    prof_region_t region;
+    char name[9];
+    char line[17];
+    uint8_t sreg;
+    
+    lcd_goto(0, 0);
+    if (page == 1) {
+        lcd_print("Prof overhead");
+        snprintf(line, sizeof(line), "in%4u  pair%4u", overhead_inside, overhead_pair);
+    } else {
+        // ISR regions change under us; take a consistent copy
+        sreg = hal_irq_save();
+        region = regions[page - 2];
+        hal_irq_restore(sreg);
+        
+        memcpy_P(name, region_names[page - 2], sizeof(name));
+        snprintf(line, sizeof(line), "%-8s%8lu", name, (unsigned long)region.count);
+        lcd_print(line);
+        snprintf(line, sizeof(line), "%10lu%6lu",
+                 (unsigned long)region.total, (unsigned long)region.max);
+    }
+    lcd_goto(1, 0);
+    lcd_print(line);
+}
+
+#endif
@@ -0,0 +1,61 @@
+#ifndef PROF_H
+#define PROF_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "hal.h"
+
+// On-target profiler. Built with -DPROF (make PROF=1), PROF_BEGIN/PROF_END
+// read the HAL cycle counter and add the cycles in between to a region:
+// call count, total and worst case. Regions are inclusive, so interrupts
+// taken inside one count towards it. Without PROF everything compiles
+// to nothing.
+//
+// The table is shown on hidden pages of clock mode: SET steps through
+// them (the first one shows the profiler's own overhead), STOP clears the
+// counters and MODE leaves as usual.
+
+// Regions
+#define PROF_LCD_NIBBLE     0   // lcd_write_nibble(), or a PCF8574 transaction
+#define PROF_RTC_I2C        1   // One RTC transaction on the I2C bus
+#define PROF_DISPLAY        2   // mode_render() redraws
+#define PROF_MODE_CLOCK     3   // on_event hooks, PROF_MODE_CLOCK + mode (modes.c)
+#define PROF_TICK_ISR       9   // Timer1 compare ISR
+#define PROF_EEPROM_ISR     10  // EEPROM ready ISR
+#define PROF_REGION_COUNT   11
+
+#ifdef PROF
+
+typedef struct {
+    uint32_t count;
+    uint32_t total;         // Cycles, wraps after 9 minutes of CPU time
+    uint32_t max;
+} prof_region_t;
+
+extern uint32_t prof_start[PROF_REGION_COUNT];
+
+#define PROF_BEGIN(id)      (prof_start[id] = hal_cycles())
+#define PROF_END(id)        prof_record((id), hal_cycles() - prof_start[id])
+
+void prof_init(void);
+void prof_record(uint8_t id, uint32_t cycles);
+void prof_clear(void);
+bool prof_page_key(bool next, bool clear);
+bool prof_page_shown(void);
+void prof_page_render(void);
+void prof_page_close(void);
+
+#else
+
+#define PROF_BEGIN(id)      ((void)0)
+#define PROF_END(id)        ((void)0)
+
+#define prof_init()                 ((void)0)
+#define prof_page_key(next, clear)  false
+#define prof_page_shown()           false
+#define prof_page_render()          ((void)0)
+#define prof_page_close()           ((void)0)
+
+#endif
+
+#endif // PROF_H 
@@ -0,0 +1,311 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "hal.h"
+#include "provision.h"
+#include "uart.h"
+#include "rtc.h"
+#include "alarm.h"
+#include "countdown.h"
+#include "settings.h"
+#include "telemetry.h"
+#include "tz.h"
+#include "timebase.h"
+#include "eventlog.h"
+
+// First second the RTC cannot hold (2100-01-01 00:00:00)
+#define EPOCH_LIMIT         3155760000UL
+// Largest preset the countdown editor offers (99:59)
+#define COUNTDOWN_MAX       (99 * 60 + 59)
+// PROVISION_FRAME_TIMEOUT_MS in Timer1 counts (128 us)
+#define FRAME_TIMEOUT_COUNTS    (PROVISION_FRAME_TIMEOUT_MS * 125U / 16)
+
+// Frame assembly: frame[] holds LEN, CMD, the payload and the CRC
+typedef enum {
+    FRAME_SYNC,
+    FRAME_LENGTH,
+    FRAME_BODY
+} frame_state_t;
+
+static uint8_t frame[PROVISION_PAYLOAD_MAX + 3];
+static uint8_t frame_received = 0;
+static frame_state_t frame_state = FRAME_SYNC;
+
+// Counters, saturating
+static uint16_t frames = 0;
+static uint16_t frame_errors = 0;
+
+static void counter_bump(uint16_t* counter)
+{
+    if (*counter < UINT16_MAX) {
+        (*counter)++;
+    }
+}
+
+// Send a reply frame. Unlike telemetry a reply is never dropped: wait for
+// the transmit ring to drain enough (a few milliseconds at most).
+static void provision_reply(uint8_t command, uint8_t status, const void* data, uint8_t length)
+{
+    uint8_t reply[PROVISION_PAYLOAD_MAX + 4];
+    
+    reply[0] = PROVISION_SYNC;
+    reply[1] = length + 2;
+    reply[2] = command | PROVISION_REPLY;
+    reply[3] = status;
+    if (length > 0) {
+        memcpy(&reply[4], data, length);
+    }
+    reply[length + 4] = settings_crc8(&reply[1], length + 3);
+    
+    while (!uart_write(reply, length + 5)) {
+        hal_delay_ms(1);
+    }
+}
+
+static void provision_capture(provision_snapshot_t* snapshot)
+{
+    // Read the RTC itself rather than the shadow of the last tick
+    rtc_sync();
+    snapshot->epoch = rtc_now();
+    snapshot->zone = tz_get_zone();
+    snapshot->countdown_preset = countdown_get_preset();
+    for (uint8_t i = 0; i < ALARM_COUNT; i++) {
+        snapshot->alarms[i] = alarm_get(i);
+    }
+}
+
+// Check every part a write applies before touching anything
+static bool provision_valid(const provision_write_t* request)
+{
+    const provision_snapshot_t* snapshot = &request->snapshot;
+    
+    if (request->delay_ms >= 1000) {
+        return false;
+    }
+    if ((request->parts & PROVISION_PART_CLOCK) && snapshot->epoch >= EPOCH_LIMIT) {
+        return false;
+    }
+    if ((request->parts & PROVISION_PART_SETTINGS) &&
+        (snapshot->zone >= TZ_ZONE_COUNT || snapshot->countdown_preset > COUNTDOWN_MAX)) {
+        return false;
+    }
+    if (request->parts & PROVISION_PART_ALARMS) {
+        for (uint8_t i = 0; i < ALARM_COUNT; i++) {
+            const alarm_t* alarm = &snapshot->alarms[i];
+            
+            if (alarm->hour > 23 || alarm->minute > 59 || (alarm->days & ~ALARM_DAYS_ALL) ||
+                (alarm->flags & ~(ALARM_FLAG_ENABLED | ALARM_FLAG_REPEAT))) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// Timer1 counts since a time stamp (low 16 bits) less than 8 s ago
+static uint16_t provision_elapsed(uint16_t since)
+{
+    return (uint16_t)timebase_now() - since;
+}
+
+// Write the clock delay_ms after the frame ended. The DS1307 restarts its
+// second when the seconds register is written, so the burst write itself
+// is the alignment. Returns false if that instant had already passed.
+static bool provision_commit_clock(epoch_t epoch, uint16_t delay_ms, uint16_t frame_end)
+{
+    uint16_t target = (uint16_t)((uint32_t)delay_ms * 1000 / HAL_TICK_COUNT_US);
+    uint16_t elapsed = provision_elapsed(frame_end);
+    bool on_time = (elapsed <= target);
+    
+    while (elapsed < target) {
+        hal_delay_us(HAL_TICK_COUNT_US / 2);
+        elapsed = provision_elapsed(frame_end);
+    }
+    rtc_set_epoch(epoch);
+    return on_time;
+}
+
+static uint8_t provision_apply(const provision_write_t* request, uint16_t frame_end)
+{
+    const provision_snapshot_t* snapshot = &request->snapshot;
+    uint8_t status = PROVISION_OK;
+    
+    // The quick parts first, so nothing delays the clock write
+    if (request->parts & PROVISION_PART_SETTINGS) {
+        tz_select(snapshot->zone);
+        countdown_set(snapshot->countdown_preset);
+    }
+    if (request->parts & PROVISION_PART_ALARMS) {
+        for (uint8_t i = 0; i < ALARM_COUNT; i++) {
+            alarm_store(i, &snapshot->alarms[i]);
+            if (!(snapshot->alarms[i].flags & ALARM_FLAG_ENABLED)) {
+                alarm_disable(i); // Also cancels a pending snooze
+            }
+        }
+    }
+    if (request->parts & PROVISION_PART_CLOCK) {
+        if (!provision_commit_clock(snapshot->epoch, request->delay_ms, frame_end)) {
+            status = PROVISION_LATE;
+        }
+        rtc_sync();
+    }
+    
+    // Local time and the alarm schedule follow the new clock and zone
+    tz_refresh(rtc_now());
+    alarm_reschedule();
+    if (request->parts & (PROVISION_PART_ALARMS | PROVISION_PART_SETTINGS)) {
+        settings_changed();
+    }
+    telemetry_event(PSTR("provision"), request->parts);
+    return status;
+}
+
+// Handle a complete frame; true if it changed the clock or settings
+static bool provision_handle(void)
+{
+    uint8_t length = frame[0] - 1;          // Payload bytes
+    uint8_t command = frame[1];
+    provision_snapshot_t snapshot;
+    provision_counters_t counters;
+    provision_write_t request;
+    eventlog_page_t page;
+#ifdef TRACE
+    provision_trace_t trace;
+#endif
+    uint8_t status;
+    
+    if (frame[length + 2] != settings_crc8(frame, length + 2)) {
+        counter_bump(&frame_errors);
+        provision_reply(command, PROVISION_ERR_CRC, NULL, 0);
+        return false;
+    }
+    counter_bump(&frames);
+    
+    switch (command) {
+        case PROVISION_CMD_READ:
+            if (length != 0) {
+                break;
+            }
+            provision_capture(&snapshot);
+            provision_reply(command, PROVISION_OK, &snapshot, sizeof(snapshot));
+            return false;
+        
+        case PROVISION_CMD_COUNTERS:
+            if (length != 0) {
+                break;
+            }
+            counters.frames = frames;
+            counters.frame_errors = frame_errors;
+            counters.uart_overruns = uart_rx_overruns();
+            counters.telemetry_dropped = telemetry_dropped();
+            counters.rtc_read_errors = rtc_read_errors();
+            counters.stack_used = hal_stack_used();
+            counters.log_dropped = eventlog_dropped();
+            counters.log_errors = eventlog_errors();
+            provision_reply(command, PROVISION_OK, &counters, sizeof(counters));
+            return false;
+        
+        case PROVISION_CMD_LOG:
+            if (length != 1) {
+                break;
+            }
+            status = eventlog_read_page(frame[2], &page);
+            if (status == EVENTLOG_PAGE_BUSY) {
+                provision_reply(command, PROVISION_ERR_BUSY, NULL, 0);
+                return false;
+            }
+            if (status != EVENTLOG_PAGE_OK) {
+                provision_reply(command, PROVISION_ERR_VALUE, NULL, 0);
+                return false;
+            }
+            provision_reply(command, PROVISION_OK, &page, PROVISION_LOG_LENGTH);
+            return false;
+        
+        case PROVISION_CMD_I2C:
+            if (length != 0) {
+                break;
+            }
+            provision_reply(command, PROVISION_OK, i2c_counters(), PROVISION_I2C_LENGTH);
+            return false;
+            
+#ifdef TRACE
+        case PROVISION_CMD_TRACE:
+            if (length != 0) {
+                break;
+            }
+            trace.lost = trace_lost_count();
+            trace.count = trace_take(trace.records, PROVISION_TRACE_RECORDS);
+            provision_reply(command, PROVISION_OK, &trace,
+                            sizeof(trace) - sizeof(trace.records) +
+                            trace.count * sizeof(trace_record_t));
+            return false;
+#endif
+            
+        case PROVISION_CMD_WRITE:
+            if (length != sizeof(request)) {
+                break;
+            }
+            memcpy(&request, &frame[2], sizeof(request));
+            if (!provision_valid(&request)) {
+                provision_reply(command, PROVISION_ERR_VALUE, NULL, 0);
+                return false;
+            }
+            status = provision_apply(&request, uart_rx_time());
+            provision_reply(command, status, NULL, 0);
+            return true;
+        
+        default:
+            provision_reply(command, PROVISION_ERR_COMMAND, NULL, 0);
+            return false;
+    }
+    
+    provision_reply(command, PROVISION_ERR_LENGTH, NULL, 0);
+    return false;
+}
+
+// Take the received bytes and handle complete frames (main loop, every
+// pass). Returns true if a frame changed the clock or the settings.
+bool provision_poll(void)
+{
+    bool changed = false;
+    uint8_t data;
+    
+    while (uart_read(&data)) {
+        switch (frame_state) {
+            case FRAME_SYNC:
+                if (data == PROVISION_SYNC) {
+                    frame_state = FRAME_LENGTH;
+                }
+                break;
+            
+            case FRAME_LENGTH:
+                if (data == 0 || data > PROVISION_PAYLOAD_MAX + 1) {
+                    counter_bump(&frame_errors);
+                    frame_state = FRAME_SYNC;
+                    break;
+                }
+                frame[0] = data;
+                frame_received = 1;
+                frame_state = FRAME_BODY;
+                break;
+            
+            case FRAME_BODY:
+                frame[frame_received++] = data;
+                if (frame_received == frame[0] + 2) {
+                    frame_state = FRAME_SYNC;
+                    changed |= provision_handle();
+                }
+                break;
+        }
+    }
+    
+    // A frame whose next byte is overdue lost bytes. The stamps are the
+    // low 16 bits of timebase_now(), which wrap after 8.4 s, far longer
+    // than a loop pass.
+    if (frame_state != FRAME_SYNC &&
+        (uint16_t)((uint16_t)timebase_now() - uart_rx_time()) > FRAME_TIMEOUT_COUNTS) {
+        counter_bump(&frame_errors);
+        frame_state = FRAME_SYNC;
+    }
+    return changed;
+}
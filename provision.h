@@ -0,0 +1,101 @@
+#ifndef PROVISION_H
+#define PROVISION_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "alarm.h"
+#include "trace.h"
+#include "eventlog.h"
+#include "i2c_bus.h"
+
+// Provisioning protocol on the UART console. A frame is
+//
+//     SYNC  LEN  CMD  payload (LEN - 1 bytes)  CRC
+//
+// with the CRC-8 of settings_crc8() over LEN, CMD and the payload.
+// Multi-byte values are little-endian. Every command is answered with a
+// frame whose CMD has PROVISION_REPLY set and whose payload starts with a
+// PROVISION_* status byte. A frame is handled once complete; a partial
+// frame that stops arriving for PROVISION_FRAME_TIMEOUT_MS is dropped.
+
+#define PROVISION_SYNC              0xA5
+#define PROVISION_PAYLOAD_MAX       32
+#define PROVISION_REPLY             0x80
+
+// A frame takes 10 ms at 38400 baud; USB serial adapters may pass it on
+// in pieces a few milliseconds apart
+#define PROVISION_FRAME_TIMEOUT_MS  50
+
+// Commands
+#define PROVISION_CMD_READ          0x01    // -> status, snapshot
+#define PROVISION_CMD_WRITE         0x02    // write request -> status
+#define PROVISION_CMD_COUNTERS      0x03    // -> status, counters
+#define PROVISION_CMD_TRACE         0x04    // -> status, trace records (TRACE builds)
+#define PROVISION_CMD_LOG           0x05    // pages back -> status, event log page
+#define PROVISION_CMD_I2C           0x06    // -> status, I2C counters per device
+
+// Reply status
+#define PROVISION_OK                0
+#define PROVISION_ERR_CRC           1
+#define PROVISION_ERR_COMMAND       2
+#define PROVISION_ERR_LENGTH        3
+#define PROVISION_ERR_VALUE         4
+#define PROVISION_LATE              5       // Written, but after the requested instant
+#define PROVISION_ERR_BUSY          6       // Event log EEPROM in a write cycle: try again
+
+// Parts of the snapshot a write applies
+#define PROVISION_PART_CLOCK        0x01
+#define PROVISION_PART_ALARMS       0x02
+#define PROVISION_PART_SETTINGS     0x04    // Time zone and countdown preset
+
+// Everything a unit is provisioned with
+typedef struct {
+    uint32_t epoch;                 // UTC, seconds since 2000-01-01
+    uint8_t zone;                   // Time zone table index
+    uint16_t countdown_preset;      // Seconds
+    alarm_t alarms[ALARM_COUNT];
+} __attribute__((packed)) provision_snapshot_t;
+
+// Write request. The clock is written in one burst delay_ms after the
+// last byte of the frame arrived (at most one second later), so that the
+// RTC's second starts at the instant the host asked for.
+typedef struct {
+    uint8_t parts;                  // PROVISION_PART_* bits
+    uint16_t delay_ms;
+    provision_snapshot_t snapshot;
+} __attribute__((packed)) provision_write_t;
+
+// Firmware counters since boot
+typedef struct {
+    uint16_t frames;                // Commands handled
+    uint16_t frame_errors;          // Frames dropped: bad CRC, length or timeout
+    uint16_t uart_overruns;         // Bytes lost to a full receive ring
+    uint16_t telemetry_dropped;     // Console lines lost to a full transmit ring
+    uint16_t rtc_read_errors;       // Impossible dates read from the RTC
+    uint16_t stack_used;            // Stack high-water mark in bytes (0 on the host)
+    uint16_t log_dropped;           // Events lost to a full staging ring
+    uint16_t log_errors;            // Event log page transfers that failed
+} __attribute__((packed)) provision_counters_t;
+
+// Oldest trace records, taken out of the ring (trace.h)
+#define PROVISION_TRACE_RECORDS     5
+typedef struct {
+    uint16_t lost;                  // Records dropped on a full ring since boot
+    uint8_t count;
+    trace_record_t records[PROVISION_TRACE_RECORDS];   // count of them sent
+} __attribute__((packed)) provision_trace_t;
+
+// Event log page (eventlog.h) without its CRC: the payload takes one byte,
+// how many pages before the newest (0, the newest, includes records not
+// yet written). Past the oldest page the status is PROVISION_ERR_VALUE,
+// during the EEPROM's write cycle PROVISION_ERR_BUSY.
+#define PROVISION_LOG_LENGTH        (sizeof(eventlog_page_t) - 1)
+
+// I2C health: the I2C_DEVICES slots of i2c_counters_t (i2c_bus.h), in the
+// order the devices were first used; unused slots have address 0
+#define PROVISION_I2C_LENGTH        (I2C_DEVICES * sizeof(i2c_counters_t))
+
+// Function prototypes
+bool provision_poll(void);
+
+#endif // PROVISION_H 
@@ -0,0 +1,50 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include "pt.h"
+#include "timebase.h"
+
+// Events posted in this pass of the main loop
+static uint8_t posted = 0;
+
+// A thread waits on PT_AWAIT_MS(): the loop must not idle past its end
+static bool timers_pending = false;
+
+// Start of a main loop pass: events and timers are counted afresh
+void pt_pass_begin(void)
+{
+    posted = 0;
+    timers_pending = false;
+}
+
+void pt_post(uint8_t events)
+{
+    posted |= events;
+}
+
+// Whether any of the events was posted in this pass
+bool pt_posted(uint8_t events)
+{
+    return (posted & events) != 0;
+}
+
+// Whether ms milliseconds have passed since the thread's wait started
+bool pt_elapsed(const pt_t* pt, uint16_t ms)
+{
+    return timebase_to_ms(timebase_now() - pt->start) >= ms;
+}
+
+// pt_elapsed() for PT_AWAIT_MS(), noting a wait still running
+bool pt_timer_expired(const pt_t* pt, uint16_t ms)
+{
+    if (pt_elapsed(pt, ms)) {
+        return true;
+    }
+    timers_pending = true;
+    return false;
+}
+
+// Whether a thread waits on a timer in this pass
+bool pt_timers_pending(void)
+{
+    return timers_pending;
+}
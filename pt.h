@@ -0,0 +1,82 @@
+#ifndef PT_H
+#define PT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "i2c_bus.h"
+#include "timebase.h"
+
+// Protothreads: sequences that wait (a splash, a beep, a page write
+// cycle) written as straight-line code that returns to the main loop at
+// each wait instead of blocking it. A thread is a function
+//
+//     static bool thread(pt_t* pt)
+//     {
+//         PT_BEGIN(pt);
+//         ...
+//         PT_AWAIT_MS(pt, 1000);
+//         ...
+//         PT_END(pt);
+//     }
+//
+// called once per main loop pass; it returns true while it runs and false
+// once it has ended. A wait stores the line it stopped at in pt->lc and
+// PT_BEGIN() is a switch on it that resumes there, so a thread costs the
+// six bytes of its pt_t. Hence one wait per source line, no waits inside
+// a switch of the thread's own, and local variables do not survive a wait
+// (keep what is needed across one in statics).
+
+typedef struct {
+    uint16_t lc;            // Line to resume at: 0 to start, PT_DONE once ended
+    uint32_t start;         // Time stamp of the timed wait (timebase_now())
+} pt_t;
+
+#define PT_DONE             0xFFFF
+
+// Events of the current main loop pass (pt_post())
+#define PT_EVENT_TICK       0x01    // The 1 Hz tick
+#define PT_EVENT_KEY        0x02    // A key press
+
+// A zeroed pt_t starts its thread at the top; PT_STOP() ends it from outside
+#define PT_INIT(pt)         ((pt)->lc = 0)
+#define PT_STOP(pt)         ((pt)->lc = PT_DONE)
+#define PT_RUNNING(pt)      ((pt)->lc != PT_DONE)
+
+#define PT_BEGIN(pt)        switch ((pt)->lc) { case 0:
+#define PT_END(pt)          default: ; } (pt)->lc = PT_DONE; return false
+
+// Return to the main loop until condition holds (checked now and on
+// every later call)
+#define PT_WAIT_UNTIL(pt, condition) \
+    do { (pt)->lc = __LINE__; if (0) { case __LINE__: ; } if (!(condition)) return true; } while (0)
+
+// Return to the main loop once
+#define PT_YIELD(pt) \
+    do { (pt)->lc = __LINE__; return true; case __LINE__: ; } while (0)
+
+#define PT_EXIT(pt) \
+    do { (pt)->lc = PT_DONE; return false; } while (0)
+
+// Wait ms milliseconds; the main loop polls instead of idling meanwhile
+#define PT_AWAIT_MS(pt, ms) \
+    do { (pt)->start = timebase_now(); PT_WAIT_UNTIL(pt, pt_timer_expired(pt, ms)); } while (0)
+
+// Wait for a later pass with any of the PT_EVENT_* events
+#define PT_AWAIT_EVENT(pt, events) \
+    do { (pt)->lc = __LINE__; return true; case __LINE__: if (!pt_posted(events)) return true; } while (0)
+
+// Wait up to ms milliseconds for an I2C device to answer its address (an
+// EEPROM in its write cycle does not); ready tells which ended the wait
+#define PT_AWAIT_I2C(pt, address, ms, ready) \
+    do { (pt)->start = timebase_now(); \
+         PT_WAIT_UNTIL(pt, ((ready) = i2c_probe(address)) || pt_elapsed(pt, ms)); } while (0)
+
+// Function prototypes
+void pt_pass_begin(void);
+void pt_post(uint8_t events);
+bool pt_posted(uint8_t events);
+bool pt_elapsed(const pt_t* pt, uint16_t ms);
+bool pt_timer_expired(const pt_t* pt, uint16_t ms);
+bool pt_timers_pending(void);
+
+#endif // PT_H 
@@ -1,180 +1,266 @@
-#include <avr/io.h>
-#include <util/delay.h>
+#include <avr/pgmspace.h>
 #include <stdint.h>
 #include <stdbool.h>
+#include <stddef.h>
+#include "hal.h"
 #include "rtc.h"
+#include "rtc_driver.h"
+#include "i2c_bus.h"
+#include "time_utils.h"
+#include "bench.h"
+#include "prof.h"
+#include "telemetry.h"
+#include "trace.h"
+#include "eventlog.h"
+#include "mode.h"
 
-// I2C pin definitions (for ATmega32)
-#define I2C_SDA_PIN        PC1
-#define I2C_SCL_PIN        PC0
+// Shadow copy of the RTC time, refreshed by rtc_sync()
+static epoch_t shadow_epoch = 0;
 
-// I2C functions
-void rtc_i2c_start(void)
+// Reads that failed or returned an impossible date or time
+static uint16_t read_errors = 0;
+
+// Writes of the clock registers, each of which restarts the RTC's second
+static uint8_t clock_writes = 0;
+
+// Backends in the order they are tried. The DS3231 comes before the
+// DS1307: both answer at the same address, and only the DS3231's attach()
+// tells them apart.
+static const rtc_driver_t* const drivers[] PROGMEM = {
+    &rtc_ds3231_driver,
+    &rtc_ds1307_driver,
+    &rtc_pcf8563_driver,
+    &rtc_soft_driver
+};
+#define DRIVER_COUNT        (sizeof(drivers) / sizeof(drivers[0]))
+
+// Copy of the backend found by rtc_init()
+static rtc_driver_t driver;
+
+// RTC initialization: find the chip
+void rtc_init(bool power_on)
 {
-    // Set SDA and SCL high
-    PORTC |= (1 << I2C_SDA_PIN) | (1 << I2C_SCL_PIN);
-    DDRC |= (1 << I2C_SDA_PIN) | (1 << I2C_SCL_PIN);
+    // Configure I2C pins
+    hal_i2c_init();
     
-    // Start condition: SDA goes low while SCL is high
-    PORTC &= ~(1 << I2C_SDA_PIN);
-    _delay_us(5);
-    PORTC &= ~(1 << I2C_SCL_PIN);
+    // The RTC kept running on its own supply through a warm reset
+    if (power_on) {
+        hal_delay_ms(RTC_STARTUP_DELAY_MS); // Wait for RTC to stabilize
+    }
+    
+    // The software clock always attaches
+    for (uint8_t i = 0; i < DRIVER_COUNT; i++) {
+        memcpy_P(&driver, pgm_read_ptr(&drivers[i]), sizeof(driver));
+        if (driver.attach(power_on)) {
+            break;
+        }
+    }
+}
+
+// Chip in use (RTC_CHIP_*)
+uint8_t rtc_chip(void)
+{
+    return driver.chip;
+}
+
+// What the chip in use offers (RTC_CAP_*)
+uint8_t rtc_caps(void)
+{
+    return driver.caps;
 }
 
-void rtc_i2c_stop(void)
+// Whether a chip acknowledges its address
+bool rtc_i2c_probe(uint8_t address)
 {
-    // Set SDA low
-    PORTC &= ~(1 << I2C_SDA_PIN);
-    DDRC |= (1 << I2C_SDA_PIN);
+    return i2c_probe(address);
+}
+
+// Read consecutive registers in one transaction (register pointer auto-increments)
+bool rtc_i2c_read(uint8_t address, uint8_t reg, uint8_t* data, uint8_t length)
+{
+    bool ok;
+    
+    if (length == 0) return true;
+    
+    PROF_BEGIN(PROF_RTC_I2C);
+    TRACE_EVENT(TRACE_RTC_BEGIN, reg);
+    ok = i2c_read(address, &reg, 1, data, length);
+    TRACE_EVENT(TRACE_RTC_END, reg);
+    PROF_END(PROF_RTC_I2C);
     
-    // Stop condition: SDA goes high while SCL is high
-    PORTC |= (1 << I2C_SCL_PIN);
-    _delay_us(5);
-    PORTC |= (1 << I2C_SDA_PIN);
-    _delay_us(5);
+    return ok;
 }
 
-void rtc_i2c_write(uint8_t data)
+// Write consecutive registers in one transaction
+bool rtc_i2c_write(uint8_t address, uint8_t reg, const uint8_t* data, uint8_t length)
 {
-    uint8_t i;
+    bool ok;
     
-    for (i = 0; i < 8; i++) {
-        // Set SCL low
-        PORTC &= ~(1 << I2C_SCL_PIN);
-        
-        // Set SDA according to bit
-        if (data & 0x80) {
-            PORTC |= (1 << I2C_SDA_PIN);
-        } else {
-            PORTC &= ~(1 << I2C_SDA_PIN);
-        }
-        
-        // Set SCL high
-        PORTC |= (1 << I2C_SCL_PIN);
-        _delay_us(5);
-        
-        // Set SCL low
-        PORTC &= ~(1 << I2C_SCL_PIN);
-        
-        data <<= 1;
-    }
+    PROF_BEGIN(PROF_RTC_I2C);
+    TRACE_EVENT(TRACE_RTC_BEGIN, reg);
+    ok = i2c_write(address, &reg, 1, data, length);
+    TRACE_EVENT(TRACE_RTC_END, reg);
+    PROF_END(PROF_RTC_I2C);
     
-    // Read ACK
-    PORTC &= ~(1 << I2C_SCL_PIN);
-    DDRC &= ~(1 << I2C_SDA_PIN); // Set SDA as input
-    PORTC |= (1 << I2C_SCL_PIN);
-    _delay_us(5);
-    PORTC &= ~(1 << I2C_SCL_PIN);
-    DDRC |= (1 << I2C_SDA_PIN); // Set SDA as output
-}
-
-uint8_t rtc_i2c_read(bool ack)
-{
-    uint8_t data = 0;
-    uint8_t i;
-    
-    DDRC &= ~(1 << I2C_SDA_PIN); // Set SDA as input
-    
-    for (i = 0; i < 8; i++) {
-        // Set SCL low
-        PORTC &= ~(1 << I2C_SCL_PIN);
-        _delay_us(5);
-        
-        // Set SCL high
-        PORTC |= (1 << I2C_SCL_PIN);
-        _delay_us(5);
-        
-        // Read bit
-        data <<= 1;
-        if (PINC & (1 << I2C_SDA_PIN)) {
-            data |= 1;
-        }
-        
-        // Set SCL low
-        PORTC &= ~(1 << I2C_SCL_PIN);
-    }
+    return ok;
+}
+
+// Get current time from RTC
+void rtc_get_time(time_t* time)
+{
+    date_t date;
     
-    // Send ACK/NACK
-    DDRC |= (1 << I2C_SDA_PIN); // Set SDA as output
-    if (ack) {
-        PORTC &= ~(1 << I2C_SDA_PIN); // ACK
-    } else {
-        PORTC |= (1 << I2C_SDA_PIN); // NACK
-    }
+    rtc_get_datetime(time, &date);
+}
+
+// Set time in RTC, keeping the date
+void rtc_set_time(time_t* time)
+{
+    uint32_t since_midnight;
     
-    PORTC |= (1 << I2C_SCL_PIN);
-    _delay_us(5);
-    PORTC &= ~(1 << I2C_SCL_PIN);
+    epoch_days(shadow_epoch, &since_midnight);
+    rtc_set_epoch(shadow_epoch - since_midnight + time->hour * EPOCH_SECONDS_PER_HOUR +
+                  time->minute * EPOCH_SECONDS_PER_MINUTE + time->second);
+}
+
+// Get current date from RTC
+void rtc_get_date(date_t* date)
+{
+    time_t time;
     
-    return data;
+    rtc_get_datetime(&time, date);
 }
 
-// RTC initialization
-void rtc_init(void)
+// Set date in RTC, keeping the time (the weekday follows)
+void rtc_set_date(date_t* date)
 {
-    // Configure I2C pins
-    DDRC |= (1 << I2C_SDA_PIN) | (1 << I2C_SCL_PIN);
-    PORTC |= (1 << I2C_SDA_PIN) | (1 << I2C_SCL_PIN);
+    time_t time;
+    date_t old_date;
+    
+    epoch_to_datetime(shadow_epoch, &old_date, &time);
+    rtc_set_epoch(epoch_from_datetime(date, &time));
+}
+
+// Get weekday from RTC (0=Monday..6=Sunday)
+uint8_t rtc_get_weekday(void)
+{
+    date_t date;
     
-    _delay_ms(100); // Wait for RTC to stabilize
+    rtc_get_date(&date);
+    return day_of_week(date.day, date.month, date.year);
 }
 
-// Write to RTC register
-void rtc_write_register(uint8_t reg, uint8_t data)
+// Get time and date in one read so they cannot straddle a rollover;
+// false if the chip did not answer
+bool rtc_get_datetime(time_t* time, date_t* date)
 {
-    rtc_i2c_start();
-    rtc_i2c_write(RTC_I2C_ADDRESS << 1); // Write address
-    rtc_i2c_write(reg); // Register address
-    rtc_i2c_write(data); // Data
-    rtc_i2c_stop();
+    return driver.read(time, date);
 }
 
-// Read from RTC register
-uint8_t rtc_read_register(uint8_t reg)
+// Refresh the shadow clock from the RTC (one read, call once per tick)
+void rtc_sync(void)
 {
-    uint8_t data;
+    time_t current_time = {0};
+    date_t current_date = {0};
+    bool answered;
+    epoch_t epoch;
     
-    rtc_i2c_start();
-    rtc_i2c_write(RTC_I2C_ADDRESS << 1); // Write address
-    rtc_i2c_write(reg); // Register address
-    rtc_i2c_start();
-    rtc_i2c_write((RTC_I2C_ADDRESS << 1) | 1); // Read address
-    data = rtc_i2c_read(false); // Read data, no ACK
-    rtc_i2c_stop();
+    BENCH_BEGIN(BENCH_RTC_SYNC);
+    answered = rtc_get_datetime(&current_time, &current_date);
+    TRACE_EVENT(TRACE_RTC_SECOND, current_time.second);
     
-    return data;
+    // A missing or corrupted transfer keeps the last good time and is reported
+    if (answered && rtc_is_valid_time(&current_time) && rtc_is_valid_date(&current_date)) {
+        epoch = epoch_from_datetime(&current_date, &current_time);
+        if (epoch != shadow_epoch) {
+            shadow_epoch = epoch;
+            mode_dirty(MODE_DIRTY_TIME);
+        }
+    } else {
+        if (read_errors < UINT16_MAX) {
+            read_errors++;
+        }
+        telemetry_event(PSTR("i2c_err"), read_errors);
+        eventlog_record(EVENTLOG_I2C_ERROR, read_errors);
+    }
+    BENCH_END(BENCH_RTC_SYNC);
 }
 
-// Get current time from RTC
-void rtc_get_time(time_t* time)
+// Number of rtc_sync() reads rejected since boot
+uint16_t rtc_read_errors(void)
 {
-    time->second = bcd_to_bin(rtc_read_register(RTC_SECONDS) & 0x7F);
-    time->minute = bcd_to_bin(rtc_read_register(RTC_MINUTES) & 0x7F);
-    time->hour = bcd_to_bin(rtc_read_register(RTC_HOURS) & 0x3F);
+    return read_errors;
 }
 
-// Set time in RTC
-void rtc_set_time(time_t* time)
+// Current time from the shadow clock, no I2C traffic
+epoch_t rtc_now(void)
 {
-    rtc_write_register(RTC_SECONDS, bin_to_bcd(time->second));
-    rtc_write_register(RTC_MINUTES, bin_to_bcd(time->minute));
-    rtc_write_register(RTC_HOURS, bin_to_bcd(time->hour));
+    return shadow_epoch;
 }
 
-// Get current date from RTC
-void rtc_get_date(date_t* date)
+// Set time, date and weekday in one write, without logging it; returns
+// the seconds the clock moved
+int32_t rtc_write_epoch(epoch_t epoch)
 {
-    date->day = bcd_to_bin(rtc_read_register(RTC_DATE) & 0x3F);
-    date->month = bcd_to_bin(rtc_read_register(RTC_MONTH) & 0x1F);
-    date->year = 2000 + bcd_to_bin(rtc_read_register(RTC_YEAR));
+    int32_t moved = (int32_t)(epoch - shadow_epoch);
+    
+    driver.write(epoch);
+    shadow_epoch = epoch;
+    clock_writes++;
+    mode_dirty(MODE_DIRTY_TIME);
+    return moved;
 }
 
-// Set date in RTC
-void rtc_set_date(date_t* date)
+// Log a clock change, with the time it was set to
+void rtc_log_moved(int32_t moved)
+{
+    moved = (moved > INT16_MAX) ? INT16_MAX : (moved < INT16_MIN) ? INT16_MIN : moved;
+    eventlog_record(EVENTLOG_TIME_CHANGED, (uint16_t)moved);
+}
+
+// Set time, date and weekday in one write and log the change
+void rtc_set_epoch(epoch_t epoch)
+{
+    rtc_log_moved(rtc_write_epoch(epoch));
+}
+
+// Clock writes since boot (wraps); a measurement against the RTC's
+// seconds that sees this change has lost its reference
+uint8_t rtc_clock_writes(void)
 {
-    rtc_write_register(RTC_DATE, bin_to_bcd(date->day));
-    rtc_write_register(RTC_MONTH, bin_to_bcd(date->month));
-    rtc_write_register(RTC_YEAR, bin_to_bcd(date->year - 2000));
+    return clock_writes;
+}
+
+// The seconds register alone (0-59), for timing against the chip's
+// rollover; RTC_NO_SECOND without one or if the read failed
+uint8_t rtc_read_second(void)
+{
+    if (driver.read_second == NULL) {
+        return RTC_NO_SECOND;
+    }
+    return driver.read_second();
+}
+
+// Read from battery-backed RAM; returns false if out of range, unsupported
+// or the chip did not answer
+bool rtc_read_nvram(uint8_t offset, void* data, uint8_t length)
+{
+    if (driver.read_nvram == NULL || offset + length > RTC_NVRAM_SIZE) {
+        return false;
+    }
+    
+    return driver.read_nvram(offset, data, length);
+}
+
+// Write to battery-backed RAM in one burst; returns false if out of range,
+// unsupported or the chip did not answer
+bool rtc_write_nvram(uint8_t offset, const void* data, uint8_t length)
+{
+    if (driver.write_nvram == NULL || offset + length > RTC_NVRAM_SIZE) {
+        return false;
+    }
+    
+    return driver.write_nvram(offset, data, length);
 }
 
 // Validate time
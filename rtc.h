@@ -4,18 +4,39 @@
 #include <stdint.h>
 #include <stdbool.h>
 
-// RTC I2C Address (DS1307/DS3231)
-#define RTC_I2C_ADDRESS      0x68
-
-// RTC Register Addresses
-#define RTC_SECONDS          0x00
-#define RTC_MINUTES          0x01
-#define RTC_HOURS            0x02
-#define RTC_DAY              0x03
-#define RTC_DATE             0x04
-#define RTC_MONTH            0x05
-#define RTC_YEAR             0x06
-#define RTC_CONTROL          0x07
+// The clock runs on whichever chip rtc_init() finds on the bus, one
+// backend per chip (rtc_driver.h), or on the MCU's own tick when none
+// answers. Callers that need more than the time check rtc_caps().
+
+// I2C addresses of the supported chips
+#define RTC_DS1307_ADDRESS   0x68 // DS1307 and DS3231
+#define RTC_PCF8563_ADDRESS  0x51
+
+// Settling time after a power-on reset before the RTC is accessed
+#define RTC_STARTUP_DELAY_MS 100
+
+// Chip found by rtc_init() (rtc_chip())
+#define RTC_CHIP_SOFT        0    // None answered: software clock on the tick
+#define RTC_CHIP_DS1307      1
+#define RTC_CHIP_DS3231      2
+#define RTC_CHIP_PCF8563     3
+
+// What the chip offers (rtc_caps())
+#define RTC_CAP_BURST        0x01 // Time and date in one transfer
+#define RTC_CAP_ALARM        0x02 // Alarm registers
+#define RTC_CAP_SQW          0x04 // Square wave output
+#define RTC_CAP_NVRAM        0x08 // Battery-backed RAM (rtc_read_nvram())
+#define RTC_CAP_TEMP         0x10 // Temperature sensor
+#define RTC_CAP_CLOCK        0x20 // Own oscillator: a reference for calib.c
+
+// Battery-backed RAM (DS1307 only)
+#define RTC_NVRAM_SIZE       56
+
+// The software clock starts here after a power cycle (2024-01-01 00:00:00)
+#define RTC_SOFT_START_EPOCH 757382400UL
+
+// rtc_read_second() without a seconds register or after a bus error
+#define RTC_NO_SECOND        0xFF
 
 // Time structure
 typedef struct {
@@ -31,23 +52,38 @@ typedef struct {
     uint16_t year;
 } date_t;
 
+// Seconds since 2000-01-01 00:00:00 (see time_utils.h)
+typedef uint32_t epoch_t;
+
+#define EPOCH_SECONDS_PER_MINUTE    60
+#define EPOCH_SECONDS_PER_HOUR      3600UL
+#define EPOCH_SECONDS_PER_DAY       86400UL
+
 // Function prototypes
-void rtc_init(void);
+void rtc_init(bool power_on);
+uint8_t rtc_chip(void);
+uint8_t rtc_caps(void);
 void rtc_get_time(time_t* time);
 void rtc_set_time(time_t* time);
 void rtc_get_date(date_t* date);
 void rtc_set_date(date_t* date);
+uint8_t rtc_get_weekday(void);
+bool rtc_get_datetime(time_t* time, date_t* date);
+
+// Shadow clock: epoch cached from one burst read per tick
+void rtc_sync(void);
+epoch_t rtc_now(void);
+uint16_t rtc_read_errors(void);
+void rtc_set_epoch(epoch_t epoch);
+int32_t rtc_write_epoch(epoch_t epoch);
+void rtc_log_moved(int32_t moved);
+uint8_t rtc_clock_writes(void);
+uint8_t rtc_read_second(void);
+bool rtc_read_nvram(uint8_t offset, void* data, uint8_t length);
+bool rtc_write_nvram(uint8_t offset, const void* data, uint8_t length);
 bool rtc_is_valid_time(time_t* time);
 bool rtc_is_valid_date(date_t* date);
 
-// I2C functions for RTC communication
-void rtc_i2c_start(void);
-void rtc_i2c_stop(void);
-void rtc_i2c_write(uint8_t data);
-uint8_t rtc_i2c_read(bool ack);
-void rtc_write_register(uint8_t reg, uint8_t data);
-uint8_t rtc_read_register(uint8_t reg);
-
 // BCD conversion functions
 uint8_t bcd_to_bin(uint8_t bcd);
 uint8_t bin_to_bcd(uint8_t bin);
@@ -0,0 +1,48 @@
+#ifndef RTC_DRIVER_H
+#define RTC_DRIVER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "rtc.h"
+
+// RTC backends, one per chip, behind the generic layer of rtc.c (shadow
+// clock, validation, error counting). rtc_init() tries them in the order
+// of its table and keeps the first whose attach() finds its chip; the
+// software clock (rtc_soft.c) always attaches, so it comes last. Hooks:
+//
+//   attach         find the chip and get it running; false if it is not there
+//   read           time and date; false if the chip did not answer
+//   write          set time, date and weekday
+//   read_second    the bare seconds register, RTC_NO_SECOND on an error
+//   read_nvram,    battery-backed RAM; offsets are checked by rtc.c
+//   write_nvram
+//
+// A hook the chip has no use for is NULL, matching the caps it advertises.
+
+typedef struct {
+    uint8_t chip;                   // RTC_CHIP_*
+    uint8_t caps;                   // RTC_CAP_*
+    bool (*attach)(bool power_on);
+    bool (*read)(time_t* time, date_t* date);
+    void (*write)(epoch_t epoch);
+    uint8_t (*read_second)(void);
+    bool (*read_nvram)(uint8_t offset, void* data, uint8_t length);
+    bool (*write_nvram)(uint8_t offset, const void* data, uint8_t length);
+} rtc_driver_t;
+
+// The backends, in flash
+extern const rtc_driver_t rtc_ds3231_driver;
+extern const rtc_driver_t rtc_ds1307_driver;
+extern const rtc_driver_t rtc_pcf8563_driver;
+extern const rtc_driver_t rtc_soft_driver;
+
+// Register access for the chip backends (rtc.c, over i2c_bus.h):
+// consecutive registers in one transaction, the chip's register pointer
+// auto-increments. False if the transfer still failed after its retries.
+// attach() probes before it reads, so that the NACKs of a chip that is not
+// there are not counted as errors.
+bool rtc_i2c_probe(uint8_t address);
+bool rtc_i2c_read(uint8_t address, uint8_t reg, uint8_t* data, uint8_t length);
+bool rtc_i2c_write(uint8_t address, uint8_t reg, const uint8_t* data, uint8_t length);
+
+#endif // RTC_DRIVER_H 
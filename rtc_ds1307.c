@@ -0,0 +1,150 @@
+#include <avr/pgmspace.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "rtc.h"
+#include "rtc_driver.h"
+#include "time_utils.h"
+
+// DS1307 and DS3231 backends: the same clock registers at the same
+// address. The DS1307 has 56 bytes of battery-backed RAM after them, the
+// DS3231 its alarms, square wave control and temperature sensor instead.
+
+// Clock registers
+#define DS1307_SECONDS      0x00    // Bit 7: CH, oscillator halted (DS1307)
+#define DS1307_CH           0x80
+#define DS1307_MINUTES      0x01
+#define DS1307_HOURS        0x02
+#define DS1307_DAY          0x03    // Weekday, 1 = Monday
+#define DS1307_DATE         0x04
+#define DS1307_MONTH        0x05    // Bit 7: century (DS3231)
+#define DS1307_YEAR         0x06
+#define DS1307_CLOCK_REGS   7
+
+// Battery-backed RAM (DS1307)
+#define DS1307_NVRAM        0x08
+
+// Temperature, whole degrees: read-only on a DS3231, RAM on a DS1307
+#define DS3231_TEMP_MSB     0x11
+
+static bool ds1307_read(time_t* time, date_t* date)
+{
+    uint8_t regs[DS1307_CLOCK_REGS];
+    
+    if (!rtc_i2c_read(RTC_DS1307_ADDRESS, DS1307_SECONDS, regs, sizeof(regs))) {
+        return false;
+    }
+    
+    time->second = bcd_to_bin(regs[DS1307_SECONDS] & 0x7F);
+    time->minute = bcd_to_bin(regs[DS1307_MINUTES] & 0x7F);
+    time->hour = bcd_to_bin(regs[DS1307_HOURS] & 0x3F);
+    date->day = bcd_to_bin(regs[DS1307_DATE] & 0x3F);
+    date->month = bcd_to_bin(regs[DS1307_MONTH] & 0x1F);
+    date->year = 2000 + bcd_to_bin(regs[DS1307_YEAR]);
+    return true;
+}
+
+// Time, date and weekday in one burst write
+static void ds1307_write(epoch_t epoch)
+{
+    time_t time;
+    date_t date;
+    uint8_t regs[DS1307_CLOCK_REGS];
+    
+    epoch_to_datetime(epoch, &date, &time);
+    
+    regs[DS1307_SECONDS] = bin_to_bcd(time.second);
+    regs[DS1307_MINUTES] = bin_to_bcd(time.minute);
+    regs[DS1307_HOURS] = bin_to_bcd(time.hour);
+    regs[DS1307_DAY] = epoch_weekday(epoch) + 1;
+    regs[DS1307_DATE] = bin_to_bcd(date.day);
+    regs[DS1307_MONTH] = bin_to_bcd(date.month);
+    regs[DS1307_YEAR] = bin_to_bcd(date.year - 2000);
+    
+    rtc_i2c_write(RTC_DS1307_ADDRESS, DS1307_SECONDS, regs, sizeof(regs));
+}
+
+static uint8_t ds1307_read_second(void)
+{
+    uint8_t second;
+    
+    if (!rtc_i2c_read(RTC_DS1307_ADDRESS, DS1307_SECONDS, &second, 1)) {
+        return RTC_NO_SECOND;
+    }
+    second &= 0x7F;
+    return ((second & 0x0F) < 10 && second < 0x60) ? bcd_to_bin(second) : RTC_NO_SECOND;
+}
+
+static bool ds1307_read_nvram(uint8_t offset, void* data, uint8_t length)
+{
+    return rtc_i2c_read(RTC_DS1307_ADDRESS, DS1307_NVRAM + offset, (uint8_t*)data, length);
+}
+
+static bool ds1307_write_nvram(uint8_t offset, const void* data, uint8_t length)
+{
+    return rtc_i2c_write(RTC_DS1307_ADDRESS, DS1307_NVRAM + offset, (const uint8_t*)data, length);
+}
+
+// Tried after the DS3231, so a chip that answers here is a DS1307. A new
+// (or never set) one comes up with its oscillator halted: clear CH and
+// keep the seconds.
+static bool ds1307_attach(bool power_on)
+{
+    uint8_t second;
+    
+    (void)power_on;
+    if (!rtc_i2c_probe(RTC_DS1307_ADDRESS)) {
+        return false;
+    }
+    if (rtc_i2c_read(RTC_DS1307_ADDRESS, DS1307_SECONDS, &second, 1) && (second & DS1307_CH)) {
+        second &= ~DS1307_CH;
+        rtc_i2c_write(RTC_DS1307_ADDRESS, DS1307_SECONDS, &second, 1);
+    }
+    return true;
+}
+
+// A DS3231 ignores writes to its temperature register, where a DS1307
+// keeps them in RAM: write the complement and look. Only a chip that
+// gives the complement back is a DS1307; anything else, such as a
+// temperature that moved in between, is a DS3231, so that the DS1307's
+// NVRAM writes never land on a DS3231's alarm and control registers.
+// The byte is put back either way.
+static bool ds3231_attach(bool power_on)
+{
+    uint8_t saved, test, check;
+    bool ram;
+    
+    (void)power_on;
+    if (!rtc_i2c_probe(RTC_DS1307_ADDRESS) ||
+        !rtc_i2c_read(RTC_DS1307_ADDRESS, DS3231_TEMP_MSB, &saved, 1)) {
+        return false;
+    }
+    
+    test = ~saved;
+    rtc_i2c_write(RTC_DS1307_ADDRESS, DS3231_TEMP_MSB, &test, 1);
+    ram = rtc_i2c_read(RTC_DS1307_ADDRESS, DS3231_TEMP_MSB, &check, 1) && check == test;
+    rtc_i2c_write(RTC_DS1307_ADDRESS, DS3231_TEMP_MSB, &saved, 1);
+    return !ram;
+}
+
+const rtc_driver_t rtc_ds1307_driver PROGMEM = {
+    .chip = RTC_CHIP_DS1307,
+    .caps = RTC_CAP_BURST | RTC_CAP_SQW | RTC_CAP_NVRAM | RTC_CAP_CLOCK,
+    .attach = ds1307_attach,
+    .read = ds1307_read,
+    .write = ds1307_write,
+    .read_second = ds1307_read_second,
+    .read_nvram = ds1307_read_nvram,
+    .write_nvram = ds1307_write_nvram
+};
+
+const rtc_driver_t rtc_ds3231_driver PROGMEM = {
+    .chip = RTC_CHIP_DS3231,
+    .caps = RTC_CAP_BURST | RTC_CAP_ALARM | RTC_CAP_SQW | RTC_CAP_TEMP | RTC_CAP_CLOCK,
+    .attach = ds3231_attach,
+    .read = ds1307_read,
+    .write = ds1307_write,
+    .read_second = ds1307_read_second,
+    .read_nvram = NULL,
+    .write_nvram = NULL
+};
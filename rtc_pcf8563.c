@@ -0,0 +1,103 @@
+#include <avr/pgmspace.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "rtc.h"
+#include "rtc_driver.h"
+#include "time_utils.h"
+
+// PCF8563 backend. Its clock registers follow two control registers and
+// order the weekday before the month; the weekday is whatever is written
+// (0 = Monday here, as epoch_weekday()). It has alarm registers and a
+// CLKOUT square wave but no RAM.
+
+#define PCF8563_CONTROL1    0x00    // Bit 5: STOP, clock halted
+#define PCF8563_SECONDS     0x02    // Bit 7: VL, clock integrity lost
+#define PCF8563_MINUTES     0x03
+#define PCF8563_HOURS       0x04
+#define PCF8563_DAYS        0x05
+#define PCF8563_WEEKDAYS    0x06
+#define PCF8563_MONTHS      0x07    // Bit 7: century
+#define PCF8563_YEARS       0x08
+#define PCF8563_CLOCK_REGS  7
+
+#define PCF8563_STOP        0x20
+
+// Offsets of the clock registers in a burst from PCF8563_SECONDS
+#define REG(name)           (PCF8563_##name - PCF8563_SECONDS)
+
+static bool pcf8563_read(time_t* time, date_t* date)
+{
+    uint8_t regs[PCF8563_CLOCK_REGS];
+    
+    if (!rtc_i2c_read(RTC_PCF8563_ADDRESS, PCF8563_SECONDS, regs, sizeof(regs))) {
+        return false;
+    }
+    
+    time->second = bcd_to_bin(regs[REG(SECONDS)] & 0x7F);
+    time->minute = bcd_to_bin(regs[REG(MINUTES)] & 0x7F);
+    time->hour = bcd_to_bin(regs[REG(HOURS)] & 0x3F);
+    date->day = bcd_to_bin(regs[REG(DAYS)] & 0x3F);
+    date->month = bcd_to_bin(regs[REG(MONTHS)] & 0x1F);
+    date->year = 2000 + bcd_to_bin(regs[REG(YEARS)]);
+    return true;
+}
+
+// Time, date and weekday in one burst write; writing the seconds clears VL
+static void pcf8563_write(epoch_t epoch)
+{
+    time_t time;
+    date_t date;
+    uint8_t regs[PCF8563_CLOCK_REGS];
+    
+    epoch_to_datetime(epoch, &date, &time);
+    
+    regs[REG(SECONDS)] = bin_to_bcd(time.second);
+    regs[REG(MINUTES)] = bin_to_bcd(time.minute);
+    regs[REG(HOURS)] = bin_to_bcd(time.hour);
+    regs[REG(DAYS)] = bin_to_bcd(date.day);
+    regs[REG(WEEKDAYS)] = epoch_weekday(epoch);
+    regs[REG(MONTHS)] = bin_to_bcd(date.month);
+    regs[REG(YEARS)] = bin_to_bcd(date.year - 2000);
+    
+    rtc_i2c_write(RTC_PCF8563_ADDRESS, PCF8563_SECONDS, regs, sizeof(regs));
+}
+
+static uint8_t pcf8563_read_second(void)
+{
+    uint8_t second;
+    
+    if (!rtc_i2c_read(RTC_PCF8563_ADDRESS, PCF8563_SECONDS, &second, 1)) {
+        return RTC_NO_SECOND;
+    }
+    second &= 0x7F;
+    return ((second & 0x0F) < 10 && second < 0x60) ? bcd_to_bin(second) : RTC_NO_SECOND;
+}
+
+// Start a halted clock
+static bool pcf8563_attach(bool power_on)
+{
+    uint8_t control;
+    
+    (void)power_on;
+    if (!rtc_i2c_probe(RTC_PCF8563_ADDRESS) ||
+        !rtc_i2c_read(RTC_PCF8563_ADDRESS, PCF8563_CONTROL1, &control, 1)) {
+        return false;
+    }
+    if (control & PCF8563_STOP) {
+        control &= ~PCF8563_STOP;
+        rtc_i2c_write(RTC_PCF8563_ADDRESS, PCF8563_CONTROL1, &control, 1);
+    }
+    return true;
+}
+
+const rtc_driver_t rtc_pcf8563_driver PROGMEM = {
+    .chip = RTC_CHIP_PCF8563,
+    .caps = RTC_CAP_BURST | RTC_CAP_ALARM | RTC_CAP_SQW | RTC_CAP_CLOCK,
+    .attach = pcf8563_attach,
+    .read = pcf8563_read,
+    .write = pcf8563_write,
+    .read_second = pcf8563_read_second,
+    .read_nvram = NULL,
+    .write_nvram = NULL
+};
@@ -0,0 +1,63 @@
+#include <avr/pgmspace.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "hal.h"
+#include "rtc.h"
+#include "rtc_driver.h"
+#include "time_utils.h"
+#include "timebase.h"
+
+// Software clock for a board without an RTC chip: the epoch counts the
+// 1 Hz tick (timebase_seconds()). It keeps time through a warm reset in
+// .noinit, starts over at RTC_SOFT_START_EPOCH after a power cycle, and
+// runs as true as the tick: with the period last measured against a chip
+// (saved with the settings) or the nominal one.
+
+// Epoch at the tick count base_seconds
+static epoch_t base_epoch = RTC_SOFT_START_EPOCH;
+static uint32_t base_seconds = 0;
+
+// The last epoch read, for warm resets
+static epoch_t noinit_epoch HAL_NOINIT;
+static epoch_t noinit_epoch_check HAL_NOINIT;
+
+static void soft_set(epoch_t epoch)
+{
+    base_epoch = epoch;
+    base_seconds = timebase_seconds();
+    noinit_epoch = epoch;
+    noinit_epoch_check = ~epoch;
+}
+
+static bool soft_read(time_t* time, date_t* date)
+{
+    epoch_t epoch = base_epoch + (timebase_seconds() - base_seconds);
+    
+    noinit_epoch = epoch;
+    noinit_epoch_check = ~epoch;
+    epoch_to_datetime(epoch, date, time);
+    return true;
+}
+
+// Always there: resume after a warm reset, else start over
+static bool soft_attach(bool power_on)
+{
+    if (!power_on && noinit_epoch_check == (epoch_t)~noinit_epoch) {
+        soft_set(noinit_epoch);
+    } else {
+        soft_set(RTC_SOFT_START_EPOCH);
+    }
+    return true;
+}
+
+const rtc_driver_t rtc_soft_driver PROGMEM = {
+    .chip = RTC_CHIP_SOFT,
+    .caps = 0,
+    .attach = soft_attach,
+    .read = soft_read,
+    .write = soft_set,
+    .read_second = NULL,
+    .read_nvram = NULL,
+    .write_nvram = NULL
+};
@@ -0,0 +1,191 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "hal.h"
+#include "settings.h"
+#include "alarm.h"
+#include "countdown.h"
+#include "tz.h"
+#include "timebase.h"
+#include "prof.h"
+#include "trace.h"
+
+// Mode value meaning "no saved mode"
+#define SETTINGS_NO_MODE    0xFF
+
+// Last record loaded or committed, and where the next one goes
+static settings_record_t stored;
+static uint8_t next_slot = 0;
+static uint8_t saved_mode = SETTINGS_NO_MODE;
+
+// Coalescing state: seconds left until a pending change is committed
+static bool dirty = false;
+static uint8_t quiet_seconds = 0;
+
+// Interrupt-driven write state
+static settings_record_t write_buffer;
+static volatile uint16_t write_address = 0;
+static volatile uint8_t write_position = 0;
+static volatile bool write_busy = false;
+
+// Collect the persistent values from their modules
+static void settings_capture(settings_record_t* record)
+{
+    for (uint8_t i = 0; i < ALARM_COUNT; i++) {
+        record->alarms[i] = alarm_get(i);
+    }
+    record->countdown_preset = countdown_get_preset();
+    record->mode = saved_mode;
+    record->zone = tz_get_zone();
+    record->tick_period = timebase_get_period();
+}
+
+// Push a loaded record back into the modules
+static void settings_apply(const settings_record_t* record)
+{
+    // Zone first: alarms are scheduled in local time
+    tz_select(record->zone);
+    for (uint8_t i = 0; i < ALARM_COUNT; i++) {
+        alarm_store(i, &record->alarms[i]);
+    }
+    countdown_set(record->countdown_preset);
+    saved_mode = record->mode;
+    
+    // Out of range keeps the nominal period
+    timebase_set_period(record->tick_period);
+}
+
+// Start writing write_buffer to the next slot, one byte per EE_RDY interrupt
+static void settings_start_write(void)
+{
+    write_address = (uint16_t)next_slot * SETTINGS_SLOT_SIZE;
+    write_position = 0;
+    write_busy = true;
+    hal_eeprom_irq_enable();
+    
+    next_slot = (next_slot + 1) % SETTINGS_SLOT_COUNT;
+}
+
+// Load the newest valid slot in a single pass over the EEPROM
+void settings_init(void)
+{
+    settings_record_t record;
+    bool found = false;
+    uint8_t newest_slot = 0;
+    
+    for (uint8_t slot = 0; slot < SETTINGS_SLOT_COUNT; slot++) {
+        hal_eeprom_read_block(&record, (uint16_t)slot * SETTINGS_SLOT_SIZE, sizeof(record));
+        
+        if (record.version != SETTINGS_VERSION ||
+            record.crc != settings_crc8((const uint8_t*)&record, sizeof(record) - 1)) {
+            continue;
+        }
+        
+        // Sequence numbers wrap; with fewer than 128 slots the signed
+        // difference always orders them correctly
+        if (!found || (int8_t)(record.sequence - stored.sequence) > 0) {
+            stored = record;
+            newest_slot = slot;
+            found = true;
+        }
+    }
+    
+    if (found) {
+        settings_apply(&stored);
+        next_slot = (newest_slot + 1) % SETTINGS_SLOT_COUNT;
+    } else {
+        // Blank or incompatible EEPROM: start from the module defaults
+        memset(&stored, 0, sizeof(stored));
+        stored.version = SETTINGS_VERSION;
+        settings_capture(&stored);
+        stored.sequence = 0xFF;
+        next_slot = 0;
+    }
+    
+    dirty = false;
+}
+
+// Note a change to a persistent value; restarts the coalescing delay
+void settings_changed(void)
+{
+    dirty = true;
+    quiet_seconds = SETTINGS_COMMIT_DELAY_S;
+}
+
+// Commit pending changes once they have been stable (called on the 1 Hz tick)
+void settings_tick(void)
+{
+    settings_record_t record;
+    
+    if (!dirty || write_busy) {
+        return;
+    }
+    
+    if (quiet_seconds > 0) {
+        quiet_seconds--;
+        return;
+    }
+    dirty = false;
+    
+    // Skip the write if the values ended up where they started
+    record = stored;
+    settings_capture(&record);
+    if (memcmp(&record, &stored, sizeof(record)) == 0) {
+        return;
+    }
+    
+    record.sequence = stored.sequence + 1;
+    record.crc = settings_crc8((const uint8_t*)&record, sizeof(record) - 1);
+    stored = record;
+    write_buffer = record;
+    settings_start_write();
+}
+
+// Record the current mode for the next power-up
+void settings_set_mode(uint8_t mode)
+{
+    saved_mode = mode;
+    settings_changed();
+}
+
+// Mode saved in EEPROM (0xFF if none)
+uint8_t settings_get_mode(void)
+{
+    return saved_mode;
+}
+
+// Check if an EEPROM write is still in progress
+bool settings_is_busy(void)
+{
+    return write_busy;
+}
+
+// CRC-8 (Dallas/Maxim polynomial 0x31, reflected)
+uint8_t settings_crc8(const uint8_t* data, uint8_t length)
+{
+    uint8_t crc = 0;
+    
+    while (length--) {
+        crc ^= *data++;
+        for (uint8_t bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x01) ? (crc >> 1) ^ 0x8C : (crc >> 1);
+        }
+    }
+    return crc;
+}
+
+// EEPROM ready ISR - writes the next byte of write_buffer
+HAL_EEPROM_READY_ISR()
+{
+    PROF_BEGIN(PROF_EEPROM_ISR);
+    TRACE_EVENT(TRACE_EEPROM_ISR, write_position);
+    if (write_position < sizeof(write_buffer)) {
+        hal_eeprom_write_byte(write_address + write_position,
+                              ((const uint8_t*)&write_buffer)[write_position]);
+        write_position++;
+    } else {
+        hal_eeprom_irq_disable();
+        write_busy = false;
+    }
+    PROF_END(PROF_EEPROM_ISR);
+}
@@ -0,0 +1,41 @@
+#ifndef SETTINGS_H
+#define SETTINGS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "alarm.h"
+
+// Bump when the record layout changes; older records are then ignored
+#define SETTINGS_VERSION            3
+
+// Seconds a change must stay untouched before it is written
+#define SETTINGS_COMMIT_DELAY_S     5
+
+// EEPROM is split into equal slots that are written round-robin
+#define SETTINGS_SLOT_SIZE          32
+#define SETTINGS_SLOT_COUNT         (HAL_EEPROM_SIZE / SETTINGS_SLOT_SIZE)
+
+// Settings record as stored in one EEPROM slot
+typedef struct {
+    uint8_t version;
+    uint8_t sequence;                   // Incremented on every write, newest wins
+    alarm_t alarms[ALARM_COUNT];
+    uint16_t countdown_preset;
+    uint8_t mode;
+    uint8_t zone;                       // Time zone table index
+    uint32_t tick_period;               // Measured tick period (timebase.h)
+    uint8_t crc;                        // CRC-8 over all preceding bytes
+} __attribute__((packed)) settings_record_t;
+
+// Function prototypes
+void settings_init(void);
+void settings_changed(void);
+void settings_tick(void);
+void settings_set_mode(uint8_t mode);
+uint8_t settings_get_mode(void);
+bool settings_is_busy(void);
+
+// Internal functions
+uint8_t settings_crc8(const uint8_t* data, uint8_t length);
+
+#endif // SETTINGS_H 
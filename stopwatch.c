@@ -1,53 +1,132 @@
-#include <avr/io.h>
 #include <stdint.h>
 #include <stdbool.h>
 #include <stdio.h>
+#include <string.h>
 #include "stopwatch.h"
 #include "lcd.h"
+#include "timebase.h"
+#include "mode.h"
 
-// Stopwatch variables
-static stopwatch_time_t stopwatch_time = {0, 0, 0};
+// Display limit, 99:59:59, in seconds and in time base counts (128 us;
+// 15625 counts are two seconds)
+#define STOPWATCH_MAX_SECONDS   359999UL
+#define STOPWATCH_MAX_COUNTS    2812492187UL
+#define COUNTS_PER_2_SECONDS    15625UL
+#define REFRESH_COUNTS          (STOPWATCH_REFRESH_MS * 125UL / 16)
+
+// Stopwatch variables: elapsed time is the difference of time stamps
+// instead of being accumulated tick by tick
+static uint32_t stopwatch_base = 0;        // Counts from earlier runs
+static uint32_t stopwatch_started = 0;     // Time stamp of the current run's start
+static uint32_t stopwatch_rendered = 0;    // Time stamp of the last redraw
 static stopwatch_state_t stopwatch_state = STOPWATCH_STOPPED;
 
+// Laps: a ring of the latest lap times, the split (elapsed time) at the
+// last lap and the best lap since the reset. The average is the last
+// split over the lap count.
+static uint32_t laps[STOPWATCH_LAPS];
+static uint8_t lap_next = 0;
+static uint16_t lap_count = 0;
+static uint32_t last_split = 0;
+static uint32_t best_lap = 0;
+
+// Elapsed counts at a time stamp
+static uint32_t stopwatch_elapsed(uint32_t at)
+{
+    uint32_t counts = stopwatch_base;
+    
+    if (stopwatch_state == STOPWATCH_RUNNING) {
+        counts += at - stopwatch_started;
+    }
+    return (counts > STOPWATCH_MAX_COUNTS) ? STOPWATCH_MAX_COUNTS : counts;
+}
+
+// Split counts into hours, minutes, seconds and hundredths
+static stopwatch_time_t stopwatch_split_time(uint32_t counts)
+{
+    stopwatch_time_t time;
+    uint32_t ms = timebase_to_ms(counts);
+    uint32_t seconds = ms / 1000;
+    
+    time.hundredths = (uint16_t)(ms % 1000) / 10;
+    time.hours = seconds / 3600;
+    seconds -= (uint32_t)time.hours * 3600;
+    time.minutes = (uint16_t)seconds / 60;
+    time.seconds = (uint16_t)seconds % 60;
+    return time;
+}
+
 // Initialize stopwatch
 void stopwatch_init(void)
 {
-    stopwatch_time.hours = 0;
-    stopwatch_time.minutes = 0;
-    stopwatch_time.seconds = 0;
-    stopwatch_state = STOPWATCH_STOPPED;
+    stopwatch_reset();
 }
 
 // Start stopwatch
-void stopwatch_start(void)
+void stopwatch_start(uint32_t at)
 {
     if (stopwatch_state == STOPWATCH_STOPPED) {
+        stopwatch_started = at;
         stopwatch_state = STOPWATCH_RUNNING;
+        mode_dirty(MODE_DIRTY_STOPWATCH);
     }
 }
 
 // Stop stopwatch
-void stopwatch_stop(void)
+void stopwatch_stop(uint32_t at)
 {
     if (stopwatch_state == STOPWATCH_RUNNING) {
+        stopwatch_base = stopwatch_elapsed(at);
         stopwatch_state = STOPWATCH_STOPPED;
+        mode_dirty(MODE_DIRTY_STOPWATCH);
     }
 }
 
-// Reset stopwatch
+// Take a lap while running
+void stopwatch_lap(uint32_t at)
+{
+    uint32_t split, lap;
+    
+    if (stopwatch_state != STOPWATCH_RUNNING) {
+        return;
+    }
+    
+    split = stopwatch_elapsed(at);
+    lap = split - last_split;
+    last_split = split;
+    
+    laps[lap_next] = lap;
+    lap_next = (lap_next + 1) % STOPWATCH_LAPS;
+    if (lap_count == 0 || lap < best_lap) {
+        best_lap = lap;
+    }
+    if (lap_count < UINT16_MAX) {
+        lap_count++;
+    }
+    mode_dirty(MODE_DIRTY_STOPWATCH);
+}
+
+// Reset stopwatch and its laps
 void stopwatch_reset(void)
 {
-    stopwatch_time.hours = 0;
-    stopwatch_time.minutes = 0;
-    stopwatch_time.seconds = 0;
+    stopwatch_base = 0;
     stopwatch_state = STOPWATCH_STOPPED;
+    lap_next = 0;
+    lap_count = 0;
+    last_split = 0;
+    best_lap = 0;
+    mode_dirty(MODE_DIRTY_STOPWATCH);
 }
 
 // Update stopwatch (called every second)
 void stopwatch_update(void)
 {
-    if (stopwatch_state == STOPWATCH_RUNNING) {
-        stopwatch_increment();
+    // Stop at the display limit
+    if (stopwatch_state == STOPWATCH_RUNNING &&
+        stopwatch_elapsed(timebase_now()) >= STOPWATCH_MAX_COUNTS) {
+        stopwatch_base = STOPWATCH_MAX_COUNTS;
+        stopwatch_state = STOPWATCH_STOPPED;
+        mode_dirty(MODE_DIRTY_STOPWATCH);
     }
 }
 
@@ -60,7 +139,7 @@ bool stopwatch_is_running(void)
 // Get current stopwatch time
 stopwatch_time_t stopwatch_get_time(void)
 {
-    return stopwatch_time;
+    return stopwatch_split_time(stopwatch_elapsed(timebase_now()));
 }
 
 // Display stopwatch time on LCD
@@ -69,43 +148,125 @@ void stopwatch_display(void)
     char time_str[16];
     stopwatch_format_time(time_str);
     lcd_print(time_str);
+    stopwatch_rendered = timebase_now();
+}
+
+// Display a lap view (STOPWATCH_VIEW_*, then older laps) as a whole row:
+// "L12  01:02.34", "Best 00:59.80", "Avg  01:00.91". Lap numbers show
+// their last three digits.
+void stopwatch_display_lap(uint8_t view)
+{
+    char line[17];
+    char label[6];
+    char value[10];
+    uint32_t counts;
+    uint8_t back;
+    
+    if (view == STOPWATCH_VIEW_BEST) {
+        strcpy(label, "Best");
+        counts = best_lap;
+    } else if (view == STOPWATCH_VIEW_AVERAGE) {
+        strcpy(label, "Avg");
+        counts = stopwatch_average_lap();
+    } else {
+        back = (view == STOPWATCH_VIEW_LAST) ? 0 : view - STOPWATCH_VIEW_AVERAGE;
+        sprintf(label, "L%u", (lap_count - back) % 1000);
+        counts = stopwatch_lap_time(back);
+    }
+    
+    stopwatch_format_counts(counts, value);
+    sprintf(line, "%-5s%s  ", label, value);
+    lcd_print(line);
+}
+
+// A running stopwatch changes every STOPWATCH_REFRESH_MS after its last
+// redraw (called on every main loop pass)
+void stopwatch_poll(void)
+{
+    if (stopwatch_state == STOPWATCH_RUNNING &&
+        timebase_now() - stopwatch_rendered >= REFRESH_COUNTS) {
+        mode_dirty(MODE_DIRTY_STOPWATCH);
+    }
 }
 
 // Set stopwatch time
 void stopwatch_set_time(stopwatch_time_t time)
 {
-    stopwatch_time = time;
+    stopwatch_set_seconds((uint32_t)time.hours * 3600 +
+                          (uint16_t)time.minutes * 60 + time.seconds);
+}
+
+// Get elapsed time in whole seconds
+uint32_t stopwatch_get_seconds(void)
+{
+    uint32_t counts = stopwatch_elapsed(timebase_now());
+    
+    return (counts / COUNTS_PER_2_SECONDS) * 2 + (counts % COUNTS_PER_2_SECONDS) * 2 / COUNTS_PER_2_SECONDS;
 }
 
-// Increment stopwatch time
-void stopwatch_increment(void)
+// Set elapsed time in seconds (clamped to 99:59:59)
+void stopwatch_set_seconds(uint32_t seconds)
 {
-    stopwatch_time.seconds++;
+    if (seconds > STOPWATCH_MAX_SECONDS) {
+        seconds = STOPWATCH_MAX_SECONDS;
+    }
     
-    if (stopwatch_time.seconds >= 60) {
-        stopwatch_time.seconds = 0;
-        stopwatch_time.minutes++;
-        
-        if (stopwatch_time.minutes >= 60) {
-            stopwatch_time.minutes = 0;
-            stopwatch_time.hours++;
-            
-            // Limit to 99:59:59
-            if (stopwatch_time.hours >= 100) {
-                stopwatch_time.hours = 99;
-                stopwatch_time.minutes = 59;
-                stopwatch_time.seconds = 59;
-                stopwatch_state = STOPWATCH_STOPPED;
-            }
-        }
+    stopwatch_base = seconds * (COUNTS_PER_2_SECONDS / 2) + seconds / 2;
+    stopwatch_started = timebase_now();
+    mode_dirty(MODE_DIRTY_STOPWATCH);
+}
+
+// Laps taken since the reset
+uint16_t stopwatch_lap_count(void)
+{
+    return lap_count;
+}
+
+// Lap time in counts, back laps before the last one (0 if not kept)
+uint32_t stopwatch_lap_time(uint8_t back)
+{
+    if (back >= STOPWATCH_LAPS || back >= lap_count) {
+        return 0;
+    }
+    return laps[(lap_next + STOPWATCH_LAPS - 1 - back) % STOPWATCH_LAPS];
+}
+
+uint32_t stopwatch_best_lap(void)
+{
+    return best_lap;
+}
+
+uint32_t stopwatch_average_lap(void)
+{
+    return lap_count ? last_split / lap_count : 0;
+}
+
+// Lap views available: last, best and average, then the older laps kept
+uint8_t stopwatch_view_count(void)
+{
+    if (lap_count == 0) {
+        return 0;
     }
+    return STOPWATCH_VIEW_AVERAGE + ((lap_count < STOPWATCH_LAPS) ? lap_count : STOPWATCH_LAPS);
 }
 
 // Format stopwatch time to string
 void stopwatch_format_time(char* buffer)
 {
-    sprintf(buffer, "%02d:%02d:%02d", 
-            stopwatch_time.hours, 
-            stopwatch_time.minutes, 
-            stopwatch_time.seconds);
-} 
\ No newline at end of file
+    stopwatch_format_counts(stopwatch_elapsed(timebase_now()), buffer);
+}
+
+// Format counts in nine characters: "MM:SS.hh " below 100 minutes,
+// "H:MM:SS.t" below 10 hours, "HH:MM:SS " above
+void stopwatch_format_counts(uint32_t counts, char* buffer)
+{
+    stopwatch_time_t time = stopwatch_split_time(counts);
+    
+    if (time.hours == 0 || (time.hours == 1 && time.minutes < 40)) {
+        sprintf(buffer, "%02d:%02d.%02d ", time.hours * 60 + time.minutes, time.seconds, time.hundredths);
+    } else if (time.hours < 10) {
+        sprintf(buffer, "%d:%02d:%02d.%d", time.hours, time.minutes, time.seconds, time.hundredths / 10);
+    } else {
+        sprintf(buffer, "%02d:%02d:%02d ", time.hours, time.minutes, time.seconds);
+    }
+}
@@ -4,11 +4,25 @@
 #include <stdint.h>
 #include <stdbool.h>
 
+// Laps kept for display, in a ring of the most recent ones
+#define STOPWATCH_LAPS          8
+
+// Redraw period of a running stopwatch; the LCD's response time blurs
+// anything faster, so the hundredths move at this rate
+#define STOPWATCH_REFRESH_MS    100
+
+// Lap views of the first row: the last lap, the best, the average, then
+// the older laps kept in the ring
+#define STOPWATCH_VIEW_LAST     0
+#define STOPWATCH_VIEW_BEST     1
+#define STOPWATCH_VIEW_AVERAGE  2
+
 // Stopwatch time structure
 typedef struct {
     uint8_t hours;
     uint8_t minutes;
     uint8_t seconds;
+    uint8_t hundredths;
 } stopwatch_time_t;
 
 // Stopwatch states
@@ -18,19 +32,30 @@ typedef enum {
     STOPWATCH_PAUSED
 } stopwatch_state_t;
 
-// Function prototypes
+// Function prototypes. Start, stop and lap take a time stamp (timebase.h),
+// normally the press time of the key.
 void stopwatch_init(void);
-void stopwatch_start(void);
-void stopwatch_stop(void);
+void stopwatch_start(uint32_t at);
+void stopwatch_stop(uint32_t at);
+void stopwatch_lap(uint32_t at);
 void stopwatch_reset(void);
 void stopwatch_update(void);
 bool stopwatch_is_running(void);
 stopwatch_time_t stopwatch_get_time(void);
 void stopwatch_display(void);
+void stopwatch_display_lap(uint8_t view);
+void stopwatch_poll(void);
 void stopwatch_set_time(stopwatch_time_t time);
+uint32_t stopwatch_get_seconds(void);
+void stopwatch_set_seconds(uint32_t seconds);
+uint16_t stopwatch_lap_count(void);
+uint32_t stopwatch_lap_time(uint8_t back);
+uint32_t stopwatch_best_lap(void);
+uint32_t stopwatch_average_lap(void);
+uint8_t stopwatch_view_count(void);
 
 // Internal functions
-void stopwatch_increment(void);
 void stopwatch_format_time(char* buffer);
+void stopwatch_format_counts(uint32_t counts, char* buffer);
 
-#endif // STOPWATCH_H 
\ No newline at end of file
+#endif // STOPWATCH_H 
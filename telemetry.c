@@ -0,0 +1,89 @@
+#include <avr/pgmspace.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "uart.h"
+#include "telemetry.h"
+
+// Powers of ten for the decimal conversion: repeated subtraction is a
+// few hundred cycles for any 32-bit value, a division per digit would
+// cost thousands
+static const uint32_t powers_of_ten[] PROGMEM = {
+    1000000000UL, 100000000UL, 10000000UL, 1000000UL, 100000UL,
+    10000UL, 1000UL, 100UL, 10UL, 1UL
+};
+
+static char line[TELEMETRY_LINE_MAX];
+static uint8_t line_length;
+static uint16_t dropped = 0;
+
+// Room a tag leaves for " <value>\n"
+#define TAG_MAX     (TELEMETRY_LINE_MAX - 12)
+
+// Append a flash string, cut short at limit characters into the line
+static void line_append_P(const char* text, uint8_t limit)
+{
+    char c;
+    
+    while ((c = pgm_read_byte(text++)) != '\0' && line_length < limit) {
+        line[line_length++] = c;
+    }
+}
+
+static void line_append_u32(uint32_t value)
+{
+    bool leading = true;
+    
+    for (uint8_t i = 0; i < sizeof(powers_of_ten) / sizeof(powers_of_ten[0]); i++) {
+        uint32_t power = pgm_read_dword(&powers_of_ten[i]);
+        char digit = '0';
+        
+        while (value >= power) {
+            value -= power;
+            digit++;
+        }
+        // Keep the last digit so that zero prints as "0"
+        if (digit != '0' || !leading || power == 1) {
+            leading = false;
+            line[line_length++] = digit;
+        }
+    }
+}
+
+// Queue the finished line, or count it as dropped
+static void line_send(void)
+{
+    line[line_length++] = '\n';
+    if (!uart_write((const uint8_t*)line, line_length) && dropped < UINT16_MAX) {
+        dropped++;
+    }
+}
+
+void telemetry_init(uint8_t reset_cause)
+{
+    uart_init();
+    telemetry_event(PSTR("boot"), reset_cause);
+}
+
+void telemetry_event(const char* tag, uint32_t value)
+{
+    line_length = 0;
+    line_append_P(tag, TAG_MAX);
+    line[line_length++] = ' ';
+    line_append_u32(value);
+    line_send();
+}
+
+void telemetry_text(const char* tag, const char* text)
+{
+    line_length = 0;
+    line_append_P(tag, TAG_MAX);
+    line[line_length++] = ' ';
+    line_append_P(text, TELEMETRY_LINE_MAX - 1);
+    line_send();
+}
+
+// Lines lost to a full transmit ring since boot
+uint16_t telemetry_dropped(void)
+{
+    return dropped;
+}
@@ -0,0 +1,22 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <avr/pgmspace.h>
+#include <stdint.h>
+
+// One-line records on the UART console, "<tag> <value>\n":
+//   boot <reset cause bits>    tick <UTC epoch>     key <MODE|SET|START|STOP>
+//   alarm <slot 1-4>           i2c_err <count>      provision <parts written>
+// A line is queued whole or not at all. When the transmit ring has no
+// room it is dropped and counted; the caller never waits for the line.
+// Tags and texts are flash strings (PSTR). Main-loop context only.
+
+#define TELEMETRY_LINE_MAX  32
+
+// Function prototypes
+void telemetry_init(uint8_t reset_cause);
+void telemetry_event(const char* tag, uint32_t value);
+void telemetry_text(const char* tag, const char* text);
+uint16_t telemetry_dropped(void);
+
+#endif // TELEMETRY_H 
@@ -1,9 +1,13 @@
-#include <avr/io.h>
 #include <stdint.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include "time_utils.h"
 #include "rtc.h"
+#include "calendar_tables.h"
+
+// Table accessors
+#define DAYS_BEFORE_MONTH(leap, month)  pgm_read_word(&calendar_days_before_month[leap][(month) - 1])
+#define YEAR_START(index)               pgm_read_word(&calendar_year_start[index])
 
 // Time increment functions
 uint8_t increment_hour(uint8_t hour)
@@ -168,31 +172,134 @@ bool is_valid_year(uint16_t year)
 
 bool is_leap_year(uint16_t year)
 {
+    // Within the table range every fourth year is a leap year, 2000
+    // included, except 2100
+    if (year >= CALENDAR_FIRST_YEAR && year < CALENDAR_FIRST_YEAR + CALENDAR_YEARS) {
+        return (year & 3) == 0 && year != 2100;
+    }
     return ((year % 4 == 0 && year % 100 != 0) || (year % 400 == 0));
 }
 
 uint8_t days_in_month(uint8_t month, uint16_t year)
 {
-    const uint8_t days[] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+    bool leap;
     
     if (month < 1 || month > 12) return 31;
     
-    if (month == 2 && is_leap_year(year)) {
-        return 29;
-    }
+    leap = is_leap_year(year);
+    return DAYS_BEFORE_MONTH(leap, month + 1) - DAYS_BEFORE_MONTH(leap, month);
+}
+
+// x % 7 without a division. 37450 / 2^18 is just above 1/7, close enough
+// for x < 43693; 2^15 is 1 mod 7, so adding bit 15 to the low bits first
+// brings any 16-bit x into that range with the same remainder.
+static uint8_t mod7(uint16_t x)
+{
+    uint16_t quotient;
     
-    return days[month - 1];
+    x = (x >> 15) + (x & 0x7FFF);
+    quotient = ((uint32_t)x * 37450) >> 18;
+    return x - quotient * 7;
+}
+
+// Day of week, 0=Monday..6=Sunday
+uint8_t day_of_week(uint8_t day, uint8_t month, uint16_t year)
+{
+    return mod7(pgm_read_byte(&calendar_jan1_weekday[year - CALENDAR_FIRST_YEAR]) +
+                DAYS_BEFORE_MONTH(is_leap_year(year), month) + day - 1);
 }
 
 // Time conversion functions
-uint16_t time_to_seconds(uint8_t hour, uint8_t minute, uint8_t second)
+uint32_t time_to_seconds(uint8_t hour, uint8_t minute, uint8_t second)
+{
+    return (uint32_t)hour * EPOCH_SECONDS_PER_HOUR + (uint16_t)minute * 60 + second;
+}
+
+// Seconds into a day (below EPOCH_SECONDS_PER_DAY) to a time of day, with
+// multiplies: 4661 / 2^20 is just above 1/225 and 4370 / 2^18 just above
+// 1/60, both close enough to be exact over a day
+void seconds_to_time(uint32_t total_seconds, uint8_t* hour, uint8_t* minute, uint8_t* second)
+{
+    uint16_t rest;
+    
+    *hour = ((total_seconds >> 4) * 4661) >> 20;
+    rest = total_seconds - (uint32_t)*hour * EPOCH_SECONDS_PER_HOUR;
+    *minute = ((uint32_t)rest * 4370) >> 18;
+    *second = rest - (uint16_t)*minute * 60;
+}
+
+// Epoch functions (the whole 32-bit epoch, resolved through calendar_tables.h)
+
+// Days since 2000-01-01
+uint16_t days_from_civil(uint16_t year, uint8_t month, uint8_t day)
+{
+    return YEAR_START(year - CALENDAR_FIRST_YEAR) +
+           DAYS_BEFORE_MONTH(is_leap_year(year), month) + day - 1;
+}
+
+// Date from days since 2000-01-01
+void civil_from_days(uint16_t days, date_t* date)
 {
-    return (uint16_t)hour * 3600 + (uint16_t)minute * 60 + second;
+    // days * 179 / 2^16 is days / 366.1: never past the right year, and at
+    // most one step short of it
+    uint8_t index = ((uint32_t)days * 179) >> 16;
+    uint16_t day_in_year;
+    uint8_t month;
+    bool leap;
+    
+    if (YEAR_START(index + 1) <= days) index++;
+    day_in_year = days - YEAR_START(index);
+    leap = is_leap_year(CALENDAR_FIRST_YEAR + index);
+    
+    // No month is longer than 32 days, so day_in_year / 32 never overshoots
+    month = (day_in_year >> 5) + 1;
+    while (DAYS_BEFORE_MONTH(leap, month + 1) <= day_in_year) month++;
+    
+    date->year = CALENDAR_FIRST_YEAR + index;
+    date->month = month;
+    date->day = day_in_year - DAYS_BEFORE_MONTH(leap, month) + 1;
+}
+
+epoch_t epoch_from_datetime(const date_t* date, const time_t* time)
+{
+    return (epoch_t)days_from_civil(date->year, date->month, date->day) * EPOCH_SECONDS_PER_DAY +
+           time_to_seconds(time->hour, time->minute, time->second);
+}
+
+// Days since 2000-01-01 and the seconds into the last one, without a
+// 32-bit division: 49710 / 2^16 is just below 2^16 / 86400, so the
+// estimate from the top 16 bits is at most two days short
+uint16_t epoch_days(epoch_t epoch, uint32_t* rest)
+{
+    uint16_t days = ((epoch >> 16) * 49710) >> 16;
+    
+    *rest = epoch - (epoch_t)days * EPOCH_SECONDS_PER_DAY;
+    while (*rest >= EPOCH_SECONDS_PER_DAY) {
+        *rest -= EPOCH_SECONDS_PER_DAY;
+        days++;
+    }
+    return days;
+}
+
+void epoch_to_datetime(epoch_t epoch, date_t* date, time_t* time)
+{
+    uint32_t rest;
+    
+    civil_from_days(epoch_days(epoch, &rest), date);
+    seconds_to_time(rest, &time->hour, &time->minute, &time->second);
 }
 
-void seconds_to_time(uint16_t total_seconds, uint8_t* hour, uint8_t* minute, uint8_t* second)
+// Day of week of an epoch, 0=Monday..6=Sunday
+uint8_t epoch_weekday(epoch_t epoch)
 {
-    *hour = total_seconds / 3600;
-    *minute = (total_seconds % 3600) / 60;
-    *second = total_seconds % 60;
-} 
\ No newline at end of file
+    uint32_t rest;
+    
+    // 2000-01-01 was a Saturday
+    return mod7(epoch_days(epoch, &rest) + 5);
+}
+
+// Day of year, 1 = January 1st
+uint16_t day_of_year(const date_t* date)
+{
+    return DAYS_BEFORE_MONTH(is_leap_year(date->year), date->month) + date->day;
+}
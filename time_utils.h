@@ -38,9 +38,20 @@ bool is_valid_month(uint8_t month);
 bool is_valid_year(uint16_t year);
 bool is_leap_year(uint16_t year);
 uint8_t days_in_month(uint8_t month, uint16_t year);
+uint8_t day_of_week(uint8_t day, uint8_t month, uint16_t year);
 
 // Time conversion functions
-uint16_t time_to_seconds(uint8_t hour, uint8_t minute, uint8_t second);
-void seconds_to_time(uint16_t total_seconds, uint8_t* hour, uint8_t* minute, uint8_t* second);
+uint32_t time_to_seconds(uint8_t hour, uint8_t minute, uint8_t second);
+void seconds_to_time(uint32_t total_seconds, uint8_t* hour, uint8_t* minute, uint8_t* second);
+
+// Epoch functions (epoch_t = seconds since 2000-01-01 00:00:00, valid over
+// its whole range, to 2136)
+uint16_t days_from_civil(uint16_t year, uint8_t month, uint8_t day);
+void civil_from_days(uint16_t days, date_t* date);
+uint16_t epoch_days(epoch_t epoch, uint32_t* rest);
+epoch_t epoch_from_datetime(const date_t* date, const time_t* time);
+void epoch_to_datetime(epoch_t epoch, date_t* date, time_t* time);
+uint8_t epoch_weekday(epoch_t epoch);
+uint16_t day_of_year(const date_t* date);
 
 #endif // TIME_UTILS_H 
\ No newline at end of file
@@ -0,0 +1,138 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include "hal.h"
+#include "timebase.h"
+
+// Largest period offset timebase_period_ppm() takes, in 1/65536 counts
+#define PPM_CLAMP       (1L << 21)
+
+// Counts up to the last tick
+static volatile uint32_t timebase_ticks = 0;
+
+// Ticks since the tick started
+static volatile uint32_t tick_seconds = 0;
+
+// Tick period (1/65536 counts), the running fraction of a count and the
+// whole counts of the period Timer1 is running
+static volatile uint32_t tick_period = TIMEBASE_NOMINAL_PERIOD;
+static uint16_t tick_fraction = 0;
+static volatile uint16_t tick_counts = HAL_TICK_COUNTS;
+
+// Milliseconds per count in 1/2^32, from the tick period
+static uint32_t ms_scale = 0;
+
+// Move on by the period that ended and program the next one (tick ISR)
+void timebase_tick(void)
+{
+    uint16_t fraction = (uint16_t)tick_period;
+    
+    timebase_ticks += tick_counts;
+    tick_seconds++;
+    tick_fraction += fraction;
+    tick_counts = (uint16_t)(tick_period >> 16) + (tick_fraction < fraction);
+    hal_tick_set_period(tick_counts);
+}
+
+// Current time stamp; safe in ISRs
+uint32_t timebase_now(void)
+{
+    uint8_t sreg = hal_irq_save();
+    uint16_t phase = hal_tick_phase();
+    uint32_t now = timebase_ticks;
+    
+    // A compare match not yet handled has already restarted Timer1
+    if (hal_tick_pending() && phase < tick_counts / 2) {
+        phase += tick_counts;
+    }
+    hal_irq_restore(sreg);
+    return now + phase;
+}
+
+// Whole ticks since the tick started: seconds of the tick period
+uint32_t timebase_seconds(void)
+{
+    uint8_t sreg = hal_irq_save();
+    uint32_t seconds = tick_seconds;
+    
+    hal_irq_restore(sreg);
+    return seconds;
+}
+
+// Counts to milliseconds at the tick period, so that a second of stamps
+// is a second of the reference it was measured against. The scale is
+// rounded up so that whole milliseconds do not truncate to one less; it
+// is divided out bit by bit, once per period, and the product is taken
+// from 16 x 16-bit partial products, both in 32 bits.
+uint32_t timebase_to_ms(uint32_t counts)
+{
+    uint32_t remainder = 1000;
+    uint16_t counts_high = counts >> 16;
+    uint16_t counts_low = (uint16_t)counts;
+    uint16_t scale_high;
+    uint16_t scale_low;
+    uint32_t cross;
+    uint32_t middle;
+    
+    if (ms_scale == 0) {
+        // 1000 * 2^48 / tick_period; the remainder stays below 2 * tick_period
+        for (uint8_t bit = 0; bit < 48; bit++) {
+            remainder <<= 1;
+            ms_scale <<= 1;
+            if (remainder >= tick_period) {
+                remainder -= tick_period;
+                ms_scale |= 1;
+            }
+        }
+        ms_scale += (remainder != 0);
+    }
+    
+    // counts * ms_scale / 2^32
+    scale_high = ms_scale >> 16;
+    scale_low = (uint16_t)ms_scale;
+    cross = (uint32_t)counts_high * scale_low;
+    middle = (uint32_t)counts_low * scale_high + (((uint32_t)counts_low * scale_low) >> 16) + (cross & 0xFFFF);
+    return (uint32_t)counts_high * scale_high + (cross >> 16) + (middle >> 16);
+}
+
+// Set the tick period; false (and no change) if it is out of range
+bool timebase_set_period(uint32_t period)
+{
+    uint8_t sreg;
+    int32_t ppm = timebase_period_ppm(period);
+    
+    if (ppm > TIMEBASE_MAX_PPM || ppm < -TIMEBASE_MAX_PPM) {
+        return false;
+    }
+    
+    sreg = hal_irq_save();
+    tick_period = period;
+    hal_irq_restore(sreg);
+    ms_scale = 0;
+    return true;
+}
+
+uint32_t timebase_get_period(void)
+{
+    uint8_t sreg = hal_irq_save();
+    uint32_t period = tick_period;
+    
+    hal_irq_restore(sreg);
+    return period;
+}
+
+// Deviation of a period from the nominal one, in ppm (positive: Timer1
+// runs fast against the reference). The nominal period is F_CPU * 64, so
+// each 1/65536 count of difference is 15625 / F_CPU ppm; the difference
+// is divided by 16 first to keep the product in 32 bits, and saturates
+// at 2^21 (over 1600 ppm up to 20 MHz).
+int32_t timebase_period_ppm(uint32_t period)
+{
+    int32_t offset = (int32_t)(period - TIMEBASE_NOMINAL_PERIOD);
+    
+    if (offset > PPM_CLAMP) {
+        offset = PPM_CLAMP;
+    } else if (offset < -PPM_CLAMP) {
+        offset = -PPM_CLAMP;
+    }
+    return offset / 16 * 15625 / (int32_t)(TIMEBASE_NOMINAL_PERIOD >> 10);
+}
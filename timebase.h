@@ -0,0 +1,31 @@
+#ifndef TIMEBASE_H
+#define TIMEBASE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Monotonic time stamps in Timer1 counts (HAL_TICK_COUNT_US, 128 us) since
+// the tick started: the tick ISR adds the period that ended, the running
+// count the position inside it. 32 bits wrap after 6.3 days; the
+// difference of two stamps stays right across the wrap.
+
+// Tick period in 1/65536 Timer1 counts. Timer1 runs the whole counts and
+// an accumulator adds one count on the periods where the fraction carries,
+// so the tick averages the exact period. The nominal one is a second of
+// the crystal's nominal frequency (7812.5 counts at 8 MHz); calib.c
+// measures the real one against the RTC.
+#define TIMEBASE_NOMINAL_PERIOD     HAL_TICK_RATE_Q16
+
+// Periods further than this from the nominal one are refused
+#define TIMEBASE_MAX_PPM            500
+
+// Function prototypes
+void timebase_tick(void);
+uint32_t timebase_now(void);
+uint32_t timebase_seconds(void);
+uint32_t timebase_to_ms(uint32_t counts);
+bool timebase_set_period(uint32_t period);
+uint32_t timebase_get_period(void);
+int32_t timebase_period_ppm(uint32_t period);
+
+#endif // TIMEBASE_H 
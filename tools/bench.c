@@ -0,0 +1,663 @@
+/*
+ * Cycle benchmark - runs on the build host (make bench).
+ *
+ * Loads the firmware built with -DBENCH into simavr as an ATmega32 at
+ * 8 MHz, runs it for a number of simulated seconds and reports:
+ *
+ *   span    cycles between the BENCH_BEGIN/BENCH_END markers of bench.h.
+ *           "frame" is a main-loop pass that redrew the display.
+ *   isr     per interrupt vector, cycles from the interrupt becoming
+ *           pending to its vector being taken (latency) and to its RETI
+ *   module  flash and SRAM taken by each object file, from the link map
+ *   stack   deepest stack pointer of the run, in bytes below RAMEND; make
+ *           stack gives the worst-case bound to hold it against
+ *
+ * Markers are the firmware's writes to SPDR, time-stamped with simavr's
+ * cycle counter. Markers cost a cycle or two, which stays in the numbers.
+ *
+ * The I2C bus of the host build (host/i2c.c) with its DS1307 and AT24C32
+ * models sits on the bit-banged pins (PC0 SCL, PC1 SDA) behind a
+ * pin-level slave that acknowledges what they do, so rtc_sync() and the
+ * event log do their real work. The keypad columns are held high (no key).
+ *
+ * The report goes to stdout, one record per line: "<kind> <name>" and
+ * key=value fields. With --baseline, each value is followed by its change
+ * against an earlier report, so two commits can be compared.
+ *
+ * Usage: bench [--seconds N] [--map FILE] [--baseline FILE] firmware.elf
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "sim_avr.h"
+#include "sim_elf.h"
+#include "sim_io.h"
+#include "sim_irq.h"
+#include "sim_interrupts.h"
+#include "avr_ioport.h"
+#include "avr_uart.h"
+
+#include "bench.h"
+#include "hal.h"
+#include "host.h"
+
+// Target, as in the Makefile
+#define BENCH_MCU           "atmega32"
+#define BENCH_F_CPU         8000000UL
+#define DEFAULT_SECONDS     10
+
+// ATmega32 data-space addresses (I/O address + 0x20)
+#define SPDR_ADDRESS        0x2F
+#define DDRC_ADDRESS        0x34
+#define PORTC_ADDRESS       0x35
+#define SPL_ADDRESS         0x5D
+#define SPH_ADDRESS         0x5E
+#define RAMEND              0x85F
+
+#define SCL_PIN             0
+#define SDA_PIN             1
+#define COL1_PIN            4
+#define COL2_PIN            5
+
+#define VECTOR_COUNT        21
+#define MODULE_COUNT        64
+#define BASELINE_LINES      256
+
+typedef struct {
+    uint32_t count;
+    uint64_t min;
+    uint64_t max;
+    uint64_t total;
+} stat_t;
+
+static avr_t* avr;
+
+// Spans: open marker per id, and the statistics
+static const char* const span_names[BENCH_SPAN_COUNT] = {
+    "loop", "display", "rtc_sync", "tick_isr"
+};
+static uint64_t span_start[BENCH_SPAN_COUNT];
+static bool span_open[BENCH_SPAN_COUNT];
+static stat_t spans[BENCH_SPAN_COUNT];
+static stat_t frames;
+static bool loop_redrew;
+
+// Interrupts by vector number
+static const char* const vector_names[VECTOR_COUNT] = {
+    "RESET", "INT0", "INT1", "INT2", "TIMER2_COMP", "TIMER2_OVF",
+    "TIMER1_CAPT", "TIMER1_COMPA", "TIMER1_COMPB", "TIMER1_OVF",
+    "TIMER0_COMP", "TIMER0_OVF", "SPI_STC", "USART_RXC", "USART_UDRE",
+    "USART_TXC", "ADC", "EE_RDY", "ANA_COMP", "TWI", "SPM_RDY"
+};
+
+typedef struct {
+    bool pending;
+    uint64_t raised;
+    uint64_t entered;
+    stat_t latency;
+    stat_t duration;
+} vector_t;
+
+static vector_t vectors[VECTOR_COUNT];
+
+// Slave side of the bit-banged I2C bus, in front of the DS1307 model
+enum { I2C_IDLE, I2C_WRITE, I2C_READ, I2C_IGNORE };
+
+static struct {
+    uint8_t state;
+    uint8_t bit;            // Clocks of the current byte; 8 = acknowledge
+    uint8_t shift;          // Byte being received or sent
+    bool address;           // Next byte is the slave address
+    bool acked;             // Acknowledge seen on the last ninth clock
+    bool pull_low;          // We hold SDA low
+    bool scl;
+    bool sda;
+    bool busy;
+    avr_irq_t* scl_irq;
+    avr_irq_t* sda_irq;
+} i2c;
+
+// Report lines of the baseline run
+static char* baseline[BASELINE_LINES];
+static int baseline_count;
+
+static void stat_add(stat_t* stat, uint64_t cycles)
+{
+    if (stat->count == 0 || cycles < stat->min) stat->min = cycles;
+    if (cycles > stat->max) stat->max = cycles;
+    stat->total += cycles;
+    stat->count++;
+}
+
+static void marker_write(avr_t* avr, avr_io_addr_t address, uint8_t value, void* param)
+{
+    uint8_t id = value & ~BENCH_END_FLAG;
+    uint64_t cycles;
+    
+    (void)param;
+    avr->data[address] = value;
+    if (id >= BENCH_SPAN_COUNT) {
+        return;
+    }
+    
+    if (!(value & BENCH_END_FLAG)) {
+        span_start[id] = avr->cycle;
+        span_open[id] = true;
+        if (id == BENCH_LOOP) loop_redrew = false;
+        return;
+    }
+    
+    if (!span_open[id]) {
+        return;
+    }
+    span_open[id] = false;
+    cycles = avr->cycle - span_start[id];
+    stat_add(&spans[id], cycles);
+    
+    if (id == BENCH_DISPLAY && span_open[BENCH_LOOP]) {
+        loop_redrew = true;
+    } else if (id == BENCH_LOOP && loop_redrew) {
+        stat_add(&frames, cycles);
+    }
+}
+
+static void vector_pending(avr_irq_t* irq, uint32_t value, void* param)
+{
+    vector_t* vector = param;
+    
+    (void)irq;
+    if (value && !vector->pending) {
+        vector->raised = avr->cycle;
+    }
+    vector->pending = value != 0;
+}
+
+static void vector_running(avr_irq_t* irq, uint32_t value, void* param)
+{
+    vector_t* vector = param;
+    
+    (void)irq;
+    if (value) {
+        stat_add(&vector->latency, avr->cycle - vector->raised);
+        vector->entered = avr->cycle;
+        vector->pending = false;
+    } else {
+        stat_add(&vector->duration, avr->cycle - vector->entered);
+    }
+}
+
+// The DS1307 model counts virtual microseconds
+uint64_t host_time_us(void)
+{
+    return avr->cycle / (BENCH_F_CPU / 1000000UL);
+}
+
+// The bus model logs the fault injections of scripts, which the bench has none of
+void host_log(const char* format, ...)
+{
+    (void)format;
+}
+
+static void i2c_clock_rise(void)
+{
+    if (i2c.bit < 8) {
+        if (i2c.state != I2C_READ) {
+            i2c.shift = (i2c.shift << 1) | i2c.sda;
+        }
+        i2c.bit++;
+    } else if (i2c.bit == 8) {
+        i2c.acked = !i2c.sda;
+        i2c.bit = 9;
+    }
+}
+
+static void i2c_clock_fall(void)
+{
+    bool acked;
+    
+    if (i2c.bit == 8) {
+        // Byte done: release SDA after a read, acknowledge a write
+        i2c.pull_low = false;
+        if (i2c.state == I2C_READ) {
+            return;
+        }
+        acked = hal_i2c_write(i2c.shift);
+        if (i2c.address) {
+            i2c.address = false;
+            if (!acked) {
+                i2c.state = I2C_IGNORE;
+                return;
+            }
+            if (i2c.shift & 1) {
+                i2c.state = I2C_READ;
+            }
+        }
+        i2c.pull_low = acked;
+        return;
+    }
+    
+    if (i2c.bit == 9) {
+        // The address acknowledge is ours, so the first byte loads as well
+        i2c.bit = 0;
+        i2c.pull_low = false;
+        if (i2c.state == I2C_READ) {
+            if (!i2c.acked) {
+                i2c.state = I2C_IGNORE; // Last byte, the master stops
+                return;
+            }
+            i2c.shift = hal_i2c_read(true);
+        }
+    }
+    
+    if (i2c.state == I2C_READ) {
+        i2c.pull_low = !((i2c.shift >> (7 - i2c.bit)) & 1);
+    }
+}
+
+// Any change of PC0/PC1 or of the port C directions
+static void i2c_pins(avr_irq_t* irq, uint32_t value, void* param)
+{
+    uint8_t ddr = avr->data[DDRC_ADDRESS];
+    uint8_t port = avr->data[PORTC_ADDRESS];
+    bool scl, sda;
+    
+    (void)irq;
+    (void)value;
+    (void)param;
+    if (i2c.busy) {
+        return;
+    }
+    
+    // Open-drain lines with pull-ups: a pin the master makes an output
+    // pulls its line low, a released SCL is high (the slave never
+    // stretches) and a released SDA is high unless we pull it low
+    scl = !(ddr & (1 << SCL_PIN)) || ((port >> SCL_PIN) & 1);
+    if (ddr & (1 << SDA_PIN)) {
+        sda = (port >> SDA_PIN) & 1;
+    } else {
+        sda = !i2c.pull_low;
+    }
+    
+    if (scl != i2c.scl) {
+        i2c.scl = scl;
+        i2c.sda = sda;
+        if (i2c.state != I2C_IDLE && i2c.state != I2C_IGNORE) {
+            if (scl) {
+                i2c_clock_rise();
+            } else {
+                i2c_clock_fall();
+            }
+        }
+    } else if (scl && sda != i2c.sda) {
+        // SDA falling while SCL is high starts a transfer, rising stops it
+        i2c.sda = sda;
+        i2c.bit = 0;
+        i2c.pull_low = false;
+        if (sda) {
+            hal_i2c_stop();
+            i2c.state = I2C_IDLE;
+        } else {
+            hal_i2c_start();
+            i2c.state = I2C_WRITE;
+            i2c.address = true;
+        }
+    } else {
+        i2c.sda = sda;
+    }
+    
+    // Drive the pins the master reads
+    i2c.busy = true;
+    if (!(ddr & (1 << SCL_PIN))) {
+        avr_raise_irq(i2c.scl_irq, 1);
+    }
+    if (!(ddr & (1 << SDA_PIN))) {
+        avr_raise_irq(i2c.sda_irq, !i2c.pull_low);
+    }
+    i2c.busy = false;
+}
+
+static void i2c_attach(void)
+{
+    avr_irq_t* port_c = avr_io_getirq(avr, AVR_IOCTL_IOPORT_GETIRQ('C'), 0);
+    
+    i2c.state = I2C_IDLE;
+    i2c.scl = true;
+    i2c.sda = true;
+    i2c.scl_irq = port_c + SCL_PIN;
+    i2c.sda_irq = port_c + SDA_PIN;
+    
+    avr_irq_register_notify(port_c + SCL_PIN, i2c_pins, NULL);
+    avr_irq_register_notify(port_c + SDA_PIN, i2c_pins, NULL);
+    avr_irq_register_notify(port_c + IOPORT_IRQ_DIRECTION_ALL, i2c_pins, NULL);
+    avr_raise_irq(i2c.scl_irq, 1);
+    avr_raise_irq(i2c.sda_irq, 1);
+    
+    // Same start as the host build
+    hal_i2c_init();
+    at24c32_load(NULL);
+    ds1307_set(2024, 1, 15, 12, 30, 0);
+}
+
+typedef struct {
+    char name[48];
+    unsigned long flash;
+    unsigned long sram;
+} module_t;
+
+static module_t modules[MODULE_COUNT];
+static int module_count;
+
+static bool starts_with(const char* text, const char* prefix)
+{
+    return strncmp(text, prefix, strlen(prefix)) == 0;
+}
+
+// Charge one input section to its object file (archives count as one)
+static void module_add(const char* section, const char* file, unsigned long size)
+{
+    const char* name = file;
+    const char* paren = strchr(file, '(');
+    const char* slash;
+    size_t length;
+    bool flash, sram;
+    int i;
+    
+    flash = starts_with(section, ".text") || starts_with(section, ".progmem") ||
+            starts_with(section, ".vectors") || starts_with(section, ".init") ||
+            starts_with(section, ".fini") || starts_with(section, ".trampolines") ||
+            starts_with(section, ".jumptables") || starts_with(section, ".ctors") ||
+            starts_with(section, ".dtors");
+    sram = starts_with(section, ".bss") || starts_with(section, "COMMON") ||
+           starts_with(section, ".noinit");
+    if (starts_with(section, ".data") || starts_with(section, ".rodata")) {
+        flash = sram = true; // Initial values are copied from flash
+    }
+    if (size == 0 || !(flash || sram)) {
+        return;
+    }
+    
+    length = paren ? (size_t)(paren - file) : strlen(file);
+    for (slash = file; slash < file + length; slash++) {
+        if (*slash == '/') name = slash + 1;
+    }
+    length -= name - file;
+    if (length >= sizeof(modules[0].name)) {
+        length = sizeof(modules[0].name) - 1;
+    }
+    
+    for (i = 0; i < module_count; i++) {
+        if (strlen(modules[i].name) == length && strncmp(modules[i].name, name, length) == 0) {
+            break;
+        }
+    }
+    if (i == module_count) {
+        if (module_count == MODULE_COUNT) return;
+        memcpy(modules[i].name, name, length);
+        modules[i].name[length] = '\0';
+        module_count++;
+    }
+    
+    if (flash) modules[i].flash += size;
+    if (sram) modules[i].sram += size;
+}
+
+// Input sections are " .name 0xaddr 0xsize file", with a long name on a
+// line of its own; everything before the memory map lists discarded ones
+static bool read_map(const char* path)
+{
+    FILE* map = fopen(path, "r");
+    char line[512];
+    char section[256] = "";
+    char name[256], file[256];
+    unsigned long address, size;
+    bool in_map = false;
+    int fields;
+    
+    if (map == NULL) {
+        perror(path);
+        return false;
+    }
+    
+    while (fgets(line, sizeof(line), map) != NULL) {
+        if (!in_map) {
+            in_map = starts_with(line, "Linker script and memory map");
+            continue;
+        }
+    
+        if (line[0] == ' ' && (line[1] == '.' || starts_with(line + 1, "COMMON"))) {
+            fields = sscanf(line, " %255s 0x%lx 0x%lx %255s", name, &address, &size, file);
+            strcpy(section, name);
+            if (fields < 4) continue;
+        } else if (section[0] == '\0' ||
+                   sscanf(line, " 0x%lx 0x%lx %255s", &address, &size, file) != 3) {
+            section[0] = '\0';
+            continue;
+        }
+    
+        module_add(section, file, size);
+        section[0] = '\0';
+    }
+    
+    fclose(map);
+    return true;
+}
+
+static void read_baseline(const char* path)
+{
+    FILE* file = fopen(path, "r");
+    char line[512];
+    
+    if (file == NULL) {
+        perror(path);
+        exit(2);
+    }
+    while (baseline_count < BASELINE_LINES && fgets(line, sizeof(line), file) != NULL) {
+        baseline[baseline_count++] = strdup(line);
+    }
+    fclose(file);
+}
+
+// Value of "key" on the baseline line of the same record, if any
+static bool baseline_value(const char* record, const char* key, unsigned long long* value)
+{
+    size_t length = strlen(record);
+    char pattern[64];
+    const char* field;
+    int i;
+    
+    snprintf(pattern, sizeof(pattern), " %s=", key);
+    for (i = 0; i < baseline_count; i++) {
+        if (strncmp(baseline[i], record, length) == 0 && baseline[i][length] == ' ') {
+            field = strstr(baseline[i], pattern);
+            if (field == NULL) return false;
+            *value = strtoull(field + strlen(pattern), NULL, 10);
+            return true;
+        }
+    }
+    return false;
+}
+
+// One record: "<kind> <name>" and n key=value fields
+static void report(const char* kind, const char* name, const char* const keys[],
+                   const unsigned long long values[], int n)
+{
+    char record[96];
+    unsigned long long old;
+    int i;
+    
+    snprintf(record, sizeof(record), "%-7s %-14s", kind, name);
+    fputs(record, stdout);
+    for (i = 0; i < n; i++) {
+        printf(" %s=%llu", keys[i], values[i]);
+        if (baseline_count > 0 && baseline_value(record, keys[i], &old) && old != values[i]) {
+            if (old == 0) {
+                printf(" (new)");
+            } else {
+                printf(" (%+.1f%%)", 100.0 * ((double)values[i] - (double)old) / (double)old);
+            }
+        }
+    }
+    putchar('\n');
+}
+
+static void report_stat(const char* kind, const char* name, const stat_t* stat)
+{
+    static const char* const keys[] = {"count", "min", "avg", "max"};
+    unsigned long long values[4];
+    
+    values[0] = stat->count;
+    values[1] = stat->min;
+    values[2] = stat->count ? stat->total / stat->count : 0;
+    values[3] = stat->max;
+    report(kind, name, keys, values, 4);
+}
+
+static void report_vector(int number, const vector_t* vector)
+{
+    static const char* const keys[] = {
+        "count", "latency_avg", "latency_max", "cycles_avg", "cycles_max"
+    };
+    unsigned long long values[5];
+    
+    values[0] = vector->latency.count;
+    values[1] = vector->latency.total / vector->latency.count;
+    values[2] = vector->latency.max;
+    values[3] = vector->duration.count ? vector->duration.total / vector->duration.count : 0;
+    values[4] = vector->duration.max;
+    report("isr", vector_names[number], keys, values, 5);
+}
+
+static void report_module(const char* name, unsigned long flash, unsigned long sram)
+{
+    static const char* const keys[] = {"flash", "sram"};
+    unsigned long long values[2];
+    
+    values[0] = flash;
+    values[1] = sram;
+    report("module", name, keys, values, 2);
+}
+
+static void report_stack(unsigned long used)
+{
+    static const char* const keys[] = {"used"};
+    unsigned long long values[1];
+    
+    values[0] = used;
+    report("stack", "high_water", keys, values, 1);
+}
+
+static void usage(const char* program)
+{
+    fprintf(stderr, "usage: %s [--seconds N] [--map FILE] [--baseline FILE] firmware.elf\n", program);
+    exit(2);
+}
+
+int main(int argc, char** argv)
+{
+    const char* elf = NULL;
+    const char* map = NULL;
+    unsigned long seconds = DEFAULT_SECONDS;
+    unsigned long flash = 0, sram = 0;
+    elf_firmware_t firmware;
+    avr_irq_t* irq;
+    uint64_t end;
+    uint32_t uart_flags = 0;
+    uint16_t sp, lowest_sp = RAMEND;
+    int state = cpu_Running;
+    int i;
+    
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc) {
+            seconds = strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--map") == 0 && i + 1 < argc) {
+            map = argv[++i];
+        } else if (strcmp(argv[i], "--baseline") == 0 && i + 1 < argc) {
+            read_baseline(argv[++i]);
+        } else if (argv[i][0] != '-' && elf == NULL) {
+            elf = argv[i];
+        } else {
+            usage(argv[0]);
+        }
+    }
+    if (elf == NULL || seconds == 0) {
+        usage(argv[0]);
+    }
+    
+    memset(&firmware, 0, sizeof(firmware));
+    if (elf_read_firmware(elf, &firmware) != 0) {
+        fprintf(stderr, "%s: cannot load %s\n", argv[0], elf);
+        return 2;
+    }
+    strcpy(firmware.mmcu, BENCH_MCU);
+    firmware.frequency = BENCH_F_CPU;
+    
+    avr = avr_make_mcu_by_name(BENCH_MCU);
+    if (avr == NULL || avr_init(avr) != 0) {
+        fprintf(stderr, "%s: simavr has no %s\n", argv[0], BENCH_MCU);
+        return 2;
+    }
+    avr_load_firmware(avr, &firmware);
+    
+    avr_register_io_write(avr, SPDR_ADDRESS, marker_write, NULL);
+    
+    for (i = 1; i < VECTOR_COUNT; i++) {
+        irq = avr_get_interrupt_irq(avr, i);
+        if (irq != NULL) {
+            avr_irq_register_notify(irq + AVR_INT_IRQ_PENDING, vector_pending, &vectors[i]);
+            avr_irq_register_notify(irq + AVR_INT_IRQ_RUNNING, vector_running, &vectors[i]);
+        }
+    }
+    
+    // No key pressed: the column inputs read high
+    irq = avr_io_getirq(avr, AVR_IOCTL_IOPORT_GETIRQ('B'), 0);
+    avr_raise_irq(irq + COL1_PIN, 1);
+    avr_raise_irq(irq + COL2_PIN, 1);
+    
+    i2c_attach();
+    
+    // The firmware's telemetry console stays off the terminal
+    avr_ioctl(avr, AVR_IOCTL_UART_GET_FLAGS('0'), &uart_flags);
+    uart_flags &= ~AVR_UART_FLAG_STDIO;
+    avr_ioctl(avr, AVR_IOCTL_UART_SET_FLAGS('0'), &uart_flags);
+    
+    end = (uint64_t)seconds * BENCH_F_CPU;
+    while (avr->cycle < end && state != cpu_Done && state != cpu_Crashed) {
+        state = avr_run(avr);
+        sp = avr->data[SPL_ADDRESS] | (avr->data[SPH_ADDRESS] << 8);
+        if (sp < lowest_sp) lowest_sp = sp;
+    }
+    if (state == cpu_Crashed) {
+        fprintf(stderr, "%s: firmware crashed at PC 0x%04x\n", argv[0], (unsigned)avr->pc);
+        return 1;
+    }
+    
+    printf("# %s, %lu s at %lu Hz on %s\n", elf, seconds, BENCH_F_CPU, BENCH_MCU);
+    for (i = 0; i < BENCH_SPAN_COUNT; i++) {
+        report_stat("span", span_names[i], &spans[i]);
+    }
+    report_stat("span", "frame", &frames);
+    report_stack(RAMEND - lowest_sp);
+    
+    for (i = 1; i < VECTOR_COUNT; i++) {
+        if (vectors[i].latency.count > 0) {
+            report_vector(i, &vectors[i]);
+        }
+    }
+    
+    if (map != NULL) {
+        if (!read_map(map)) {
+            return 2;
+        }
+        for (i = 0; i < module_count; i++) {
+            report_module(modules[i].name, modules[i].flash, modules[i].sram);
+            flash += modules[i].flash;
+            sram += modules[i].sram;
+        }
+        report_module("total", flash, sram);
+    }
+    
+    return 0;
+}
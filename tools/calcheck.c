@@ -0,0 +1,105 @@
+/*
+ * Calendar table check - runs on the build host.
+ *
+ * Links time_utils.c against the generated calendar_tables.c and compares
+ * every date of the table range, 2000-01-01 to 2136-12-31, with plain
+ * Gregorian arithmetic: 2100 is the one common century year in it, and the
+ * 32-bit epoch ends in 2136. Every day the epoch reaches is converted back
+ * at its first and last second, and every second of a day to a time.
+ * Exits non-zero on the first mismatch so the build stops.
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "time_utils.h"
+
+#define FIRST_YEAR  2000
+#define LAST_YEAR   2136
+#define LAST_DAY    (UINT32_MAX / EPOCH_SECONDS_PER_DAY)    // 2136-02-07
+
+static int is_leap(int year)
+{
+    return (year % 4 == 0 && year % 100 != 0) || (year % 400 == 0);
+}
+
+static int month_length(int month, int year)
+{
+    static const int days[] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+    
+    return (month == 2 && is_leap(year)) ? 29 : days[month - 1];
+}
+
+static int fail(const char* what, int year, int month, int day)
+{
+    fprintf(stderr, "calcheck: %s mismatch at %04d-%02d-%02d\n", what, year, month, day);
+    return 1;
+}
+
+int main(void)
+{
+    long days = 0;
+    int weekday = 5;                        // 2000-01-01 was a Saturday
+    int year, month, day;
+    uint32_t second;
+    
+    for (second = 0; second < EPOCH_SECONDS_PER_DAY; second++) {
+        time_t time;
+        
+        seconds_to_time(second, &time.hour, &time.minute, &time.second);
+        if (time.hour != second / 3600 || time.minute != second / 60 % 60 || time.second != second % 60) {
+            fprintf(stderr, "calcheck: seconds_to_time mismatch at %lu\n", (unsigned long)second);
+            return 1;
+        }
+    }
+    
+    for (year = FIRST_YEAR; year <= LAST_YEAR; year++) {
+        int yday = 0;
+        
+        if (is_leap_year(year) != (bool)is_leap(year)) return fail("is_leap_year", year, 1, 1);
+        
+        for (month = 1; month <= 12; month++) {
+            if (days_in_month(month, year) != month_length(month, year)) {
+                return fail("days_in_month", year, month, 1);
+            }
+            
+            for (day = 1; day <= month_length(month, year); day++) {
+                date_t date = {day, month, year};
+                date_t back;
+                
+                yday++;
+                if (days_from_civil(year, month, day) != days) return fail("days_from_civil", year, month, day);
+                civil_from_days(days, &back);
+                if (back.day != day || back.month != month || back.year != year) {
+                    return fail("civil_from_days", year, month, day);
+                }
+                if (day_of_week(day, month, year) != weekday) return fail("day_of_week", year, month, day);
+                if (days <= (long)LAST_DAY) {
+                    epoch_t first = (epoch_t)days * EPOCH_SECONDS_PER_DAY;
+                    epoch_t last = first + (days < (long)LAST_DAY ? 86399 : UINT32_MAX - first);
+                    time_t time;
+                    
+                    if (epoch_weekday(first) != weekday || epoch_weekday(last) != weekday) {
+                        return fail("epoch_weekday", year, month, day);
+                    }
+                    epoch_to_datetime(first, &back, &time);
+                    if (back.day != day || back.month != month || back.year != year ||
+                        time.hour != 0 || time.minute != 0 || time.second != 0) {
+                        return fail("epoch_to_datetime", year, month, day);
+                    }
+                    epoch_to_datetime(last, &back, &time);
+                    if (back.day != day || back.month != month || back.year != year ||
+                        time_to_seconds(time.hour, time.minute, time.second) != last - first) {
+                        return fail("epoch_to_datetime", year, month, day);
+                    }
+                }
+                if (day_of_year(&date) != yday) return fail("day_of_year", year, month, day);
+                
+                days++;
+                weekday = (weekday + 1) % 7;
+            }
+        }
+    }
+    
+    printf("calcheck: %ld days OK\n", days);
+    return 0;
+}
@@ -0,0 +1,68 @@
+/*
+ * Calendar table generator - runs on the build host.
+ *
+ * Writes calendar_tables.c (see calendar_tables.h) to stdout using plain
+ * Gregorian arithmetic, so the firmware resolves calendar queries with
+ * PROGMEM lookups instead of the leap-year modulo chain.
+ */
+#include <stdio.h>
+#include <stdint.h>
+
+#define FIRST_YEAR  2000
+#define YEARS       137     // To 2136, the end of the 32-bit epoch
+
+static int is_leap(int year)
+{
+    return (year % 4 == 0 && year % 100 != 0) || (year % 400 == 0);
+}
+
+static int month_length(int month, int year)
+{
+    static const int days[] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+    
+    return (month == 2 && is_leap(year)) ? 29 : days[month - 1];
+}
+
+int main(void)
+{
+    long days = 0;
+    int leap, month, year;
+    
+    printf("/* Generated by tools/calgen.c - do not edit */\n");
+    printf("#include \"calendar_tables.h\"\n\n");
+    
+    printf("const uint16_t calendar_days_before_month[2][13] PROGMEM = {\n");
+    for (leap = 0; leap < 2; leap++) {
+        int total = 0;
+        
+        printf("    {");
+        for (month = 1; month <= 13; month++) {
+            printf("%d%s", total, month < 13 ? ", " : "");
+            if (month <= 12) {
+                total += month_length(month, leap ? 2000 : 2001);
+            }
+        }
+        printf("}%s\n", leap == 0 ? "," : "");
+    }
+    printf("};\n\n");
+    
+    printf("const uint16_t calendar_year_start[CALENDAR_YEARS + 1] PROGMEM = {");
+    for (year = FIRST_YEAR; year <= FIRST_YEAR + YEARS; year++) {
+        printf("%s%ld%s", (year - FIRST_YEAR) % 10 == 0 ? "\n    " : " ",
+               days, year < FIRST_YEAR + YEARS ? "," : "");
+        days += is_leap(year) ? 366 : 365;
+    }
+    printf("\n};\n\n");
+    
+    // 2000-01-01 was a Saturday (5 with Monday = 0)
+    days = 0;
+    printf("const uint8_t calendar_jan1_weekday[CALENDAR_YEARS] PROGMEM = {");
+    for (year = FIRST_YEAR; year < FIRST_YEAR + YEARS; year++) {
+        printf("%s%ld%s", (year - FIRST_YEAR) % 20 == 0 ? "\n    " : " ",
+               (days + 5) % 7, year < FIRST_YEAR + YEARS - 1 ? "," : "");
+        days += is_leap(year) ? 366 : 365;
+    }
+    printf("\n};\n");
+    
+    return 0;
+}
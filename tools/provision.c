@@ -0,0 +1,507 @@
+/*
+ * Provisioning tool - runs on a PC with the unit's USART on a serial port.
+ *
+ * Speaks the framed protocol of provision.h:
+ *
+ *   read                       clock (UTC), zone, countdown preset, alarms
+ *   counters                   the firmware's error and traffic counters
+ *   sync                       set the clock to this computer's UTC time
+ *   zone N                     select time zone N (tz.c table index)
+ *   countdown SECONDS          set the countdown preset
+ *   alarm SLOT HH:MM DAYS on|off [repeat]
+ *                              set an alarm; DAYS as shown by read, e.g.
+ *                              MTWTF-- (a letter per day that rings)
+ *   trace SECONDS FILE         collect trace records for SECONDS into FILE
+ *                              (TRACE firmware), for tools/tracedec
+ *   log                        the event log in the RTC module's EEPROM,
+ *                              newest first
+ *   i2c                        NACKs, timeouts and bus clears per I2C device
+ *
+ * sync starts sending half a second before a whole second of the PC clock
+ * and asks the firmware to write the RTC at that second, counted from the
+ * end of the frame. With the frame's transfer time taken out, the unit is
+ * off by the serial latency only (a few milliseconds on a USB adapter);
+ * keep the PC clock disciplined by NTP. The other writes read the
+ * snapshot first and send it back with one part changed.
+ *
+ * Usage: provision [--port DEVICE] COMMAND [ARGUMENTS]
+ */
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <termios.h>
+#include <unistd.h>
+
+#define DEFAULT_PORT        "/dev/ttyUSB0"
+#define BAUD                B38400
+#define BYTE_US             261         // 10 bits at 38400 baud
+#define REPLY_TIMEOUT_MS    2000
+#define EPOCH_2000          946684800L  // Firmware epoch in Unix time
+#define SEND_BEFORE_US      500000L     // How long before the second sync sends
+
+// Protocol of provision.h (not included: its rtc.h time_t clashes with
+// <time.h>)
+#define SYNC                0xA5
+#define REPLY               0x80
+#define CMD_READ            0x01
+#define CMD_WRITE           0x02
+#define CMD_COUNTERS        0x03
+#define CMD_TRACE           0x04
+#define CMD_LOG             0x05
+#define CMD_I2C             0x06
+#define PART_CLOCK          0x01
+#define PART_ALARMS         0x02
+#define PART_SETTINGS       0x04
+#define ALARM_COUNT         4
+#define ALARM_ENABLED       0x01
+#define ALARM_REPEAT        0x02
+#define PAYLOAD_MAX         32
+#define TRACE_RECORD_SIZE   5           // trace_record_t
+#define TRACE_POLL_US       20000L      // The 64-record ring fills in ~0.2 s at worst
+#define STATUS_VALUE        4           // Past the oldest log page
+#define STATUS_BUSY         6           // Log EEPROM in its write cycle
+#define BUSY_RETRY_US       10000L      // Longer than the 5-10 ms write cycle
+#define LOG_PAGES           128
+#define LOG_PAGE_RECORDS    4
+#define EVENT_TIME_CHANGED  2           // Argument: signed seconds
+#define I2C_DEVICES         4
+
+typedef struct {
+    uint8_t hour;
+    uint8_t minute;
+    uint8_t days;
+    uint8_t flags;
+} __attribute__((packed)) alarm_t;
+
+typedef struct {
+    uint32_t epoch;
+    uint8_t zone;
+    uint16_t countdown_preset;
+    alarm_t alarms[ALARM_COUNT];
+} __attribute__((packed)) snapshot_t;
+
+typedef struct {
+    uint8_t parts;
+    uint16_t delay_ms;
+    snapshot_t snapshot;
+} __attribute__((packed)) write_t;
+
+typedef struct {
+    uint16_t frames;
+    uint16_t frame_errors;
+    uint16_t uart_overruns;
+    uint16_t telemetry_dropped;
+    uint16_t rtc_read_errors;
+    uint16_t stack_used;
+    uint16_t log_dropped;
+    uint16_t log_errors;
+} __attribute__((packed)) counters_t;
+
+// I2C health of one device (i2c_bus.h)
+typedef struct {
+    uint8_t address;
+    uint16_t nacks;
+    uint16_t timeouts;
+    uint16_t recoveries;
+} __attribute__((packed)) i2c_counters_t;
+
+// Event log page of eventlog.h, without its CRC
+typedef struct {
+    uint32_t epoch;
+    uint8_t id;
+    uint16_t arg;
+} __attribute__((packed)) log_record_t;
+
+typedef struct {
+    uint16_t sequence;
+    uint8_t count;
+    log_record_t records[LOG_PAGE_RECORDS];
+} __attribute__((packed)) log_page_t;
+
+static const char* const status_names[] = {
+    "ok", "CRC error", "unknown command", "bad length", "bad value", "late", "busy"
+};
+static const char day_letters[] = "MTWTFSS";
+static const char* const event_names[] = {
+    "?", "power up", "time changed", "alarm", "countdown", "i2c error"
+};
+
+static int port = -1;
+
+// CRC-8 of settings_crc8()
+static uint8_t crc8(const uint8_t* data, uint8_t length)
+{
+    uint8_t crc = 0;
+    
+    while (length--) {
+        crc ^= *data++;
+        for (uint8_t bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x01) ? (crc >> 1) ^ 0x8C : (crc >> 1);
+        }
+    }
+    return crc;
+}
+
+static int64_t now_us(void)
+{
+    struct timespec now;
+    
+    clock_gettime(CLOCK_REALTIME, &now);
+    return (int64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+static void open_port(const char* device)
+{
+    struct termios tty;
+    
+    port = open(device, O_RDWR | O_NOCTTY);
+    if (port < 0 || tcgetattr(port, &tty) != 0) {
+        perror(device);
+        exit(1);
+    }
+    cfmakeraw(&tty);
+    cfsetispeed(&tty, BAUD);
+    cfsetospeed(&tty, BAUD);
+    tty.c_cc[VMIN] = 0;
+    tty.c_cc[VTIME] = 1;                // Reads return after 100 ms
+    tcsetattr(port, TCSANOW, &tty);
+    tcflush(port, TCIOFLUSH);
+}
+
+// Frame and send a command
+static void send_frame(uint8_t command, const void* payload, uint8_t length)
+{
+    uint8_t frame[PAYLOAD_MAX + 4];
+    
+    frame[0] = SYNC;
+    frame[1] = length + 1;
+    frame[2] = command;
+    if (length > 0) {
+        memcpy(&frame[3], payload, length);
+    }
+    frame[length + 3] = crc8(&frame[1], length + 2);
+    if (write(port, frame, length + 4) != length + 4) {
+        perror("write");
+        exit(1);
+    }
+}
+
+static bool read_byte(uint8_t* data, int64_t deadline)
+{
+    while (now_us() < deadline) {
+        if (read(port, data, 1) == 1) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Wait for the reply to a command, skipping telemetry lines. Returns the
+// status and copies the payload after it, of up to max bytes.
+static uint8_t receive_reply_upto(uint8_t command, void* payload, uint8_t max, uint8_t* length)
+{
+    int64_t deadline = now_us() + REPLY_TIMEOUT_MS * 1000L;
+    uint8_t frame[PAYLOAD_MAX + 3];
+    uint8_t data;
+    
+    while (read_byte(&data, deadline)) {
+        if (data != SYNC || !read_byte(&frame[0], deadline) ||
+            frame[0] < 2 || frame[0] > PAYLOAD_MAX + 1) {
+            continue;
+        }
+        for (uint8_t i = 1; i < frame[0] + 2; i++) {
+            if (!read_byte(&frame[i], deadline)) {
+                break;
+            }
+        }
+        if (frame[frame[0] + 1] != crc8(frame, frame[0] + 1) || frame[1] != (command | REPLY)) {
+            continue;
+        }
+        *length = frame[0] - 2;
+        if (frame[2] == 0 && *length > max) {
+            fprintf(stderr, "reply of %u bytes, expected at most %u\n", *length, max);
+            exit(1);
+        }
+        if (frame[2] == 0) {
+            memcpy(payload, &frame[3], *length);
+        }
+        return frame[2];
+    }
+    fprintf(stderr, "no reply\n");
+    exit(1);
+}
+
+static uint8_t receive_reply(uint8_t command, void* payload, uint8_t length)
+{
+    uint8_t received;
+    uint8_t status = receive_reply_upto(command, payload, length, &received);
+    
+    if (status == 0 && received != length) {
+        fprintf(stderr, "reply of %u bytes, expected %u\n", received, length);
+        exit(1);
+    }
+    return status;
+}
+
+static void check_status(uint8_t status)
+{
+    if (status != 0) {
+        fprintf(stderr, "unit replied: %s\n",
+                status < sizeof(status_names) / sizeof(status_names[0]) ? status_names[status] : "?");
+        exit(1);
+    }
+}
+
+static void read_snapshot(snapshot_t* snapshot)
+{
+    send_frame(CMD_READ, NULL, 0);
+    check_status(receive_reply(CMD_READ, snapshot, sizeof(*snapshot)));
+}
+
+static void write_snapshot(uint8_t parts, uint16_t delay_ms, const snapshot_t* snapshot)
+{
+    write_t request;
+    
+    request.parts = parts;
+    request.delay_ms = delay_ms;
+    request.snapshot = *snapshot;
+    send_frame(CMD_WRITE, &request, sizeof(request));
+    check_status(receive_reply(CMD_WRITE, NULL, 0));
+}
+
+static void print_snapshot(const snapshot_t* snapshot)
+{
+    time_t unix_time = (time_t)snapshot->epoch + EPOCH_2000;
+    struct tm utc;
+    char text[32];
+    
+    gmtime_r(&unix_time, &utc);
+    strftime(text, sizeof(text), "%Y-%m-%d %H:%M:%S", &utc);
+    printf("clock     %s UTC\n", text);
+    printf("zone      %u\n", snapshot->zone);
+    printf("countdown %u:%02u\n", snapshot->countdown_preset / 60, snapshot->countdown_preset % 60);
+    for (int i = 0; i < ALARM_COUNT; i++) {
+        const alarm_t* alarm = &snapshot->alarms[i];
+        
+        printf("alarm %d   %02u:%02u ", i + 1, alarm->hour, alarm->minute);
+        for (int day = 0; day < 7; day++) {
+            putchar((alarm->days & (1 << day)) ? day_letters[day] : '-');
+        }
+        printf(" %s%s\n", (alarm->flags & ALARM_ENABLED) ? "on" : "off",
+               (alarm->flags & ALARM_REPEAT) ? " repeat" : "");
+    }
+}
+
+// Set the clock at the next whole second of the PC clock
+static void sync_clock(void)
+{
+    snapshot_t snapshot;
+    write_t request;
+    int64_t start, boundary, frame_end;
+    
+    memset(&snapshot, 0, sizeof(snapshot));
+    
+    // Send half a second ahead, leaving the firmware time to reach the frame
+    start = now_us();
+    boundary = (start + SEND_BEFORE_US) / 1000000 * 1000000 + 1000000;
+    usleep((useconds_t)(boundary - SEND_BEFORE_US - start));
+    
+    start = now_us();
+    frame_end = start + (int64_t)(sizeof(request) + 4) * BYTE_US;
+    request.parts = PART_CLOCK;
+    request.delay_ms = (uint16_t)((boundary - frame_end) / 1000);
+    request.snapshot = snapshot;
+    request.snapshot.epoch = (uint32_t)(boundary / 1000000 - EPOCH_2000);
+    send_frame(CMD_WRITE, &request, sizeof(request));
+    check_status(receive_reply(CMD_WRITE, NULL, 0));
+    
+    read_snapshot(&snapshot);
+    print_snapshot(&snapshot);
+}
+
+// Append trace records to a file until the time is up. A reply carries
+// lost (u16), count (u8) and count records; an empty ring is polled
+// again after a pause.
+static void collect_trace(int seconds, const char* path)
+{
+    int64_t end = now_us() + (int64_t)seconds * 1000000;
+    uint8_t reply[PAYLOAD_MAX];
+    uint8_t length;
+    unsigned long records = 0;
+    unsigned lost = 0;
+    FILE* file = fopen(path, "wb");
+    
+    if (file == NULL) {
+        perror(path);
+        exit(1);
+    }
+    while (now_us() < end) {
+        send_frame(CMD_TRACE, NULL, 0);
+        check_status(receive_reply_upto(CMD_TRACE, reply, sizeof(reply), &length));
+        if (length < 3 || length != 3 + reply[2] * TRACE_RECORD_SIZE) {
+            fprintf(stderr, "bad trace reply\n");
+            exit(1);
+        }
+        lost = reply[0] | (reply[1] << 8);
+        fwrite(&reply[3], TRACE_RECORD_SIZE, reply[2], file);
+        records += reply[2];
+        if (reply[2] == 0) {
+            usleep(TRACE_POLL_US);
+        }
+    }
+    fclose(file);
+    printf("%lu records, %u lost since boot\n", records, lost);
+}
+
+// Print the event log page by page, newest first, until the unit has no
+// older page
+static void print_log(void)
+{
+    log_page_t page;
+    
+    for (uint8_t back = 0; back < LOG_PAGES; back++) {
+        uint8_t status;
+        
+        // A page read during the EEPROM's write cycle is asked again
+        for (;;) {
+            send_frame(CMD_LOG, &back, 1);
+            status = receive_reply(CMD_LOG, &page, sizeof(page));
+            if (status != STATUS_BUSY) {
+                break;
+            }
+            usleep(BUSY_RETRY_US);
+        }
+        if (status == STATUS_VALUE) {
+            break;
+        }
+        check_status(status);
+        for (int i = page.count - 1; i >= 0; i--) {
+            const log_record_t* record = &page.records[i];
+            time_t unix_time = (time_t)record->epoch + EPOCH_2000;
+            struct tm utc;
+            char text[32];
+            
+            gmtime_r(&unix_time, &utc);
+            strftime(text, sizeof(text), "%Y-%m-%d %H:%M:%S", &utc);
+            printf("%s  %-12s ", text,
+                   record->id < sizeof(event_names) / sizeof(event_names[0]) ? event_names[record->id] : "?");
+            if (record->id == EVENT_TIME_CHANGED) {
+                printf("%+d s\n", (int16_t)record->arg);
+            } else {
+                printf("%u\n", record->arg);
+            }
+        }
+    }
+}
+
+// Print the I2C counters of the devices the firmware has talked to
+static void print_i2c(void)
+{
+    i2c_counters_t devices[I2C_DEVICES];
+    
+    send_frame(CMD_I2C, NULL, 0);
+    check_status(receive_reply(CMD_I2C, devices, sizeof(devices)));
+    printf("address  nacks  timeouts  recoveries\n");
+    for (int i = 0; i < I2C_DEVICES; i++) {
+        if (devices[i].address != 0) {
+            printf("0x%02x     %5u  %8u  %10u\n", devices[i].address, devices[i].nacks,
+                   devices[i].timeouts, devices[i].recoveries);
+        }
+    }
+}
+
+static void usage(const char* program)
+{
+    fprintf(stderr,
+            "usage: %s [--port DEVICE] read | counters | sync | zone N | countdown SECONDS\n"
+            "       | alarm SLOT HH:MM DAYS on|off [repeat] | trace SECONDS FILE | log | i2c\n", program);
+    exit(2);
+}
+
+int main(int argc, char** argv)
+{
+    const char* program = argv[0];
+    const char* device = DEFAULT_PORT;
+    const char* command;
+    snapshot_t snapshot;
+    counters_t counters;
+    int first = 1;
+    
+    if (argc > 2 && strcmp(argv[1], "--port") == 0) {
+        device = argv[2];
+        first = 3;
+    }
+    if (first >= argc) {
+        usage(program);
+    }
+    command = argv[first];
+    argc -= first;
+    argv += first;
+    open_port(device);
+    
+    if (strcmp(command, "read") == 0 && argc == 1) {
+        read_snapshot(&snapshot);
+        print_snapshot(&snapshot);
+    } else if (strcmp(command, "counters") == 0 && argc == 1) {
+        send_frame(CMD_COUNTERS, NULL, 0);
+        check_status(receive_reply(CMD_COUNTERS, &counters, sizeof(counters)));
+        printf("frames            %u\n", counters.frames);
+        printf("frame_errors      %u\n", counters.frame_errors);
+        printf("uart_overruns     %u\n", counters.uart_overruns);
+        printf("telemetry_dropped %u\n", counters.telemetry_dropped);
+        printf("rtc_read_errors   %u\n", counters.rtc_read_errors);
+        printf("stack_used        %u\n", counters.stack_used);
+        printf("log_dropped       %u\n", counters.log_dropped);
+        printf("log_errors        %u\n", counters.log_errors);
+    } else if (strcmp(command, "sync") == 0 && argc == 1) {
+        sync_clock();
+    } else if (strcmp(command, "zone") == 0 && argc == 2) {
+        read_snapshot(&snapshot);
+        snapshot.zone = (uint8_t)atoi(argv[1]);
+        write_snapshot(PART_SETTINGS, 0, &snapshot);
+    } else if (strcmp(command, "countdown") == 0 && argc == 2) {
+        read_snapshot(&snapshot);
+        snapshot.countdown_preset = (uint16_t)atoi(argv[1]);
+        write_snapshot(PART_SETTINGS, 0, &snapshot);
+    } else if (strcmp(command, "trace") == 0 && argc == 3) {
+        collect_trace(atoi(argv[1]), argv[2]);
+    } else if (strcmp(command, "log") == 0 && argc == 1) {
+        print_log();
+    } else if (strcmp(command, "i2c") == 0 && argc == 1) {
+        print_i2c();
+    } else if (strcmp(command, "alarm") == 0 && (argc == 5 || argc == 6)) {
+        int slot = atoi(argv[1]);
+        unsigned hour, minute;
+        alarm_t* alarm;
+        
+        if (slot < 1 || slot > ALARM_COUNT || sscanf(argv[2], "%u:%u", &hour, &minute) != 2 ||
+            strlen(argv[3]) != 7 ||
+            (strcmp(argv[4], "on") != 0 && strcmp(argv[4], "off") != 0) || (argc == 6 && strcmp(argv[5], "repeat") != 0)) {
+            usage(program);
+        }
+        read_snapshot(&snapshot);
+        alarm = &snapshot.alarms[slot - 1];
+        alarm->hour = (uint8_t)hour;
+        alarm->minute = (uint8_t)minute;
+        alarm->days = 0;
+        for (int day = 0; day < 7; day++) {
+            if (argv[3][day] != '-') {
+                alarm->days |= 1 << day;
+            }
+        }
+        alarm->flags = (strcmp(argv[4], "on") == 0) ? ALARM_ENABLED : 0;
+        if (argc == 6) {
+            alarm->flags |= ALARM_REPEAT;
+        }
+        write_snapshot(PART_ALARMS, 0, &snapshot);
+    } else {
+        usage(program);
+    }
+    
+    close(port);
+    return 0;
+}
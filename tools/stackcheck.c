@@ -0,0 +1,434 @@
+/*
+ * Stack bound - runs on the build host (make stack).
+ *
+ * Combines the per-function frame sizes of -fstack-usage (.su files) with
+ * the call graph of the linked firmware (avr-objdump -d -t on stdin) into
+ * a worst-case stack depth for main and each interrupt vector, and sets
+ * it against the SRAM left between the end of .bss and RAMEND.
+ *
+ *   entry   <name>         bound=<bytes> path=<deepest call chain>
+ *   total   main+isr       bound=<bytes> sram=<bytes> margin=<bytes>
+ *
+ * The total is main's bound plus the deepest ISR's: ISRs run with
+ * interrupts masked, so they do not nest. --measured adds a high-water
+ * mark (make bench, or the unit's counters) to the total line.
+ *
+ * A .su size already counts the return address and the saved registers.
+ * Functions without one (avr-libc, the C runtime) are estimated from
+ * their prologue: return address, pushes and the frame set up in Y.
+ * A tail jump costs its target's depth; calls through a pointer (icall)
+ * cannot be followed and are listed, as are recursive calls. --icall
+ * PREFIX=FILE takes those in functions named PREFIX... to reach every
+ * function of FILE, such as the hooks of a table of modes.
+ *
+ * Usage: avr-objdump -d -t firmware.elf |
+ *        stackcheck [--measured N] [--icall PREFIX=FILE]... FILE.su...
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#define DEFAULT_RAMEND      0x85F       // ATmega32, when __stack is missing
+#define FUNCTION_COUNT      512
+#define CALL_COUNT          4096
+#define NAME_LENGTH         64
+#define PROLOGUE_LENGTH     16          // Instructions searched for the frame setup
+#define PROLOGUE_REGISTERS  18          // Pushed by all of __prologue_saves__
+#define VECTOR_COUNT        21
+#define ICALL_RULES         8
+
+// Interrupts by vector number
+static const char* const vector_names[VECTOR_COUNT] = {
+    "RESET", "INT0", "INT1", "INT2", "TIMER2_COMP", "TIMER2_OVF",
+    "TIMER1_CAPT", "TIMER1_COMPA", "TIMER1_COMPB", "TIMER1_OVF",
+    "TIMER0_COMP", "TIMER0_OVF", "SPI_STC", "USART_RXC", "USART_UDRE",
+    "USART_TXC", "ADC", "EE_RDY", "ANA_COMP", "TWI", "SPM_RDY"
+};
+
+enum { UNVISITED, VISITING, DONE };
+
+typedef struct {
+    char name[NAME_LENGTH];
+    char file[NAME_LENGTH];     // Source file, from the .su file
+    long frame;                 // Own stack use, from the .su file or estimated
+    bool has_su;
+    bool dynamic;               // .su says the frame depends on the arguments
+    bool indirect;              // Calls through a pointer
+    bool interrupts;            // Enables interrupts (sei)
+    int instructions;           // Seen so far, for the prologue search
+    int pushes;
+    long y_frame;               // Frame allocated in Y by the prologue
+    long ldi_x;                 // r27:r26 loaded for __prologue_saves__
+    int state;
+    long depth;                 // Worst case including callees
+    int deepest;                // Callee on the worst path, or -1
+} function_t;
+
+typedef struct {
+    int caller;
+    int callee;
+    bool tail;
+} call_t;
+
+static function_t functions[FUNCTION_COUNT];
+static int function_count;
+static call_t calls[CALL_COUNT];
+static int call_count;
+static const char* icall_rules[ICALL_RULES];     // "PREFIX=FILE"
+static int icall_rule_count;
+static bool recursion;
+
+static unsigned long heap_start;
+static unsigned long ramend = DEFAULT_RAMEND;
+
+static bool starts_with(const char* text, const char* prefix)
+{
+    return strncmp(text, prefix, strlen(prefix)) == 0;
+}
+
+static int function_find(const char* name)
+{
+    int i;
+    
+    for (i = 0; i < function_count; i++) {
+        if (strcmp(functions[i].name, name) == 0) return i;
+    }
+    return -1;
+}
+
+static int function_add(const char* name)
+{
+    int i = function_find(name);
+    
+    if (i >= 0) return i;
+    if (function_count == FUNCTION_COUNT) {
+        fprintf(stderr, "stackcheck: more than %d functions\n", FUNCTION_COUNT);
+        exit(2);
+    }
+    i = function_count++;
+    memset(&functions[i], 0, sizeof(functions[i]));
+    snprintf(functions[i].name, NAME_LENGTH, "%s", name);
+    functions[i].deepest = -1;
+    return i;
+}
+
+static void call_add(int caller, int callee, bool tail)
+{
+    int i;
+    
+    for (i = 0; i < call_count; i++) {
+        if (calls[i].caller == caller && calls[i].callee == callee && calls[i].tail == tail) return;
+    }
+    if (call_count == CALL_COUNT) {
+        fprintf(stderr, "stackcheck: more than %d calls\n", CALL_COUNT);
+        exit(2);
+    }
+    calls[call_count].caller = caller;
+    calls[call_count].callee = callee;
+    calls[call_count].tail = tail;
+    call_count++;
+}
+
+// Lines are "file:line:column:name<TAB>bytes<TAB>static|dynamic[,bounded]"
+static void read_su(const char* path)
+{
+    FILE* file = fopen(path, "r");
+    char line[512];
+    char* name;
+    char* field;
+    char* source;
+    long bytes;
+    int i;
+    
+    if (file == NULL) {
+        perror(path);
+        exit(2);
+    }
+    while (fgets(line, sizeof(line), file) != NULL) {
+        field = strchr(line, '\t');
+        if (field == NULL) continue;
+        *field++ = '\0';
+        name = strrchr(line, ':');
+        name = (name != NULL) ? name + 1 : line;
+        bytes = strtol(field, &field, 10);
+        source = strrchr(line, '/');
+        source = (source != NULL) ? source + 1 : line;
+        
+        // Static functions of the same name in two files: keep the larger
+        i = function_add(name);
+        snprintf(functions[i].file, NAME_LENGTH, "%.*s", (int)strcspn(source, ":"), source);
+        if (!functions[i].has_su || bytes > functions[i].frame) functions[i].frame = bytes;
+        functions[i].has_su = true;
+        if (strstr(field, "dynamic") != NULL) functions[i].dynamic = true;
+    }
+    fclose(file);
+}
+
+// Symbol table lines end with the name; only the bounds of SRAM are needed
+static void read_symbol(const char* line)
+{
+    unsigned long address = strtoul(line, NULL, 16);
+    size_t length = strlen(line);
+    
+    if (length > 13 && strcmp(line + length - 13, " __heap_start") == 0) heap_start = address & 0xFFFF;
+    if (length > 8 && strcmp(line + length - 8, " __stack") == 0) ramend = address & 0xFFFF;
+}
+
+// Target of a call or jump from its "; 0x1234 <name+0x10>" comment
+static bool branch_target(const char* line, char* name, unsigned long* offset)
+{
+    const char* start = strrchr(line, '<');
+    const char* end = (start != NULL) ? strchr(start, '>') : NULL;
+    const char* plus;
+    size_t length;
+    
+    if (start == NULL || end == NULL) return false;
+    start++;
+    plus = memchr(start, '+', end - start);
+    length = ((plus != NULL) ? plus : end) - start;
+    if (length == 0 || length >= NAME_LENGTH) return false;
+    memcpy(name, start, length);
+    name[length] = '\0';
+    *offset = (plus != NULL) ? strtoul(plus + 1, NULL, 16) : 0;
+    return true;
+}
+
+// One disassembled instruction: "   addr:<TAB>bytes<TAB>mnemonic<TAB>operands..."
+static void read_instruction(int current, char* line)
+{
+    function_t* function = &functions[current];
+    char* fields[4];
+    char target[NAME_LENGTH];
+    unsigned long offset, value;
+    int count = 0, callee;
+    char* cursor = line;
+    const char* mnemonic;
+    
+    // The operands keep the comment with the target's name
+    while (count < 4 && cursor != NULL) {
+        fields[count++] = cursor;
+        cursor = (count < 4) ? strchr(cursor, '\t') : NULL;
+        if (cursor != NULL) *cursor++ = '\0';
+    }
+    if (count < 3) return;
+    mnemonic = fields[2];
+    while (*mnemonic == ' ') mnemonic++;
+    function->instructions++;
+    
+    // Prologue of a function without a .su file
+    if (function->instructions <= PROLOGUE_LENGTH && count == 4) {
+        if (strcmp(mnemonic, "push") == 0) {
+            function->pushes++;
+        } else if ((strcmp(mnemonic, "sbiw") == 0 || strcmp(mnemonic, "subi") == 0) &&
+                   starts_with(fields[3], "r28, ")) {
+            function->y_frame = strtol(fields[3] + 5, NULL, 0);
+        } else if (strcmp(mnemonic, "ldi") == 0 && starts_with(fields[3], "r26, ")) {
+            value = strtoul(fields[3] + 5, NULL, 0);
+            function->ldi_x = (function->ldi_x & 0xFF00) | (value & 0xFF);
+        } else if (strcmp(mnemonic, "ldi") == 0 && starts_with(fields[3], "r27, ")) {
+            value = strtoul(fields[3] + 5, NULL, 0);
+            function->ldi_x = (function->ldi_x & 0x00FF) | ((value & 0xFF) << 8);
+        }
+    }
+    
+    if (strcmp(mnemonic, "icall") == 0 || strcmp(mnemonic, "eicall") == 0 ||
+        strcmp(mnemonic, "ijmp") == 0 || strcmp(mnemonic, "eijmp") == 0) {
+        function->indirect = true;
+        return;
+    }
+    if (strcmp(mnemonic, "sei") == 0) {
+        function->interrupts = true;
+        return;
+    }
+    if (strcmp(mnemonic, "call") != 0 && strcmp(mnemonic, "rcall") != 0 &&
+        strcmp(mnemonic, "jmp") != 0 && strcmp(mnemonic, "rjmp") != 0) {
+        return;
+    }
+    if (count < 4 || !branch_target(fields[3], target, &offset)) return;
+    if (strcmp(target, function->name) == 0) return;    // Branch inside the function
+    
+    // Register saves of avr-libc's -mcall-prologues code: jumping in at
+    // +offset skips offset / 2 of the pushes, and X holds the frame size
+    if (strcmp(target, "__prologue_saves__") == 0) {
+        function->pushes += PROLOGUE_REGISTERS - (int)(offset / 2);
+        function->y_frame = function->ldi_x;
+        return;
+    }
+    if (strcmp(target, "__epilogue_restores__") == 0) return;
+    
+    callee = function_add(target);
+    call_add(current, callee, mnemonic[strlen(mnemonic) - 3] == 'j');
+}
+
+static void read_disassembly(FILE* input)
+{
+    char line[512];
+    char name[NAME_LENGTH];
+    unsigned long address;
+    bool symbols = false;
+    int current = -1;
+    size_t length;
+    
+    while (fgets(line, sizeof(line), input) != NULL) {
+        length = strlen(line);
+        while (length > 0 && (line[length - 1] == '\n' || line[length - 1] == '\r')) line[--length] = '\0';
+        
+        if (starts_with(line, "SYMBOL TABLE:")) {
+            symbols = true;
+        } else if (symbols) {
+            if (length == 0) symbols = false;
+            else read_symbol(line);
+        } else if (sscanf(line, "%lx <%63[^>]>:", &address, name) == 2 && line[length - 1] == ':') {
+            current = function_add(name);
+        } else if (current >= 0 && line[0] == ' ' && strchr(line, ':') != NULL) {
+            read_instruction(current, line);
+        }
+    }
+}
+
+// Calls through a pointer in the functions named PREFIX... may reach any
+// function of FILE
+static void resolve_icalls(void)
+{
+    const char* file;
+    size_t prefix;
+    int rule, i, j;
+    
+    for (rule = 0; rule < icall_rule_count; rule++) {
+        file = strchr(icall_rules[rule], '=') + 1;
+        prefix = file - 1 - icall_rules[rule];
+        for (i = 0; i < function_count; i++) {
+            if (!functions[i].indirect || strncmp(functions[i].name, icall_rules[rule], prefix) != 0) continue;
+            for (j = 0; j < function_count; j++) {
+                if (j != i && strcmp(functions[j].file, file) == 0) call_add(i, j, false);
+            }
+            functions[i].indirect = false;
+        }
+    }
+}
+
+// Worst-case depth of a function and its callees, depth first
+static long function_depth(int i)
+{
+    function_t* function = &functions[i];
+    long own, depth;
+    int c;
+    
+    if (function->state == DONE) return function->depth;
+    if (function->state == VISITING) {
+        printf("# recursion through %s is not bounded\n", function->name);
+        recursion = true;
+        return 0;
+    }
+    function->state = VISITING;
+    
+    own = function->has_su ? function->frame : 2 + function->pushes + function->y_frame;
+    function->frame = own;
+    function->depth = own;
+    for (c = 0; c < call_count; c++) {
+        if (calls[c].caller != i) continue;
+        depth = function_depth(calls[c].callee) + (calls[c].tail ? 0 : own);
+        if (depth > function->depth) {
+            function->depth = depth;
+            function->deepest = calls[c].callee;
+        }
+    }
+    
+    function->state = DONE;
+    return function->depth;
+}
+
+static void report_entry(const char* label, int i)
+{
+    int step;
+    
+    printf("%-7s %-14s bound=%ld path=", "entry", label, functions[i].depth);
+    for (step = i; step >= 0; step = functions[step].deepest) {
+        printf("%s%s", functions[step].name, functions[step].deepest >= 0 ? ">" : "\n");
+    }
+}
+
+// Functions of a kind, on one comment line
+static void report_list(const char* title, bool (*match)(const function_t*))
+{
+    bool any = false;
+    int i;
+    
+    for (i = 0; i < function_count; i++) {
+        if (functions[i].state != DONE || !match(&functions[i])) continue;
+        printf("%s%s", any ? " " : title, functions[i].name);
+        any = true;
+    }
+    if (any) putchar('\n');
+}
+
+static bool is_estimated(const function_t* function) { return !function->has_su; }
+static bool is_dynamic(const function_t* function) { return function->dynamic; }
+static bool is_indirect(const function_t* function) { return function->indirect; }
+
+static void usage(const char* program)
+{
+    fprintf(stderr, "usage: avr-objdump -d -t firmware.elf | %s [--measured N] [--icall PREFIX=FILE]... FILE.su...\n", program);
+    exit(2);
+}
+
+int main(int argc, char** argv)
+{
+    long measured = -1;
+    long main_depth, isr_depth = 0, sram;
+    int i, vector, main_index, worst_isr = -1;
+    char label[NAME_LENGTH];
+    bool nested = false;
+    
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--measured") == 0 && i + 1 < argc) {
+            measured = strtol(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "--icall") == 0 && i + 1 < argc && strchr(argv[i + 1], '=') != NULL &&
+                   icall_rule_count < ICALL_RULES) {
+            icall_rules[icall_rule_count++] = argv[++i];
+        } else if (argv[i][0] != '-') {
+            read_su(argv[i]);
+        } else {
+            usage(argv[0]);
+        }
+    }
+    
+    read_disassembly(stdin);
+    resolve_icalls();
+    main_index = function_find("main");
+    if (main_index < 0 || heap_start == 0) {
+        fprintf(stderr, "%s: no main or __heap_start in the disassembly (avr-objdump -d -t)\n", argv[0]);
+        return 2;
+    }
+    
+    main_depth = function_depth(main_index);
+    report_entry("main", main_index);
+    for (vector = 1; vector < VECTOR_COUNT; vector++) {
+        snprintf(label, sizeof(label), "__vector_%d", vector);
+        i = function_find(label);
+        if (i < 0) continue;
+        function_depth(i);
+        report_entry(vector_names[vector], i);
+        if (functions[i].interrupts) nested = true;
+        if (functions[i].depth > isr_depth) {
+            isr_depth = functions[i].depth;
+            worst_isr = i;
+        }
+    }
+    
+    sram = (long)(ramend + 1 - heap_start);
+    printf("%-7s %-14s bound=%ld sram=%ld margin=%ld", "total", "main+isr",
+           main_depth + isr_depth, sram, sram - main_depth - isr_depth);
+    if (measured >= 0) printf(" measured=%ld", measured);
+    putchar('\n');
+    
+    if (worst_isr >= 0) printf("# deepest ISR: %s\n", functions[worst_isr].name);
+    report_list("# estimated from the prologue (no .su): ", is_estimated);
+    report_list("# dynamic frames, bound not exact: ", is_dynamic);
+    report_list("# calls through pointers not followed in: ", is_indirect);
+    if (nested) printf("# an ISR enables interrupts: nested ISRs are not counted\n");
+    
+    return recursion ? 1 : 0;
+}
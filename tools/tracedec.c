@@ -0,0 +1,196 @@
+/*
+ * Trace decoder - latency histograms from the records of trace.h.
+ *
+ * Reads a file written by rtc_host --trace or tools/provision trace: 5-byte
+ * records of timestamp (u16, Timer1 steps of 128 us), event id (u8) and
+ * argument (u16), little-endian. The timestamps wrap every 8.4 s; the
+ * tick ISR records one every second, so the distance between two records
+ * always fits 16 bits and the times are unwrapped from it.
+ *
+ * For each pair of events below, the latency runs from the first start
+ * not yet matched (the last one for a minute, which need not ring an
+ * alarm) to the next end, and prints as count, min, average and
+ * max with a power-of-two histogram. The resolution is one timer step
+ * (128 us): spans shorter than that read as 0 or 128 us.
+ *
+ * The minute-to-alarm pair starts when rtc_sync() reads the new minute,
+ * so it leaves out how far the DS1307's second lags the Timer1 tick; the
+ * trace has no view of the RTC oscillator.
+ *
+ * Usage: tracedec FILE
+ */
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Events of trace.h (not included: it pulls in the firmware HAL)
+#define KEY                 1
+#define MODE_BEGIN          2
+#define MODE_END            3
+#define RTC_BEGIN           4
+#define RTC_END             5
+#define LCD_BEGIN           6
+#define LCD_END             7
+#define BUZZER_ON           8
+#define BUZZER_OFF          9
+#define TICK_ISR            10
+#define EEPROM_ISR          11
+#define RTC_SECOND          12
+#define ALARM               13
+#define EVENT_COUNT         14
+
+#define RECORD_SIZE         5
+#define STEP_US             128
+#define ANY                 -1
+#define BUCKETS             24
+#define BAR_WIDTH           40
+
+static const char* const event_names[EVENT_COUNT] = {
+    "?", "key", "mode_begin", "mode_end", "rtc_begin", "rtc_end",
+    "lcd_begin", "lcd_end", "buzzer_on", "buzzer_off", "tick_isr",
+    "eeprom_isr", "rtc_second", "alarm"
+};
+
+typedef struct {
+    const char* name;
+    uint8_t start;
+    int32_t start_arg;          // ANY or the argument the start must carry
+    uint8_t end;
+    bool restart;               // A new start replaces one still pending
+} pair_t;
+
+typedef struct {
+    bool pending;
+    uint64_t started;
+    uint32_t count;
+    uint64_t total;
+    uint64_t min;
+    uint64_t max;
+    uint32_t buckets[BUCKETS];
+} latency_t;
+
+static const pair_t pairs[] = {
+    { "key to display",     KEY,        ANY, LCD_END,   false },
+    { "mode handler",       MODE_BEGIN, ANY, MODE_END,  false },
+    { "display update",     LCD_BEGIN,  ANY, LCD_END,   false },
+    { "rtc transaction",    RTC_BEGIN,  ANY, RTC_END,   false },
+    { "tick to display",    TICK_ISR,   ANY, LCD_END,   false },
+    { "minute to alarm",    RTC_SECOND, 0,   ALARM,     true },
+    { "alarm to buzzer",    ALARM,      ANY, BUZZER_ON, false },
+};
+#define PAIR_COUNT          (sizeof(pairs) / sizeof(pairs[0]))
+
+static latency_t latencies[PAIR_COUNT];
+
+// Bucket b holds latencies below 128 << b microseconds
+static int bucket_of(uint64_t us)
+{
+    int bucket = 0;
+    
+    while (bucket < BUCKETS - 1 && us >= ((uint64_t)STEP_US << bucket)) {
+        bucket++;
+    }
+    return bucket;
+}
+
+static void pair_event(const pair_t* pair, latency_t* latency, uint8_t id, uint16_t arg, uint64_t time)
+{
+    uint64_t us;
+    
+    if (id == pair->end && latency->pending) {
+        us = (time - latency->started) * STEP_US;
+        latency->pending = false;
+        latency->total += us;
+        latency->min = (latency->count == 0 || us < latency->min) ? us : latency->min;
+        latency->max = (us > latency->max) ? us : latency->max;
+        latency->buckets[bucket_of(us)]++;
+        latency->count++;
+    }
+    if (id == pair->start && (!latency->pending || pair->restart) &&
+        (pair->start_arg == ANY || pair->start_arg == arg)) {
+        latency->pending = true;
+        latency->started = time;
+    }
+}
+
+static void print_latency(const char* name, const latency_t* pair)
+{
+    uint32_t peak = 0;
+    int first = BUCKETS, last = 0;
+    
+    printf("%s: ", name);
+    if (pair->count == 0) {
+        printf("no samples\n\n");
+        return;
+    }
+    printf("%u samples, min %llu us, avg %llu us, max %llu us\n", pair->count,
+           (unsigned long long)pair->min, (unsigned long long)(pair->total / pair->count),
+           (unsigned long long)pair->max);
+    for (int b = 0; b < BUCKETS; b++) {
+        if (pair->buckets[b] > 0) {
+            first = (b < first) ? b : first;
+            last = b;
+            peak = (pair->buckets[b] > peak) ? pair->buckets[b] : peak;
+        }
+    }
+    for (int b = first; b <= last; b++) {
+        int width = (int)((uint64_t)pair->buckets[b] * BAR_WIDTH / peak);
+        
+        printf("  < %9llu us %7u ", (unsigned long long)STEP_US << b, pair->buckets[b]);
+        for (int i = 0; i < width; i++) {
+            putchar('#');
+        }
+        putchar('\n');
+    }
+    putchar('\n');
+}
+
+int main(int argc, char** argv)
+{
+    uint8_t record[RECORD_SIZE];
+    uint32_t events[EVENT_COUNT] = { 0 };
+    uint64_t time = 0;
+    uint16_t previous = 0;
+    uint32_t records = 0;
+    FILE* file;
+    
+    if (argc != 2) {
+        fprintf(stderr, "usage: %s FILE\n", argv[0]);
+        return 2;
+    }
+    if ((file = fopen(argv[1], "rb")) == NULL) {
+        perror(argv[1]);
+        return 1;
+    }
+    
+    while (fread(record, RECORD_SIZE, 1, file) == 1) {
+        uint16_t stamp = record[0] | (record[1] << 8);
+        uint8_t id = record[2];
+        uint16_t arg = record[3] | (record[4] << 8);
+        
+        // The first record starts the time line at 0
+        if (records++ > 0) {
+            time += (uint16_t)(stamp - previous);
+        }
+        previous = stamp;
+        events[id < EVENT_COUNT ? id : 0]++;
+        for (size_t i = 0; i < PAIR_COUNT; i++) {
+            pair_event(&pairs[i], &latencies[i], id, arg, time);
+        }
+    }
+    fclose(file);
+    
+    printf("%u records over %.3f s\n", records, time * STEP_US / 1e6);
+    for (int id = 0; id < EVENT_COUNT; id++) {
+        if (events[id] > 0) {
+            printf("  %-11s %u\n", event_names[id], events[id]);
+        }
+    }
+    putchar('\n');
+    for (size_t i = 0; i < PAIR_COUNT; i++) {
+        print_latency(pairs[i].name, &latencies[i]);
+    }
+    return 0;
+}
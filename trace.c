@@ -0,0 +1,37 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include "hal.h"
+#include "trace.h"
+
+#ifdef TRACE
+
+trace_record_t trace_ring[TRACE_SIZE];
+uint8_t trace_head = 0;
+uint8_t trace_tail = 0;
+uint16_t trace_lost = 0;
+
+// Move up to max of the oldest records out of the ring (main loop)
+uint8_t trace_take(trace_record_t* records, uint8_t max)
+{
+    uint8_t count = 0;
+    uint8_t sreg = hal_irq_save();
+    
+    while (count < max && trace_tail != trace_head) {
+        records[count++] = trace_ring[trace_tail];
+        trace_tail = (trace_tail + 1) & (TRACE_SIZE - 1);
+    }
+    hal_irq_restore(sreg);
+    return count;
+}
+
+// Records dropped because the ring was full
+uint16_t trace_lost_count(void)
+{
+    uint8_t sreg = hal_irq_save();
+    uint16_t lost = trace_lost;
+    
+    hal_irq_restore(sreg);
+    return lost;
+}
+
+#endif
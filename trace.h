@@ -0,0 +1,89 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "hal.h"
+#include "timebase.h"
+
+// Event trace for latency analysis. Built with -DTRACE (make TRACE=1),
+// TRACE_EVENT() appends a record to a RAM ring: timestamp, event id and a
+// 16-bit argument. The PC drains the ring over the provisioning protocol
+// (tools/provision trace) or rtc_host writes it (--trace), and
+// tools/tracedec turns the records into latency histograms between
+// paired events. Without TRACE everything compiles to nothing.
+//
+// A record is about 40 cycles: interrupts are masked for the ring update,
+// so hooks may sit in ISRs. When the ring is full new records are
+// dropped and counted. The UART ISRs are not traced: draining the ring
+// would fill it again.
+
+// Events and their argument
+#define TRACE_KEY           1   // New key press seen by the scan; BTN_*
+#define TRACE_MODE_BEGIN    2   // Mode handler on a pass with a press; mode
+#define TRACE_MODE_END      3   // Mode handler done; mode
+#define TRACE_RTC_BEGIN     4   // RTC transaction on the I2C bus; first register
+#define TRACE_RTC_END       5   // RTC transaction done; first register
+#define TRACE_LCD_BEGIN     6   // mode_render() redraws; mode
+#define TRACE_LCD_END       7   // LCD contents written; mode
+#define TRACE_BUZZER_ON     8
+#define TRACE_BUZZER_OFF    9
+#define TRACE_TICK_ISR      10  // Timer1 compare ISR entry
+#define TRACE_EEPROM_ISR    11  // EEPROM ready ISR entry; byte position
+#define TRACE_RTC_SECOND    12  // rtc_sync() read the clock; seconds (0 on a new minute)
+#define TRACE_ALARM         13  // Alarm fired; slot
+
+// Ring size in records, a power of two
+#define TRACE_SIZE          64
+
+// Timestamps are the low 16 bits of timebase_now() (128 us steps) and
+// wrap after 8.4 s; the tick ISR records an event every second, so a
+// reader can unwrap them
+typedef struct {
+    uint16_t time;
+    uint8_t id;
+    uint16_t arg;
+} __attribute__((packed)) trace_record_t;
+
+#ifdef TRACE
+
+extern trace_record_t trace_ring[TRACE_SIZE];
+extern uint8_t trace_head;
+extern uint8_t trace_tail;
+extern uint16_t trace_lost;
+
+static inline void trace_event(uint8_t id, uint16_t arg)
+{
+    uint8_t sreg = hal_irq_save();
+    uint8_t head = trace_head;
+    uint8_t next = (head + 1) & (TRACE_SIZE - 1);
+    
+    if (next == trace_tail) {
+        trace_lost++;
+    } else {
+        trace_ring[head].time = (uint16_t)timebase_now();
+        trace_ring[head].id = id;
+        trace_ring[head].arg = arg;
+        trace_head = next;
+    }
+    hal_irq_restore(sreg);
+}
+
+// In the tick ISR, after timebase_tick()
+#define TRACE_TICK()                trace_event(TRACE_TICK_ISR, 0)
+#define TRACE_EVENT(id, arg)        trace_event((id), (arg))
+#define TRACE_IF(condition, id, arg) \
+    do { if (condition) trace_event((id), (arg)); } while (0)
+
+uint8_t trace_take(trace_record_t* records, uint8_t max);
+uint16_t trace_lost_count(void);
+
+#else
+
+#define TRACE_TICK()                ((void)0)
+#define TRACE_EVENT(id, arg)        ((void)0)
+#define TRACE_IF(condition, id, arg) ((void)0)
+
+#endif
+
+#endif // TRACE_H 
@@ -0,0 +1,197 @@
+#include <avr/pgmspace.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "tz.h"
+#include "rtc.h"
+#include "time_utils.h"
+#include "calendar_tables.h"
+#include "mode.h"
+
+// Zone rules. Transition hours are local wall-clock time before the change.
+static const tz_rule_t tz_rules[TZ_ZONE_COUNT] PROGMEM = {
+    {"UTC",     0,  0, {0, 0, 0, 0},             {0, 0, 0, 0}},
+    {"GMT",     0, 60, {3, TZ_WEEK_LAST, 6, 1},  {10, TZ_WEEK_LAST, 6, 2}},  // UK
+    {"CET",    60, 60, {3, TZ_WEEK_LAST, 6, 2},  {10, TZ_WEEK_LAST, 6, 3}},  // EU
+    {"EET",   120, 60, {3, TZ_WEEK_LAST, 6, 3},  {10, TZ_WEEK_LAST, 6, 4}},  // EU
+    {"MSK",   180,  0, {0, 0, 0, 0},             {0, 0, 0, 0}},
+    {"IST",   330,  0, {0, 0, 0, 0},             {0, 0, 0, 0}},
+    {"JST",   540,  0, {0, 0, 0, 0},             {0, 0, 0, 0}},
+    {"AEST",  600, 60, {10, 1, 6, 2},            {4, 1, 6, 3}},              // Sydney
+    {"EST",  -300, 60, {3, 2, 6, 2},             {11, 1, 6, 2}},             // US
+    {"CST",  -360, 60, {3, 2, 6, 2},             {11, 1, 6, 2}},             // US
+    {"MST",  -420, 60, {3, 2, 6, 2},             {11, 1, 6, 2}},             // US
+    {"PST",  -480, 60, {3, 2, 6, 2},             {11, 1, 6, 2}}              // US
+};
+
+// Selected zone and its rule, copied out of flash
+static uint8_t zone_index = TZ_DEFAULT_ZONE;
+static tz_rule_t rule;
+
+// Cached offset, valid from cache_from until next_transition
+static int32_t cached_offset = 0;
+static epoch_t cache_from = 0;
+static epoch_t next_transition = 0;
+static bool cached_dst = false;
+
+// UTC instant of a transition in the given year
+static epoch_t tz_transition_utc(const tz_transition_t* transition, uint16_t year, int32_t wall_offset)
+{
+    uint8_t weekday;
+    uint8_t day;
+    
+    if (transition->week == TZ_WEEK_LAST) {
+        day = days_in_month(transition->month, year);
+        weekday = day_of_week(day, transition->month, year);
+        day -= (weekday + 7 - transition->weekday) % 7;
+    } else {
+        weekday = day_of_week(1, transition->month, year);
+        day = 1 + (transition->weekday + 7 - weekday) % 7 + 7 * (transition->week - 1);
+    }
+    
+    return (epoch_t)days_from_civil(year, transition->month, day) * EPOCH_SECONDS_PER_DAY +
+           transition->hour * EPOCH_SECONDS_PER_HOUR - wall_offset;
+}
+
+// Full rule evaluation: offset at utc, whether DST applies and the next change
+static int32_t tz_evaluate(epoch_t utc, bool* dst, epoch_t* next)
+{
+    int32_t standard = (int32_t)rule.offset * EPOCH_SECONDS_PER_MINUTE;
+    int32_t daylight = standard + (int32_t)rule.dst_shift * EPOCH_SECONDS_PER_MINUTE;
+    date_t date;
+    time_t time;
+    epoch_t start, end;
+    
+    *dst = false;
+    *next = TZ_NEVER;
+    if (rule.dst_shift == 0) {
+        return standard;
+    }
+    
+    // Transitions of the local year; the first hours of 2000 west of UTC
+    // count as 2000 as well
+    if (standard < 0 && utc < (epoch_t)-standard) {
+        epoch_to_datetime(0, &date, &time);
+    } else {
+        epoch_to_datetime(utc + standard, &date, &time);
+    }
+    
+    start = tz_transition_utc(&rule.start, date.year, standard);
+    end = tz_transition_utc(&rule.end, date.year, daylight);
+    
+    // Northern zones are on DST between start and end, southern zones
+    // outside of end..start
+    if (start < end) {
+        *dst = (utc >= start && utc < end);
+    } else {
+        *dst = (utc >= start || utc < end);
+    }
+    
+    if (utc < start && (utc >= end || start < end)) {
+        *next = start;
+    } else if (utc < end) {
+        *next = end;
+    } else if (date.year < CALENDAR_FIRST_YEAR + CALENDAR_YEARS - 1) {
+        // Both changes of this year are over; the earlier of next year's follows
+        start = tz_transition_utc(&rule.start, date.year + 1, standard);
+        end = tz_transition_utc(&rule.end, date.year + 1, daylight);
+        *next = (start < end) ? start : end;
+    }
+    
+    return *dst ? daylight : standard;
+}
+
+// Initialize with the default zone
+void tz_init(void)
+{
+    tz_select(TZ_DEFAULT_ZONE);
+}
+
+// Switch to another zone from the table
+void tz_select(uint8_t zone)
+{
+    if (zone >= TZ_ZONE_COUNT) {
+        zone = TZ_DEFAULT_ZONE;
+    }
+    
+    zone_index = zone;
+    memcpy_P(&rule, &tz_rules[zone], sizeof(rule));
+    tz_refresh(rtc_now());
+}
+
+uint8_t tz_get_zone(void)
+{
+    return zone_index;
+}
+
+// Copy a zone's abbreviation into buffer (at least 6 bytes)
+void tz_get_name(uint8_t zone, char* buffer)
+{
+    if (zone >= TZ_ZONE_COUNT) {
+        zone = TZ_DEFAULT_ZONE;
+    }
+    memcpy_P(buffer, tz_rules[zone].name, sizeof(tz_rules[zone].name));
+}
+
+// Per-second check: re-evaluates the rules only once a transition is reached
+void tz_update(epoch_t now)
+{
+    if (now >= next_transition) {
+        tz_refresh(now);
+    }
+}
+
+// Re-evaluate the rules at now; called on a transition and after the
+// clock has been set, since a backwards jump leaves the cache stale
+void tz_refresh(epoch_t now)
+{
+    int32_t offset = tz_evaluate(now, &cached_dst, &next_transition);
+    
+    // Local time moves with the offset
+    if (offset != cached_offset) {
+        cached_offset = offset;
+        mode_dirty(MODE_DIRTY_TIME);
+    }
+    cache_from = now;
+}
+
+bool tz_is_dst(void)
+{
+    return cached_dst;
+}
+
+epoch_t tz_next_transition(void)
+{
+    return next_transition;
+}
+
+// Offset from UTC in seconds at any instant; instants outside the cached
+// interval (such as alarms days ahead) get a full evaluation
+int32_t tz_offset_at(epoch_t utc)
+{
+    bool dst;
+    epoch_t next;
+    
+    if (utc >= cache_from && utc < next_transition) {
+        return cached_offset;
+    }
+    return tz_evaluate(utc, &dst, &next);
+}
+
+epoch_t tz_to_local(epoch_t utc)
+{
+    return utc + tz_offset_at(utc);
+}
+
+// Local wall-clock time back to UTC. Times skipped by a spring-forward
+// change resolve with the standard offset (landing an hour later on the
+// wall clock); repeated autumn times resolve to the first occurrence.
+epoch_t tz_to_utc(epoch_t local)
+{
+    int32_t standard = (int32_t)rule.offset * EPOCH_SECONDS_PER_MINUTE;
+    int32_t daylight = standard + (int32_t)rule.dst_shift * EPOCH_SECONDS_PER_MINUTE;
+    
+    if (tz_offset_at(local - daylight) == daylight) {
+        return local - daylight;
+    }
+    return local - standard;
+}
@@ -0,0 +1,55 @@
+#ifndef TZ_H
+#define TZ_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "rtc.h"
+
+// The RTC runs on UTC; local time for display and alarms comes from a
+// zone rule in flash. The next DST transition is cached as an epoch, so
+// the per-second check is one compare and the rules are only evaluated
+// once per transition.
+
+// Entries in the zone table (tz.c)
+#define TZ_ZONE_COUNT       12
+
+// Zone selected when no settings are stored
+#define TZ_DEFAULT_ZONE     0       // UTC
+
+// Week value of a transition on the last given weekday of the month
+#define TZ_WEEK_LAST        5
+
+// next transition value for zones without DST
+#define TZ_NEVER            0xFFFFFFFFUL
+
+// DST transition: the nth weekday of a month at a local wall-clock hour
+typedef struct {
+    uint8_t month;          // 1-12
+    uint8_t week;           // 1-4, or TZ_WEEK_LAST
+    uint8_t weekday;        // 0=Monday..6=Sunday
+    uint8_t hour;           // Wall-clock hour in force before the change
+} tz_transition_t;
+
+// Zone rule as stored in the flash table
+typedef struct {
+    char name[6];           // Standard time abbreviation, NUL-terminated
+    int16_t offset;         // Standard time offset from UTC in minutes
+    uint8_t dst_shift;      // Minutes added during DST, 0 = no DST
+    tz_transition_t start;  // Into DST
+    tz_transition_t end;    // Back to standard time
+} tz_rule_t;
+
+// Function prototypes
+void tz_init(void);
+void tz_select(uint8_t zone);
+uint8_t tz_get_zone(void);
+void tz_get_name(uint8_t zone, char* buffer);
+void tz_update(epoch_t now);
+void tz_refresh(epoch_t now);
+bool tz_is_dst(void);
+epoch_t tz_next_transition(void);
+int32_t tz_offset_at(epoch_t utc);
+epoch_t tz_to_local(epoch_t utc);
+epoch_t tz_to_utc(epoch_t local);
+
+#endif // TZ_H 
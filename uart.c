@@ -0,0 +1,119 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include "hal.h"
+#include "uart.h"
+#include "timebase.h"
+
+#define TX_MASK     (UART_TX_SIZE - 1)
+#define RX_MASK     (UART_RX_SIZE - 1)
+
+// Transmit ring: the main loop fills at tx_head, the UDRE interrupt
+// drains at tx_tail. Each index has a single writer, so neither side
+// needs to mask interrupts.
+static uint8_t tx_ring[UART_TX_SIZE];
+static volatile uint8_t tx_head = 0;
+static volatile uint8_t tx_tail = 0;
+
+// Receive ring: filled by the RXC interrupt, read by the main loop
+static uint8_t rx_ring[UART_RX_SIZE];
+static volatile uint8_t rx_head = 0;
+static volatile uint8_t rx_tail = 0;
+static volatile uint16_t rx_overruns = 0;
+static volatile uint16_t rx_time = 0;       // Low bits of timebase_now() at the last byte
+
+void uart_init(void)
+{
+    tx_head = tx_tail = 0;
+    rx_head = rx_tail = 0;
+    hal_uart_start(UART_BAUD);
+}
+
+// Bytes that fit into the transmit ring right now
+uint8_t uart_tx_free(void)
+{
+    return (uint8_t)(tx_tail - tx_head - 1) & TX_MASK;
+}
+
+// Queue a whole message or nothing; never waits for the line
+bool uart_write(const uint8_t* data, uint8_t length)
+{
+    uint8_t head = tx_head;
+    
+    if (length > uart_tx_free()) {
+        return false;
+    }
+    
+    while (length--) {
+        tx_ring[head] = *data++;
+        head = (head + 1) & TX_MASK;
+    }
+    tx_head = head;
+    
+    // The interrupt switches itself off when the ring runs empty
+    hal_uart_tx_irq_enable();
+    return true;
+}
+
+// Take one received byte, if any
+bool uart_read(uint8_t* data)
+{
+    uint8_t tail = rx_tail;
+    
+    if (tail == rx_head) {
+        return false;
+    }
+    *data = rx_ring[tail];
+    rx_tail = (tail + 1) & RX_MASK;
+    return true;
+}
+
+// Time stamp (low 16 bits, timebase.h) of the last byte, to time commands
+// from the end of their frame
+uint16_t uart_rx_time(void)
+{
+    uint8_t sreg = hal_irq_save();
+    uint16_t time = rx_time;
+    
+    hal_irq_restore(sreg);
+    return time;
+}
+
+// Bytes lost because the receive ring was full
+uint16_t uart_rx_overruns(void)
+{
+    uint8_t sreg = hal_irq_save();
+    uint16_t count = rx_overruns;
+    
+    hal_irq_restore(sreg);
+    return count;
+}
+
+// Data register empty: send the next byte or stop until there is one
+HAL_UART_TX_ISR()
+{
+    uint8_t tail = tx_tail;
+    
+    if (tail == tx_head) {
+        hal_uart_tx_irq_disable();
+        return;
+    }
+    hal_uart_write(tx_ring[tail]);
+    tx_tail = (tail + 1) & TX_MASK;
+}
+
+// Byte received: keep it unless the ring is full
+HAL_UART_RX_ISR()
+{
+    uint8_t data = hal_uart_read();
+    uint8_t next = (rx_head + 1) & RX_MASK;
+    
+    rx_time = (uint16_t)timebase_now();
+    if (next == rx_tail) {
+        if (rx_overruns < UINT16_MAX) {
+            rx_overruns++;
+        }
+        return;
+    }
+    rx_ring[rx_head] = data;
+    rx_head = next;
+}
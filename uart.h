@@ -0,0 +1,23 @@
+#ifndef UART_H
+#define UART_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Console USART on PD0 (RXD) / PD1 (TXD), 8N1.
+// 38400 baud is UBRR 12 at 8 MHz, 0.2 % off.
+#define UART_BAUD           38400UL
+
+// Ring sizes, powers of two. One slot is kept free to tell full from empty.
+#define UART_TX_SIZE        64
+#define UART_RX_SIZE        64
+
+// Function prototypes
+void uart_init(void);
+bool uart_write(const uint8_t* data, uint8_t length);
+uint8_t uart_tx_free(void);
+bool uart_read(uint8_t* data);
+uint16_t uart_rx_time(void);
+uint16_t uart_rx_overruns(void);
+
+#endif // UART_H 